@@ -8,10 +8,12 @@
 #include<math.h>
 #include<string.h>
 #include<mpi.h>
+#include<omp.h>
 
 #include"configuration.h"
 #include"initialize.h"
 #include"map.h"
+#include"mpifunctions.h"
 #include"solve.h"
 #include"utility.h"
 
@@ -21,14 +23,25 @@ int main(int argc, char *argv[])
     Data *data;
     Map *smap;
     Map *gmap;
-    int irank = 0,  nrank = 1;
+    int irank = 0,  nrank = 1, provided;
     
     read_input(&param);
+    // threads per rank, 0 keeps the OpenMP default
+    if (param->n_thread > 0)    {omp_set_num_threads(param->n_thread);}
     if (param->use_mpi == 1)
     {
-        MPI_Init(&argc, &argv);
+        // only the master thread communicates, all MPI calls are outside of
+        // the parallel loops
+        MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
         MPI_Comm_rank(MPI_COMM_WORLD, &irank);
         MPI_Comm_size(MPI_COMM_WORLD, &nrank);
+        if (provided < MPI_THREAD_FUNNELED)
+        {
+            if (irank == 0) {printf("WARNING: MPI library does not support threads, n_thread is set to 1!\n");}
+            param->n_thread = 1;
+            omp_set_num_threads(1);
+        }
+        mpi_decompose(param, irank, nrank);
     }
 
     mpi_print("\n\n>>>>>>  Starting FREHG simulation  <<<<<< ",irank);
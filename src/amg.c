@@ -0,0 +1,433 @@
+// Aggregation based algebraic multigrid preconditioner for LASPack matrices
+// Unknowns are merged into aggregates along strong couplings, so in the
+// thin layers of the subsurface grid the first levels coarsen along the
+// vertical columns and only later across them. Coarse operators are
+// Galerkin products with piecewise constant transfer. Rows without any
+// strong coupling (inactive cells, storage dominated cells) stay out of the
+// transfer and are resolved by the smoother alone.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include"amg.h"
+
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+#define AMG_NCOARSE 256
+#define AMG_MAXLEVEL 20
+
+void init_amg(Amg **amg, QMatrix *A, double drift);
+void amg_update(Amg *amg, QMatrix *A);
+void amg_setup(Amg *amg);
+void amg_cycle(Amg *amg, double *x, double *b);
+void amg_activate(Amg *amg);
+Vector *AMGPrecond(QMatrix *A, Vector *y, Vector *c, double omega);
+static int strong_coupling(AmgLevel *lev, size_t ii, size_t kk, double theta);
+static size_t aggregate(AmgLevel *fine, double theta);
+static void coarsen_operator(AmgLevel *fine, AmgLevel *coarse);
+static void free_level(AmgLevel *lev);
+static void level_matvec(AmgLevel *lev, double *y, double *x);
+static void level_sgs(AmgLevel *lev, double *y, double *c);
+static void coarse_factor(Amg *amg);
+static void coarse_solve(Amg *amg, double *x, double *b);
+static void cycle(Amg *amg, int ll, double *x, double *b);
+
+// hierarchy used by AMGPrecond, LASPack passes no context to preconditioners
+static Amg *active_amg = NULL;
+
+// >>>>> Set up the fine level on the pattern of a LASPack matrix <<<<<
+// The pattern must be final, values are taken over by amg_update.
+void init_amg(Amg **amg, QMatrix *A, double drift)
+{
+    size_t ii, kk, n = Q_GetDim(A);
+    AmgLevel *fine;
+    *amg = malloc(sizeof(Amg));
+    (*amg)->lev = malloc(AMG_MAXLEVEL*sizeof(AmgLevel));
+    (*amg)->nlevel = 1;
+    (*amg)->ncoarse = 0;
+    (*amg)->lu = NULL;
+    (*amg)->nsetup = 0;
+    (*amg)->nreuse = 0;
+    (*amg)->drift = drift;
+    (*amg)->line = NULL;
+    // as in the geometric multigrid, W-cycle with over-correction of the
+    // piecewise constant coarse grid correction
+    (*amg)->cycle = 2;
+    (*amg)->scale = 1.8;
+    (*amg)->theta = 0.25;
+    (*amg)->reused = 0;
+    fine = &(*amg)->lev[0];
+    fine->n = n;
+    fine->ia = malloc((n+1)*sizeof(size_t));
+    fine->ia[0] = 0;
+    for (ii = 0; ii < n; ii++)  {fine->ia[ii+1] = fine->ia[ii] + A->Len[ii+1];}
+    fine->ja = malloc(fine->ia[n]*sizeof(size_t));
+    for (ii = 0; ii < n; ii++)
+    {
+        for (kk = 0; kk < A->Len[ii+1]; kk++)
+        {fine->ja[fine->ia[ii]+kk] = A->El[ii+1][kk].Pos - 1;}
+    }
+    fine->a = malloc(fine->ia[n]*sizeof(double));
+    (*amg)->asetup = malloc(fine->ia[n]*sizeof(double));
+    fine->invd = malloc(n*sizeof(double));
+    fine->agg = malloc(n*sizeof(int));
+    fine->x = NULL;
+    fine->b = NULL;
+    fine->tmp = NULL;
+    fine->cor = NULL;
+    fine->res = malloc(n*sizeof(double));
+}
+
+// >>>>> Take over the current matrix values <<<<<
+// The coarse levels are rebuilt if any stored entry, diagonal or not, has
+// changed by more than the relative drift since the last setup. Otherwise
+// the old hierarchy still approximates the operator well and only the
+// smoother on the fine level sees the new values. A reused hierarchy is
+// applied without over-correction, see cycle.
+void amg_update(Amg *amg, QMatrix *A)
+{
+    size_t ii, kk, jj;
+    int stale = 0;
+    double val;
+    AmgLevel *fine = &amg->lev[0];
+    for (ii = 0; ii < fine->n; ii++)
+    {
+        for (kk = 0; kk < A->Len[ii+1]; kk++)
+        {
+            jj = fine->ia[ii] + kk;
+            val = A->El[ii+1][kk].Val;
+            fine->a[jj] = val;
+            if (fabs(val - amg->asetup[jj]) > amg->drift * fabs(amg->asetup[jj]))  {stale = 1;}
+        }
+        fine->invd[ii] = 1.0 / A->DiagEl[ii+1]->Val;
+    }
+    if (amg->nsetup == 0 | stale == 1)
+    {
+        for (jj = 0; jj < fine->ia[fine->n]; jj++)  {amg->asetup[jj] = fine->a[jj];}
+        amg_setup(amg);
+        amg->reused = 0;
+    }
+    else
+    {
+        amg->nreuse += 1;
+        amg->reused = 1;
+    }
+}
+
+// >>>>> Build the coarse levels from the fine level values <<<<<
+void amg_setup(Amg *amg)
+{
+    int ll;
+    size_t nc;
+    AmgLevel *lev;
+    for (ll = 1; ll < amg->nlevel; ll++)    {free_level(&amg->lev[ll]);}
+    ll = 0;
+    while (amg->lev[ll].n > AMG_NCOARSE & ll < AMG_MAXLEVEL-1)
+    {
+        nc = aggregate(&amg->lev[ll], amg->theta);
+        // stop if aggregation stalls, the smoother then acts on the last level
+        if (nc == 0 | nc > 0.8*amg->lev[ll].n)    {break;}
+        lev = &amg->lev[ll+1];
+        lev->n = nc;
+        coarsen_operator(&amg->lev[ll], lev);
+        lev->agg = malloc(nc*sizeof(int));
+        lev->x = malloc(nc*sizeof(double));
+        lev->b = malloc(nc*sizeof(double));
+        lev->res = malloc(nc*sizeof(double));
+        lev->tmp = malloc(nc*sizeof(double));
+        lev->cor = malloc(nc*sizeof(double));
+        ll += 1;
+    }
+    amg->nlevel = ll + 1;
+    amg->ncoarse = amg->lev[ll].n;
+    amg->nsetup += 1;
+    coarse_factor(amg);
+}
+
+// >>>>> One multigrid cycle, x = M^(-1) * b <<<<<
+void amg_cycle(Amg *amg, double *x, double *b)
+{
+    cycle(amg, 0, x, b);
+}
+
+// >>>>> Select the hierarchy applied by AMGPrecond <<<<<
+void amg_activate(Amg *amg)
+{
+    active_amg = amg;
+}
+
+// >>>>> Multigrid preconditioner in the form of LASPack SSORPrecond <<<<<
+// The hierarchy is taken from amg_activate, A and omega are not used.
+Vector *AMGPrecond(QMatrix *A, Vector *y, Vector *c, double omega)
+{
+    size_t ii;
+    amg_cycle(active_amg, y->Cmp+1, c->Cmp+1);
+    // the cycle is linear, a pending multiplier of c carries over to y
+    for (ii = 1; ii <= y->Dim; ii++)    {y->Cmp[ii] *= c->Multipl;}
+    y->Multipl = 1.0;
+    return y;
+}
+
+// >>>>> Strong coupling of row ii through entry kk <<<<<
+// j is a strong neighbor of i if |a_ij| >= theta*sqrt(|a_ii*a_jj|).
+static int strong_coupling(AmgLevel *lev, size_t ii, size_t kk, double theta)
+{
+    size_t jj = lev->ja[kk];
+    double aij = lev->a[kk];
+    if (jj == ii | aij == 0.0) {return 0;}
+    return aij*aij*fabs(lev->invd[ii]*lev->invd[jj]) >= theta*theta;
+}
+
+// >>>>> Aggregation along strong couplings <<<<<
+// 1st pass: cells whose strong neighbors are all free seed an aggregate
+//           together with these neighbors.
+// 2nd pass: the remaining cells join the aggregate of their strongest
+//           neighbor.
+// Returns the number of aggregates, agg = -1 marks cells left out.
+static size_t aggregate(AmgLevel *fine, double theta)
+{
+    size_t ii, kk, best, nc = 0;
+    int seed;
+    double amax;
+    int *agg = fine->agg;
+    for (ii = 0; ii < fine->n; ii++)
+    {
+        agg[ii] = -1;
+        for (kk = fine->ia[ii]; kk < fine->ia[ii+1]; kk++)
+        {if (strong_coupling(fine, ii, kk, theta) == 1)    {agg[ii] = -2;}}
+    }
+    for (ii = 0; ii < fine->n; ii++)
+    {
+        if (agg[ii] != -2)  {continue;}
+        seed = 1;
+        for (kk = fine->ia[ii]; kk < fine->ia[ii+1]; kk++)
+        {if (strong_coupling(fine, ii, kk, theta) == 1 & agg[fine->ja[kk]] >= 0)  {seed = 0;}}
+        if (seed == 0)  {continue;}
+        agg[ii] = nc;
+        for (kk = fine->ia[ii]; kk < fine->ia[ii+1]; kk++)
+        {if (strong_coupling(fine, ii, kk, theta) == 1 & agg[fine->ja[kk]] == -2) {agg[fine->ja[kk]] = nc;}}
+        nc += 1;
+    }
+    for (ii = 0; ii < fine->n; ii++)
+    {
+        if (agg[ii] != -2)  {continue;}
+        best = ii;
+        amax = 0.0;
+        for (kk = fine->ia[ii]; kk < fine->ia[ii+1]; kk++)
+        {
+            if (fine->ja[kk] != ii && agg[fine->ja[kk]] >= 0 && fabs(fine->a[kk]) > amax)
+            {best = fine->ja[kk];   amax = fabs(fine->a[kk]);}
+        }
+        if (best != ii) {agg[ii] = agg[best];}
+        else    {agg[ii] = nc;     nc += 1;}
+    }
+    return nc;
+}
+
+// >>>>> Galerkin operator R*A*P for piecewise constant transfer <<<<<
+// Couplings inside an aggregate are added to its diagonal, couplings
+// between aggregates are summed into the coarse off-diagonals.
+static void coarsen_operator(AmgLevel *fine, AmgLevel *coarse)
+{
+    size_t ii, kk, ic, jc, cnt, nnz = 0, nc = coarse->n;
+    size_t *start, *list, *pos;
+    double diag;
+    int *agg = fine->agg;
+    // fine cells sorted by aggregate
+    start = calloc(nc+1, sizeof(size_t));
+    list = malloc(fine->n*sizeof(size_t));
+    for (ii = 0; ii < fine->n; ii++)
+    {if (agg[ii] >= 0) {start[agg[ii]+1] += 1;}}
+    for (ic = 0; ic < nc; ic++) {start[ic+1] += start[ic];}
+    for (ii = 0; ii < fine->n; ii++)
+    {if (agg[ii] >= 0) {list[start[agg[ii]]] = ii;   start[agg[ii]] += 1;}}
+    for (ic = nc; ic > 0; ic--) {start[ic] = start[ic-1];}
+    start[0] = 0;
+    // pos[jc] is the position of column jc in the current coarse row
+    pos = malloc(nc*sizeof(size_t));
+    for (jc = 0; jc < nc; jc++) {pos[jc] = fine->ia[fine->n];}
+    coarse->ia = malloc((nc+1)*sizeof(size_t));
+    coarse->ja = malloc(fine->ia[fine->n]*sizeof(size_t));
+    coarse->a = malloc(fine->ia[fine->n]*sizeof(double));
+    coarse->invd = malloc(nc*sizeof(double));
+    coarse->ia[0] = 0;
+    for (ic = 0; ic < nc; ic++)
+    {
+        cnt = nnz;
+        for (ii = start[ic]; ii < start[ic+1]; ii++)
+        {
+            for (kk = fine->ia[list[ii]]; kk < fine->ia[list[ii]+1]; kk++)
+            {
+                if (agg[fine->ja[kk]] < 0)  {continue;}
+                jc = agg[fine->ja[kk]];
+                if (pos[jc] < cnt | pos[jc] >= nnz)
+                {
+                    pos[jc] = nnz;
+                    coarse->ja[nnz] = jc;
+                    coarse->a[nnz] = 0.0;
+                    nnz += 1;
+                }
+                coarse->a[pos[jc]] += fine->a[kk];
+            }
+        }
+        coarse->ia[ic+1] = nnz;
+        diag = 0.0;
+        for (kk = cnt; kk < nnz; kk++)
+        {if (coarse->ja[kk] == ic) {diag = coarse->a[kk];}}
+        if (diag == 0.0)    {diag = 1.0;}
+        coarse->invd[ic] = 1.0 / diag;
+    }
+    coarse->ja = realloc(coarse->ja, nnz*sizeof(size_t));
+    coarse->a = realloc(coarse->a, nnz*sizeof(double));
+    free(start);
+    free(list);
+    free(pos);
+}
+
+// >>>>> Release a coarse level <<<<<
+static void free_level(AmgLevel *lev)
+{
+    free(lev->ia);  free(lev->ja);  free(lev->a);   free(lev->invd);
+    free(lev->agg); free(lev->x);   free(lev->b);   free(lev->res);
+    free(lev->tmp); free(lev->cor);
+}
+
+// >>>>> y = A * x <<<<<
+static void level_matvec(AmgLevel *lev, double *y, double *x)
+{
+    size_t ii, kk;
+    double sum;
+    for (ii = 0; ii < lev->n; ii++)
+    {
+        sum = 0.0;
+        for (kk = lev->ia[ii]; kk < lev->ia[ii+1]; kk++)    {sum += lev->a[kk] * x[lev->ja[kk]];}
+        y[ii] = sum;
+    }
+}
+
+// >>>>> Symmetric Gauss-Seidel, y = M^(-1) * c, works in place <<<<<
+static void level_sgs(AmgLevel *lev, double *y, double *c)
+{
+    size_t ii, kk;
+    double sum;
+    // forward sweep, (D + L) t = c
+    for (ii = 0; ii < lev->n; ii++)
+    {
+        sum = c[ii];
+        for (kk = lev->ia[ii]; kk < lev->ia[ii+1]; kk++)
+        {if (lev->ja[kk] < ii) {sum -= lev->a[kk] * y[lev->ja[kk]];}}
+        y[ii] = sum * lev->invd[ii];
+    }
+    // backward sweep, (D + U) y = D t
+    for (ii = lev->n; ii-- > 0; )
+    {
+        sum = 0.0;
+        for (kk = lev->ia[ii]; kk < lev->ia[ii+1]; kk++)
+        {if (lev->ja[kk] > ii) {sum -= lev->a[kk] * y[lev->ja[kk]];}}
+        y[ii] += sum * lev->invd[ii];
+    }
+}
+
+// >>>>> Dense LU factorization of the coarsest operator <<<<<
+// The operator is diagonally dominant, so no pivoting is applied. If the
+// aggregation stalled above AMG_NCOARSE the last level is only smoothed.
+static void coarse_factor(Amg *amg)
+{
+    size_t ii, jj, kk, n = amg->ncoarse;
+    double *lu, fac;
+    AmgLevel *lev = &amg->lev[amg->nlevel-1];
+    free(amg->lu);
+    amg->lu = NULL;
+    if (n > AMG_NCOARSE)    {return;}
+    lu = malloc(n*n*sizeof(double));
+    amg->lu = lu;
+    for (ii = 0; ii < n*n; ii++)    {lu[ii] = 0.0;}
+    for (ii = 0; ii < n; ii++)
+    {
+        for (kk = lev->ia[ii]; kk < lev->ia[ii+1]; kk++)    {lu[ii*n+lev->ja[kk]] = lev->a[kk];}
+        lu[ii*n+ii] = 1.0 / lev->invd[ii];
+    }
+    for (kk = 0; kk < n; kk++)
+    {
+        for (ii = kk+1; ii < n; ii++)
+        {
+            if (lu[ii*n+kk] != 0.0)
+            {
+                fac = lu[ii*n+kk] / lu[kk*n+kk];
+                lu[ii*n+kk] = fac;
+                for (jj = kk+1; jj < n; jj++)   {lu[ii*n+jj] -= fac * lu[kk*n+jj];}
+            }
+        }
+    }
+}
+
+// >>>>> Solve with the coarsest operator <<<<<
+static void coarse_solve(Amg *amg, double *x, double *b)
+{
+    size_t ii, jj, n = amg->ncoarse;
+    double *lu = amg->lu, sum;
+    if (lu == NULL)
+    {
+        level_sgs(&amg->lev[amg->nlevel-1], x, b);
+        return;
+    }
+    for (ii = 0; ii < n; ii++)
+    {
+        sum = b[ii];
+        for (jj = 0; jj < ii; jj++) {sum -= lu[ii*n+jj] * x[jj];}
+        x[ii] = sum;
+    }
+    for (ii = n; ii-- > 0; )
+    {
+        sum = x[ii];
+        for (jj = ii+1; jj < n; jj++)   {sum -= lu[ii*n+jj] * x[jj];}
+        x[ii] = sum / lu[ii*n+ii];
+    }
+}
+
+// >>>>> Recursive (1,1) cycle with symmetric Gauss-Seidel smoothing <<<<<
+// cycle = 1 gives a V-cycle, cycle = 2 a W-cycle. Both are symmetric, also
+// with the line smoother on the fine level, which is a symmetric block solve.
+static void cycle(Amg *amg, int ll, double *x, double *b)
+{
+    int cc;
+    size_t ii;
+    AmgLevel *lev = &amg->lev[ll], *cl;
+    double *res = lev->res, scale = amg->scale;
+    // the over-correction is only safe with the operators of the current
+    // matrix, a reused hierarchy keeps the plain coarse grid correction so
+    // the cycle stays a positive definite preconditioner for CG
+    if (amg->reused == 1)   {scale = 1.0;}
+    if (ll == amg->nlevel-1)
+    {
+        coarse_solve(amg, x, b);
+        return;
+    }
+    // pre-smoothing from zero initial guess
+    if (ll == 0 & amg->line != NULL)    {zline_solve(amg->line, x, b);}
+    else    {level_sgs(lev, x, b);}
+    level_matvec(lev, res, x);
+    for (ii = 0; ii < lev->n; ii++) {res[ii] = b[ii] - res[ii];}
+    // coarse grid correction, restriction sums the residuals of an aggregate
+    cl = &amg->lev[ll+1];
+    for (ii = 0; ii < cl->n; ii++)  {cl->b[ii] = 0.0;}
+    for (ii = 0; ii < lev->n; ii++)
+    {if (lev->agg[ii] >= 0)    {cl->b[lev->agg[ii]] += res[ii];}}
+    cycle(amg, ll+1, cl->x, cl->b);
+    for (cc = 1; cc < amg->cycle & ll+1 < amg->nlevel-1; cc++)
+    {
+        level_matvec(cl, cl->tmp, cl->x);
+        for (ii = 0; ii < cl->n; ii++)  {cl->tmp[ii] = cl->b[ii] - cl->tmp[ii];}
+        cycle(amg, ll+1, cl->cor, cl->tmp);
+        for (ii = 0; ii < cl->n; ii++)  {cl->x[ii] += cl->cor[ii];}
+    }
+    for (ii = 0; ii < lev->n; ii++)
+    {if (lev->agg[ii] >= 0)    {x[ii] += scale * cl->x[lev->agg[ii]];}}
+    // post-smoothing, the same symmetric sweep keeps the cycle symmetric
+    level_matvec(lev, res, x);
+    for (ii = 0; ii < lev->n; ii++) {res[ii] = b[ii] - res[ii];}
+    if (ll == 0 & amg->line != NULL)    {zline_solve(amg->line, res, res);}
+    else    {level_sgs(lev, res, res);}
+    for (ii = 0; ii < lev->n; ii++) {x[ii] += res[ii];}
+}
@@ -0,0 +1,41 @@
+// Header file for amg.c
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+#include "zline.h"
+
+#ifndef AMG_H
+#define AMG_H
+
+// one level of the aggregation hierarchy, operator in compressed rows
+typedef struct AmgLevel
+{
+    size_t n, *ia, *ja;
+    double *a, *invd;
+    int *agg;
+    double *x, *b, *res, *tmp, *cor;
+}AmgLevel;
+
+// algebraic multigrid hierarchy of a LASPack matrix
+// Level 0 follows the matrix values of every solve, the coarse levels are
+// kept from the last setup until any entry drifts beyond drift. If line
+// is set, the fine level is smoothed by the vertical line solve instead of
+// symmetric Gauss-Seidel.
+typedef struct Amg
+{
+    int nlevel, cycle, nsetup, nreuse, reused;
+    size_t ncoarse;
+    double scale, theta, drift;
+    double *asetup, *lu;
+    AmgLevel *lev;
+    ZLine *line;
+}Amg;
+
+#endif
+
+void init_amg(Amg **amg, QMatrix *A, double drift);
+void amg_update(Amg *amg, QMatrix *A);
+void amg_setup(Amg *amg);
+void amg_cycle(Amg *amg, double *x, double *b);
+void amg_activate(Amg *amg);
+Vector *AMGPrecond(QMatrix *A, Vector *y, Vector *c, double omega);
@@ -0,0 +1,94 @@
+// Single allocation for the fields of Data
+// The fields are registered first and carved out of one block afterwards,
+// every field starts on a 64-byte boundary. The block is optionally backed
+// by transparent huge pages. A field of at least one page (4 KB, or 2 MB
+// with huge pages) starts on a page of its own and is first touched by the
+// threads of the static schedule used by the cell loops, so on a NUMA node
+// every thread finds its part of the field in its local memory, apart from
+// the pages at the chunk edges. Smaller fields share pages with their
+// neighbors and stay on the node that touches them first.
+#include<stdio.h>
+#include<stdlib.h>
+#include<string.h>
+#include<sys/mman.h>
+
+#include "arena.h"
+
+void init_arena(Arena **arena, int huge);
+void arena_add(Arena *arena, void *field, size_t len, size_t size);
+void arena_alloc(Arena *arena);
+
+// >>>>> Empty registry <<<<<
+void init_arena(Arena **arena, int huge)
+{
+    *arena = malloc(sizeof(Arena));
+    (*arena)->nfield = 0;
+    (*arena)->maxfield = 0;
+    (*arena)->field = NULL;
+    (*arena)->len = NULL;
+    (*arena)->size = NULL;
+    (*arena)->offset = NULL;
+    (*arena)->huge = huge;
+    (*arena)->used = 0;
+    (*arena)->base = NULL;
+}
+
+// >>>>> Register a field of len elements of size bytes <<<<<
+// field is the address of the pointer, e.g. &(*data)->uu
+void arena_add(Arena *arena, void *field, size_t len, size_t size)
+{
+    int kk = arena->nfield;
+    size_t page = ARENA_PAGE;
+    if (kk == arena->maxfield)
+    {
+        arena->maxfield = 2*arena->maxfield + 64;
+        arena->field = realloc(arena->field, arena->maxfield*sizeof(void *));
+        arena->len = realloc(arena->len, arena->maxfield*sizeof(size_t));
+        arena->size = realloc(arena->size, arena->maxfield*sizeof(size_t));
+        arena->offset = realloc(arena->offset, arena->maxfield*sizeof(size_t));
+    }
+    if (len == 0)   {len = 1;}
+    arena->field[kk] = field;
+    arena->len[kk] = len;
+    arena->size[kk] = size;
+    if (arena->huge == 1)   {page = ARENA_HUGEPAGE;}
+    if (len*size >= page)   {arena->used = (arena->used + page - 1) / page * page;}
+    arena->offset[kk] = arena->used;
+    arena->used += (len*size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+    arena->nfield += 1;
+}
+
+// >>>>> Allocate the arena, set the field pointers and zero the fields <<<<<
+void arena_alloc(Arena *arena)
+{
+    int kk;
+    long ii;
+    size_t align = ARENA_PAGE, size;
+    char *ptr;
+    if (arena->huge == 1)
+    {
+        align = ARENA_HUGEPAGE;
+        arena->used = (arena->used + align - 1) / align * align;
+    }
+    if (posix_memalign((void **) &arena->base, align, arena->used) != 0)
+    {printf("WARNING: Allocation of %zu bytes for the data fields failed!\n",arena->used);   exit(1);}
+    #ifdef MADV_HUGEPAGE
+    if (arena->huge == 1)
+    {
+        if (madvise(arena->base, arena->used, MADV_HUGEPAGE) != 0)
+        {printf("WARNING: Huge pages are not available for the data fields!\n");  arena->huge = 0;}
+    }
+    #else
+    if (arena->huge == 1)
+    {printf("WARNING: Huge pages are not supported on this system!\n");   arena->huge = 0;}
+    #endif
+    for (kk = 0; kk < arena->nfield; kk++)
+    {
+        ptr = arena->base + arena->offset[kk];
+        *(void **) arena->field[kk] = ptr;
+        // first touch in the static schedule of the cell loops
+        size = arena->size[kk];
+        #pragma omp parallel for schedule(static)
+        for (ii = 0; ii < (long) arena->len[kk]; ii++)  {memset(ptr + ii*size, 0, size);}
+    }
+}
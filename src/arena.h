@@ -0,0 +1,29 @@
+// Header file for arena.c
+#include<stddef.h>
+
+#ifndef ARENA_H
+#define ARENA_H
+
+// alignment of every field, one cache line and the widest SIMD register
+#define ARENA_ALIGN 64
+// page size, a field of at least one page starts on a page boundary
+#define ARENA_PAGE 4096
+// page size and size granule of an arena backed by huge pages
+#define ARENA_HUGEPAGE 2097152
+
+// registry of the fields carved out of one allocation
+// Every field is the address of a pointer in Data with its length and
+// element size. arena_alloc sets all pointers at once.
+typedef struct Arena
+{
+    int nfield, maxfield, huge;
+    void **field;
+    size_t *len, *size, *offset, used;
+    char *base;
+}Arena;
+
+#endif
+
+void init_arena(Arena **arena, int huge);
+void arena_add(Arena *arena, void *field, size_t len, size_t size);
+void arena_alloc(Arena *arena);
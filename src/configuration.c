@@ -33,6 +33,10 @@ void read_input(Config **param)
     (*param)->use_mpi = (int) read_one_input_double("use_mpi", "input");
     (*param)->mpi_nx = (int) read_one_input_double("mpi_nx", "input");
     (*param)->mpi_ny = (int) read_one_input_double("mpi_ny", "input");
+    // hybrid mode, mpi_auto = 1 replaces mpi_nx and mpi_ny by mpi_decompose
+    (*param)->mpi_auto = (int) read_one_input_double("mpi_auto", "input");
+    (*param)->n_thread = (int) read_one_input_double("n_thread", "input");
+    (*param)->use_hugepage = (int) read_one_input_double("use_hugepage", "input");
 
     // Time control
     (*param)->dt = read_one_input_double("dt", "input");
@@ -69,6 +73,7 @@ void read_input(Config **param)
     (*param)->sim_shallowwater = (int) read_one_input_double("sim_shallowwater", "input");
     (*param)->difuwave = (int) read_one_input_double("difuwave", "input");
     (*param)->bctype_SW = read_one_input_array("bctype_SW", "input", 4);
+    (*param)->use_stencil = (int) read_one_input_double("use_stencil", "input");
 
     (*param)->init_eta = read_one_input_double("init_eta", "input");
     (*param)->eta_file = (int) read_one_input_double("eta_file", "input");
@@ -116,6 +121,9 @@ void read_input(Config **param)
     (*param)->wcr = read_one_input_double("wcr", "input");
     (*param)->soil_a = read_one_input_double("soil_a", "input");
     (*param)->soil_n = read_one_input_double("soil_n", "input");
+    (*param)->use_vg_table = (int) read_one_input_double("use_vg_table", "input");
+    (*param)->vg_table_tol = read_one_input_double("vg_table_tol", "input");
+    (*param)->vg_table_check = (int) read_one_input_double("vg_table_check", "input");
     // groundwater initial condition
     (*param)->init_wc = read_one_input_double("init_wc", "input");
     (*param)->init_h = read_one_input_double("init_h", "input");
@@ -123,6 +131,8 @@ void read_input(Config **param)
     (*param)->init_wt_rel = read_one_input_double("init_wt_rel", "input");
     (*param)->h_file = (int) read_one_input_double("h_file", "input");
     (*param)->wc_file = (int) read_one_input_double("wc_file", "input");
+    (*param)->soil_file = (int) read_one_input_double("soil_file", "input");
+    (*param)->n_soil = (int) read_one_input_double("n_soil", "input");
     (*param)->qtop = read_one_input_double("qtop", "input");
     (*param)->qbot = read_one_input_double("qbot", "input");
     (*param)->htop = read_one_input_double("htop", "input");
@@ -130,6 +140,97 @@ void read_input(Config **param)
     // groundwater boundary condition
     (*param)->bctype_GW = read_one_input_array("bctype_GW", "input", 6);
 
+    // Linear solvers
+    (*param)->warm_start = (int) read_one_input_double("warm_start", "input");
+    (*param)->precond_SW = (int) read_one_input_double("precond_SW", "input");
+    if ((*param)->precond_SW == 1 & (*param)->use_stencil == 0)
+    {
+        printf("WARNING: Multigrid preconditioner requires the stencil solver, use_stencil is set to 1!\n");
+        (*param)->use_stencil = 1;
+    }
+    else if ((*param)->precond_SW >= 2 & (*param)->use_stencil == 1)
+    {
+        printf("WARNING: ILU and multicolor SSOR require the sparse matrix, use_stencil is set to 0!\n");
+        (*param)->use_stencil = 0;
+    }
+    (*param)->precond_GW = (int) read_one_input_double("precond_GW", "input");
+    (*param)->amg_drift = read_one_input_double("amg_drift", "input");
+    (*param)->ilu_drift = read_one_input_double("ilu_drift", "input");
+    (*param)->global_solve = (int) read_one_input_double("global_solve", "input");
+    (*param)->krylov_SW = (int) read_one_input_double("krylov_SW", "input");
+    (*param)->krylov_GW = (int) read_one_input_double("krylov_GW", "input");
+    // pipelined CG is a variant of the global solve, which otherwise only runs CG
+    if ((*param)->krylov_SW == 4 & ((*param)->use_mpi == 0 | (*param)->global_solve == 0))
+    {
+        printf("WARNING: Pipelined CG requires the global solve, krylov_SW is set to 0!\n");
+        (*param)->krylov_SW = 0;
+    }
+    else if ((*param)->krylov_SW != 0 & (*param)->krylov_SW != 4 & \
+        ((*param)->use_stencil == 1 | ((*param)->use_mpi == 1 & (*param)->global_solve == 1)))
+    {
+        printf("WARNING: The stencil solver and the global solve only support CG, krylov_SW is set to 0!\n");
+        (*param)->krylov_SW = 0;
+    }
+    if ((*param)->krylov_GW == 4 & ((*param)->use_mpi == 0 | (*param)->global_solve == 0))
+    {
+        printf("WARNING: Pipelined CG requires the global solve, krylov_GW is set to 0!\n");
+        (*param)->krylov_GW = 0;
+    }
+    else if ((*param)->krylov_GW != 0 & (*param)->krylov_GW != 4 & (*param)->use_mpi == 1 & (*param)->global_solve == 1)
+    {
+        printf("WARNING: The global solve only supports CG, krylov_GW is set to 0!\n");
+        (*param)->krylov_GW = 0;
+    }
+    // deflated CG keeps deflate_SW / deflate_GW vectors between the solves
+    (*param)->deflate_SW = (int) read_one_input_double("deflate_SW", "input");
+    (*param)->deflate_GW = (int) read_one_input_double("deflate_GW", "input");
+    if ((*param)->deflate_SW <= 0)  {(*param)->deflate_SW = 4;}
+    if ((*param)->deflate_GW <= 0)  {(*param)->deflate_GW = 4;}
+    (*param)->omega_SW = read_one_input_double("omega_SW", "input");
+    (*param)->omega_GW = read_one_input_double("omega_GW", "input");
+    if ((*param)->omega_SW <= 0.0 | (*param)->omega_SW >= 2.0) {(*param)->omega_SW = 1.0;}
+    if ((*param)->omega_GW <= 0.0 | (*param)->omega_GW >= 2.0) {(*param)->omega_GW = 1.0;}
+    (*param)->maxiter_SW = (int) read_one_input_double("maxiter_SW", "input");
+    (*param)->maxiter_GW = (int) read_one_input_double("maxiter_GW", "input");
+    if ((*param)->maxiter_SW <= 0)  {(*param)->maxiter_SW = 10000000;}
+    if ((*param)->maxiter_GW <= 0)  {(*param)->maxiter_GW = 10000000;}
+    // single precision works with the SSOR preconditioner of the sparse matrix
+    (*param)->mixed_SW = (int) read_one_input_double("mixed_SW", "input");
+    (*param)->mixed_GW = (int) read_one_input_double("mixed_GW", "input");
+    if ((*param)->mixed_SW != 0 & ((*param)->use_stencil == 1 | (*param)->precond_SW != 0 | (*param)->krylov_SW != 0))
+    {
+        printf("WARNING: Single precision requires use_stencil = 0, precond_SW = 0 and krylov_SW = 0, mixed_SW is set to 0!\n");
+        (*param)->mixed_SW = 0;
+    }
+    if ((*param)->mixed_GW != 0 & ((*param)->precond_GW != 0 | (*param)->krylov_GW != 0))
+    {
+        printf("WARNING: Single precision requires precond_GW = 0 and krylov_GW = 0, mixed_GW is set to 0!\n");
+        (*param)->mixed_GW = 0;
+    }
+    if ((*param)->use_mpi == 1 & (*param)->global_solve == 1)
+    {
+        if ((*param)->mixed_SW == 2 | (*param)->mixed_GW == 2)
+        {printf("WARNING: The global solve has no iterative refinement, single precision SSOR is used instead!\n");}
+        if ((*param)->mixed_SW == 2)    {(*param)->mixed_SW = 1;}
+        if ((*param)->mixed_GW == 2)    {(*param)->mixed_GW = 1;}
+    }
+    (*param)->tol_SW = read_one_input_double("tol_SW", "input");
+    (*param)->tol_GW = read_one_input_double("tol_GW", "input");
+    if ((*param)->tol_SW <= 0.0)    {(*param)->tol_SW = 0.00000001;}
+    if ((*param)->tol_GW <= 0.0)    {(*param)->tol_GW = 0.00000001;}
+    // adaptive tolerance, tol_fac scales both tolerances during the run
+    (*param)->tol_adapt = (int) read_one_input_double("tol_adapt", "input");
+    (*param)->tol_max = read_one_input_double("tol_max", "input");
+    (*param)->vloss_budget = read_one_input_double("vloss_budget", "input");
+    if ((*param)->tol_max <= 0.0)   {(*param)->tol_max = 0.000001;}
+    if ((*param)->tol_adapt == 1 & (*param)->sim_groundwater == 0)
+    {
+        printf("WARNING: Adaptive tolerance requires the groundwater volume loss, tol_adapt is set to 0!\n");
+        (*param)->tol_adapt = 0;
+    }
+    (*param)->tol_fac = 1.0;
+    (*param)->solver_log = (int) read_one_input_double("solver_log", "input");
+
     // Scalar transport
     (*param)->n_scalar = (int) read_one_input_double("n_scalar", "input");
     (*param)->baroclinic = (int) read_one_input_double("baroclinic", "input");
@@ -8,7 +8,7 @@ typedef struct Config
     // Directory
     char finput[100], foutput[100], sim_id[6];
     // Domain Geometry
-    int NX, NY, NZ, nx, ny, nz, use_mpi, mpi_nx, mpi_ny;
+    int NX, NY, NZ, nx, ny, nz, use_mpi, mpi_nx, mpi_ny, mpi_auto, n_thread, use_hugepage;
     int n2ci, n2ct, N2CI, n3ci, n3ct, N3CI;
     double dx, dy, dz, botZ, dz_incre;
     // Time Control
@@ -20,7 +20,7 @@ typedef struct Config
     double grav, viscx, viscy, rhoa, rhow;
     double min_dept, wtfh, hD, manning;
     // Surface water
-    int sim_shallowwater, eta_file, uv_file, difuwave;
+    int sim_shallowwater, eta_file, uv_file, difuwave, use_stencil;
     double init_eta, *init_tide, *init_inflow, q_evap, q_rain;
     int *bctype_SW, *inflow_locX, *inflow_locY;
     int n_tide, n_inflow, *tide_locX, *tide_locY;
@@ -31,16 +31,20 @@ typedef struct Config
     // subgrid model
     int use_subgrid;
     // Groundwater
-    int sim_groundwater, dt_adjust, use_corrector, post_allocate, use_mvg, use_full3d;
+    int sim_groundwater, dt_adjust, use_corrector, post_allocate, use_mvg, use_full3d, use_vg_table, vg_table_check;
     double init_h, init_wc, init_wt_abs, init_wt_rel, qtop, qbot, htop, hbot, aev;
-    double dt_max, dt_min, Co_max, Ksx, Ksy, Ksz, Ss, wcr, wcs, soil_a, soil_n;
-    int *bctype_GW, h_file, wc_file;
+    double dt_max, dt_min, Co_max, Ksx, Ksy, Ksz, Ss, wcr, wcs, soil_a, soil_n, vg_table_tol;
+    int *bctype_GW, h_file, wc_file, soil_file, n_soil;
     // Scalar
     int n_scalar, *scalar_surf_file, *scalar_tide_datlen, *scalar_tide_file, *scalar_inflow_datlen, *scalar_inflow_file;
     int *scalar_subs_file, baroclinic;
     double difux, difuy, difuz, disp_lat, disp_lon;
     double *init_s_surf, *init_s_subs;
     double *s_tide, *s_inflow;
+    // Linear solvers
+    int warm_start, precond_SW, precond_GW, global_solve;
+    int deflate_SW, deflate_GW, krylov_SW, krylov_GW, maxiter_SW, maxiter_GW, tol_adapt, mixed_SW, mixed_GW, solver_log;
+    double amg_drift, ilu_drift, omega_SW, omega_GW, tol_SW, tol_GW, tol_max, tol_fac, vloss_budget;
 
 }Config;
 
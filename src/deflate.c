@@ -0,0 +1,334 @@
+// Deflation subspace for CG recycled over consecutive solves
+// The surface and subsurface systems change slowly between time steps, and
+// the eigenvectors of their smallest eigenvalues, e.g. the smooth modes of a
+// large wet basin, stay nearly the same for many steps. CG spends most of
+// its iterations on these modes. Deflated CG keeps a few approximate
+// eigenvectors w, removes their components from the initial residual and
+// keeps all search directions A-orthogonal to them. After every solve the
+// subspace is improved by a Rayleigh-Ritz step over the old vectors and the
+// first search directions of the solve.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include "deflate.h"
+
+void init_deflate(Deflate **df, size_t n, int k);
+int deflate_setup(Deflate *df, DeflateOperator matvec, DeflateOperator tmatvec, void *ctx);
+void deflate_start(Deflate *df, double *x, double *r);
+void deflate_direction(Deflate *df, double *p);
+void deflate_store(Deflate *df, double *p, double *ap);
+void deflate_update(Deflate *df);
+static void coarse_solve(Deflate *df);
+static void jacobi_eigen(double *g, double *v, int s);
+
+// >>>>> Allocate k deflation vectors of length n <<<<<
+void init_deflate(Deflate **df, size_t n, int k)
+{
+    if (k > DEFLATE_MAXK)   {k = DEFLATE_MAXK;}
+    *df = malloc(sizeof(Deflate));
+    (*df)->n = n;
+    (*df)->k = k;
+    (*df)->m = 2 * k;
+    (*df)->nw = 0;
+    (*df)->np = 0;
+    (*df)->w = malloc(k*n*sizeof(double));
+    (*df)->aw = malloc(k*n*sizeof(double));
+    (*df)->wn = malloc(k*n*sizeof(double));
+    (*df)->awn = malloc(k*n*sizeof(double));
+    (*df)->atw = malloc(k*n*sizeof(double));
+    (*df)->p = malloc(2*k*n*sizeof(double));
+    (*df)->ap = malloc(2*k*n*sizeof(double));
+    (*df)->e = malloc(k*k*sizeof(double));
+    (*df)->mu = malloc(k*sizeof(double));
+    (*df)->piv = malloc(k*sizeof(int));
+}
+
+// >>>>> A*w, A'*w and the factor of w'*A*w for the current matrix <<<<<
+// The surface matrix is not exactly symmetric, so the projections use
+// A'*w and w'*A*w is factorized by LU with partial pivoting. Returns the
+// number of deflation vectors in use.
+int deflate_setup(Deflate *df, DeflateOperator matvec, DeflateOperator tmatvec, void *ctx)
+{
+    int ii, jj, ll, imax, nw = df->nw;
+    size_t kk, n = df->n;
+    double sum, *e = df->e;
+    df->np = 0;
+    for (ii = 0; ii < nw; ii++)
+    {
+        (*matvec)(ctx, df->aw+ii*n, df->w+ii*n);
+        (*tmatvec)(ctx, df->atw+ii*n, df->w+ii*n);
+    }
+    for (ii = 0; ii < nw; ii++)
+    {
+        for (jj = 0; jj < nw; jj++)
+        {
+            sum = 0.0;
+            for (kk = 0; kk < n; kk++)  {sum += df->w[ii*n+kk] * df->aw[jj*n+kk];}
+            e[ii*nw+jj] = sum;
+        }
+    }
+    // the subspace is dropped if w'*A*w is singular
+    for (jj = 0; jj < nw; jj++)
+    {
+        imax = jj;
+        for (ii = jj+1; ii < nw; ii++)
+        {if (fabs(e[ii*nw+jj]) > fabs(e[imax*nw+jj]))  {imax = ii;}}
+        df->piv[jj] = imax;
+        if (imax != jj)
+        {
+            for (ll = 0; ll < nw; ll++)
+            {
+                sum = e[jj*nw+ll];
+                e[jj*nw+ll] = e[imax*nw+ll];
+                e[imax*nw+ll] = sum;
+            }
+        }
+        if (e[jj*nw+jj] == 0.0)
+        {
+            df->nw = 0;
+            return 0;
+        }
+        for (ii = jj+1; ii < nw; ii++)
+        {
+            e[ii*nw+jj] /= e[jj*nw+jj];
+            for (ll = jj+1; ll < nw; ll++)  {e[ii*nw+ll] -= e[ii*nw+jj] * e[jj*nw+ll];}
+        }
+    }
+    return nw;
+}
+
+// >>>>> mu = (w'*A*w)^(-1) * mu <<<<<
+static void coarse_solve(Deflate *df)
+{
+    int ii, ll, nw = df->nw;
+    double sum, *e = df->e, *mu = df->mu;
+    for (ii = 0; ii < nw; ii++)
+    {
+        if (df->piv[ii] != ii)
+        {
+            sum = mu[ii];
+            mu[ii] = mu[df->piv[ii]];
+            mu[df->piv[ii]] = sum;
+        }
+        for (ll = 0; ll < ii; ll++) {mu[ii] -= e[ii*nw+ll] * mu[ll];}
+    }
+    for (ii = nw-1; ii >= 0; ii--)
+    {
+        for (ll = ii+1; ll < nw; ll++)  {mu[ii] -= e[ii*nw+ll] * mu[ll];}
+        mu[ii] /= e[ii*nw+ii];
+    }
+}
+
+// >>>>> Remove the subspace components of the initial residual <<<<<
+// x += w*mu and r -= A*w*mu with mu = (w'*A*w)^(-1) * w'*r
+void deflate_start(Deflate *df, double *x, double *r)
+{
+    int ii;
+    size_t kk, n = df->n;
+    double sum;
+    for (ii = 0; ii < df->nw; ii++)
+    {
+        sum = 0.0;
+        for (kk = 0; kk < n; kk++)  {sum += df->w[ii*n+kk] * r[kk];}
+        df->mu[ii] = sum;
+    }
+    coarse_solve(df);
+    for (ii = 0; ii < df->nw; ii++)
+    {
+        for (kk = 0; kk < n; kk++)
+        {
+            x[kk] += df->mu[ii] * df->w[ii*n+kk];
+            r[kk] -= df->mu[ii] * df->aw[ii*n+kk];
+        }
+    }
+}
+
+// >>>>> Make the search direction A-orthogonal to the subspace <<<<<
+// p -= w*mu with mu = (w'*A*w)^(-1) * (A'*w)'*p, so that w'*A*p = 0
+void deflate_direction(Deflate *df, double *p)
+{
+    int ii;
+    size_t kk, n = df->n;
+    double sum;
+    for (ii = 0; ii < df->nw; ii++)
+    {
+        sum = 0.0;
+        for (kk = 0; kk < n; kk++)  {sum += df->atw[ii*n+kk] * p[kk];}
+        df->mu[ii] = sum;
+    }
+    coarse_solve(df);
+    for (ii = 0; ii < df->nw; ii++)
+    {for (kk = 0; kk < n; kk++)    {p[kk] -= df->mu[ii] * df->w[ii*n+kk];}}
+}
+
+// >>>>> Keep the first m search directions of the solve <<<<<
+void deflate_store(Deflate *df, double *p, double *ap)
+{
+    size_t kk, n = df->n;
+    if (df->np >= df->m)    {return;}
+    for (kk = 0; kk < n; kk++)
+    {
+        df->p[df->np*n+kk] = p[kk];
+        df->ap[df->np*n+kk] = ap[kk];
+    }
+    df->np += 1;
+}
+
+// >>>>> Rayleigh-Ritz step for the next subspace <<<<<
+// The old vectors and the stored directions are orthonormalized, A*z follows
+// the same operations. The Ritz vectors of the k smallest Ritz values of
+// z'*A*z form the next subspace.
+void deflate_update(Deflate *df)
+{
+    int ii, jj, ll, s = 0, nk, kmin, order[3*DEFLATE_MAXK];
+    size_t kk, n = df->n;
+    double sum, nrm, *z[3*DEFLATE_MAXK], *az[3*DEFLATE_MAXK], *tmp;
+    double g[9*DEFLATE_MAXK*DEFLATE_MAXK], v[9*DEFLATE_MAXK*DEFLATE_MAXK];
+    for (ii = 0; ii < df->nw; ii++)
+    {
+        z[s] = df->w + ii*n;
+        az[s] = df->aw + ii*n;
+        s++;
+    }
+    for (ii = 0; ii < df->np; ii++)
+    {
+        z[s] = df->p + ii*n;
+        az[s] = df->ap + ii*n;
+        s++;
+    }
+    // modified Gram-Schmidt, nearly dependent vectors are dropped
+    jj = 0;
+    for (ii = 0; ii < s; ii++)
+    {
+        nrm = 0.0;
+        for (kk = 0; kk < n; kk++)  {nrm += z[ii][kk] * z[ii][kk];}
+        nrm = sqrt(nrm);
+        for (ll = 0; ll < jj; ll++)
+        {
+            sum = 0.0;
+            for (kk = 0; kk < n; kk++)  {sum += z[ll][kk] * z[ii][kk];}
+            for (kk = 0; kk < n; kk++)
+            {
+                z[ii][kk] -= sum * z[ll][kk];
+                az[ii][kk] -= sum * az[ll][kk];
+            }
+        }
+        sum = 0.0;
+        for (kk = 0; kk < n; kk++)  {sum += z[ii][kk] * z[ii][kk];}
+        sum = sqrt(sum);
+        if (sum <= 0.00000001 * nrm | sum == 0.0)  {continue;}
+        for (kk = 0; kk < n; kk++)
+        {
+            z[ii][kk] /= sum;
+            az[ii][kk] /= sum;
+        }
+        z[jj] = z[ii];
+        az[jj] = az[ii];
+        jj++;
+    }
+    s = jj;
+    // Ritz values and vectors of the symmetric part of z'*A*z
+    for (ii = 0; ii < s; ii++)
+    {
+        for (jj = 0; jj <= ii; jj++)
+        {
+            sum = 0.0;
+            for (kk = 0; kk < n; kk++)  {sum += z[ii][kk] * az[jj][kk] + z[jj][kk] * az[ii][kk];}
+            g[ii*s+jj] = 0.5 * sum;
+            g[jj*s+ii] = 0.5 * sum;
+        }
+    }
+    jacobi_eigen(g, v, s);
+    // selection sort of the Ritz values on the diagonal of g
+    for (ii = 0; ii < s; ii++)  {order[ii] = ii;}
+    for (ii = 0; ii < s; ii++)
+    {
+        kmin = ii;
+        for (jj = ii+1; jj < s; jj++)
+        {if (g[order[jj]*s+order[jj]] < g[order[kmin]*s+order[kmin]])  {kmin = jj;}}
+        ll = order[ii];
+        order[ii] = order[kmin];
+        order[kmin] = ll;
+    }
+    // w = z*v and A*w = A*z*v for the k smallest, then swap with the old set
+    nk = s;
+    if (nk > df->k) {nk = df->k;}
+    for (ii = 0; ii < nk; ii++)
+    {
+        for (kk = 0; kk < n; kk++)
+        {
+            df->wn[ii*n+kk] = 0.0;
+            df->awn[ii*n+kk] = 0.0;
+        }
+        for (jj = 0; jj < s; jj++)
+        {
+            sum = v[jj*s+order[ii]];
+            for (kk = 0; kk < n; kk++)
+            {
+                df->wn[ii*n+kk] += sum * z[jj][kk];
+                df->awn[ii*n+kk] += sum * az[jj][kk];
+            }
+        }
+    }
+    tmp = df->w;
+    df->w = df->wn;
+    df->wn = tmp;
+    tmp = df->aw;
+    df->aw = df->awn;
+    df->awn = tmp;
+    df->nw = nk;
+    df->np = 0;
+}
+
+// >>>>> Cyclic Jacobi rotations for the symmetric s x s matrix g <<<<<
+// On return the diagonal of g holds the eigenvalues, the columns of v the
+// eigenvectors.
+static void jacobi_eigen(double *g, double *v, int s)
+{
+    int ii, jj, ll, sweep;
+    double off, theta, t, c, sn, gil, gjl;
+    for (ii = 0; ii < s*s; ii++)    {v[ii] = 0.0;}
+    for (ii = 0; ii < s; ii++)  {v[ii*s+ii] = 1.0;}
+    for (sweep = 0; sweep < 50; sweep++)
+    {
+        off = 0.0;
+        for (ii = 0; ii < s; ii++)
+        {for (jj = ii+1; jj < s; jj++) {off += g[ii*s+jj] * g[ii*s+jj];}}
+        if (off < 1e-30)    {break;}
+        for (ii = 0; ii < s; ii++)
+        {
+            for (jj = ii+1; jj < s; jj++)
+            {
+                if (g[ii*s+jj] == 0.0)  {continue;}
+                theta = (g[jj*s+jj] - g[ii*s+ii]) / (2.0 * g[ii*s+jj]);
+                t = 1.0 / (fabs(theta) + sqrt(theta*theta + 1.0));
+                if (theta < 0.0)    {t = -t;}
+                c = 1.0 / sqrt(t*t + 1.0);
+                sn = t * c;
+                // g = R' * g * R with the rotation R in the plane (ii, jj)
+                for (ll = 0; ll < s; ll++)
+                {
+                    gil = g[ll*s+ii];
+                    gjl = g[ll*s+jj];
+                    g[ll*s+ii] = c * gil - sn * gjl;
+                    g[ll*s+jj] = sn * gil + c * gjl;
+                }
+                for (ll = 0; ll < s; ll++)
+                {
+                    gil = g[ii*s+ll];
+                    gjl = g[jj*s+ll];
+                    g[ii*s+ll] = c * gil - sn * gjl;
+                    g[jj*s+ll] = sn * gil + c * gjl;
+                }
+                for (ll = 0; ll < s; ll++)
+                {
+                    gil = v[ll*s+ii];
+                    gjl = v[ll*s+jj];
+                    v[ll*s+ii] = c * gil - sn * gjl;
+                    v[ll*s+jj] = sn * gil + c * gjl;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,32 @@
+// Header file for deflate.c
+
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+// maximum number of deflation vectors
+#define DEFLATE_MAXK 16
+
+// y = A*x or y = A'*x on plain arrays, as linsys_apply
+typedef void (*DeflateOperator)(void *ctx, double *y, double *x);
+
+// deflation subspace recycled over consecutive solves
+// w holds nw approximate eigenvectors of the smallest eigenvalues of A,
+// aw = A*w and atw = A'*w, e and piv the LU factors of w'*A*w. p and ap keep the first np
+// search directions of the current solve, from which the next subspace is
+// extracted into wn and awn. Vectors are stored one after the other, n
+// entries each.
+typedef struct Deflate
+{
+    int k, m, nw, np, *piv;
+    size_t n;
+    double *w, *aw, *wn, *awn, *atw, *p, *ap, *e, *mu;
+}Deflate;
+
+#endif
+
+void init_deflate(Deflate **df, size_t n, int k);
+int deflate_setup(Deflate *df, DeflateOperator matvec, DeflateOperator tmatvec, void *ctx);
+void deflate_start(Deflate *df, double *x, double *r);
+void deflate_direction(Deflate *df, double *p);
+void deflate_store(Deflate *df, double *p, double *ap);
+void deflate_update(Deflate *df);
@@ -2,6 +2,7 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<time.h>
+#include<omp.h>
 #include<math.h>
 #include<string.h>
 #include<stdbool.h>
@@ -32,19 +33,23 @@
 void solve_groundwater(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank);
 void compute_K_face(Data **data, Map *gmap, Config *param, int irank, int nrank);
 void groundwater_mat_coeff(Data **data, Map *gmap, Config *param);
-void groundwater_rhs(Data **data, Map *gmap, Config *param);
-void build_groundwater_system(Data *data, Map *gmap, Config *param, QMatrix A, Vector b);
-void solve_groundwater_system(Data **data, Map *gmap, QMatrix A, Vector b, Vector x, Config *param);
+void groundwater_rhs(Data **data, Map *gmap, Config *param, int irank);
+void init_groundwater_system(Data **data, Map *gmap, Config *param, int irank, int nrank);
+void groundwater_halo(Data *data, Map *gmap, Config *param, ParCG *cg, int irank);
+static int neighbor_row(Map *gmap, Config *param, int nb);
+void build_groundwater_system(Data *data, Map *gmap, Config *param, LinSys *sys);
+void solve_groundwater_system(Data **data, Map *gmap, LinSys *sys, Config *param);
 void enforce_head_bc(Data **data, Map *gmap, Config *param);
 void groundwater_flux(Data **data, Map *gmap, Config *param, int irank);
 void check_room(Data **data, Map *gmap, Config *param);
 void update_water_content(Data **data, Map *gmap, Config *param);
 void enforce_moisture_bc(Data **data, Map *gmap, Config *param);
 void reallocate_water_content(Data **data, Map *gmap, Config *param, int irank);
+static int reallocate_cell(Data **data, Map *gmap, Config *param, int ii, double *rsplit);
 int check_adj_sat(Data *data, Map *gmap, Config *param, int ii);
-void check_head_gradient(Data **data, Map *gmap, Config *param, int ii);
-double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV);
-double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV);
+void check_head_gradient(Data **data, Map *gmap, Config *param, int ii, double *rsplit);
+double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV, double *rsplit);
+double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV, double *rsplit);
 void volume_by_flux_subs(Data **data, Map *gmap, Config *param);
 void adaptive_time_step(Data *data, Map *gmap, Config **param, int root, int irank);
 
@@ -52,16 +57,11 @@ void adaptive_time_step(Data *data, Map *gmap, Config **param, int root, int ira
 void solve_groundwater(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank)
 {
     int ii;
-    // allocate linear system
-    QMatrix A;
-    Q_Constr(&A, "A", param->n3ci, False, Rowws, Normal, True);
-    Vector b;
-    V_Constr(&b, "b", param->n3ci, Normal, True);
-    Vector x;
-    V_Constr(&x, "x", param->n3ci, Normal, True);
+    Material *s;
 
     if ((*data)->repeat[0] == 0)
     {
+        #pragma omp parallel for
         for (ii = 0; ii < param->n3ct; ii++)
         {
             (*data)->hn[ii] = (*data)->h[ii];
@@ -74,6 +74,7 @@ void solve_groundwater(Data **data, Map *smap, Map *gmap, Config *param, int ira
     }
     else
     {
+        #pragma omp parallel for
         for (ii = 0; ii < param->n3ct; ii++)
         {
             (*data)->h[ii] = (*data)->hn[ii];
@@ -93,9 +94,10 @@ void solve_groundwater(Data **data, Map *smap, Map *gmap, Config *param, int ira
     // >>> Predictor step
     compute_K_face(data, gmap, param, irank, nrank);
     groundwater_mat_coeff(data, gmap, param);
-    groundwater_rhs(data, gmap, param);
-    build_groundwater_system(*data, gmap, param, A, b);
-    solve_groundwater_system(data, gmap, A, b, x, param);
+    groundwater_rhs(data, gmap, param, irank);
+    if ((*data)->Gpcg != NULL)  {groundwater_halo(*data, gmap, param, (*data)->Gpcg, irank);}
+    build_groundwater_system(*data, gmap, param, (*data)->Gsys);
+    solve_groundwater_system(data, gmap, (*data)->Gsys, param);
     enforce_head_bc(data, gmap, param);
     if (param->use_mpi == 1)
     {mpi_exchange_subsurf((*data)->h, gmap, 2, param, irank, nrank);}
@@ -110,9 +112,11 @@ void solve_groundwater(Data **data, Map *smap, Map *gmap, Config *param, int ira
     }
     else
     {
+        #pragma omp parallel for
         for (ii = 0; ii < param->n3ci; ii++)
         {(*data)->wc[ii] = compute_wch(*data, ii, param);}
     }
+    #pragma omp parallel for
     for (ii = 0; ii < param->n3ci; ii++)
     {
         (*data)->hwc[ii] = compute_hwc(*data, ii, param);
@@ -138,15 +142,16 @@ void solve_groundwater(Data **data, Map *smap, Map *gmap, Config *param, int ira
     {
         if (gmap->actv[ii] == 1)
         {
-            if ((*data)->wc[ii] > (*data)->wcs[ii])
+            s = &(*data)->mat[(*data)->soil[ii]];
+            if ((*data)->wc[ii] > s->wcs)
             {
-                (*data)->vloss[ii] += ((*data)->wc[ii] - (*data)->wcs[ii]) * param->dx * param->dy * gmap->dz3d[ii];
-                (*data)->wc[ii] = (*data)->wcs[ii];
+                (*data)->vloss[ii] += ((*data)->wc[ii] - s->wcs) * param->dx * param->dy * gmap->dz3d[ii];
+                (*data)->wc[ii] = s->wcs;
             }
-            else if ((*data)->wc[ii] < (*data)->wcr[ii])
+            else if ((*data)->wc[ii] < s->wcr)
             {
-                (*data)->vloss[ii] -= ((*data)->wcr[ii] - (*data)->wc[ii]) * param->dx * param->dy * gmap->dz3d[ii];
-                (*data)->wc[ii] = (*data)->wcr[ii];
+                (*data)->vloss[ii] -= (s->wcr - (*data)->wc[ii]) * param->dx * param->dy * gmap->dz3d[ii];
+                (*data)->wc[ii] = s->wcr;
             }
             // update cell volume
             (*data)->Vgn[ii] = (*data)->Vg[ii];
@@ -162,11 +167,6 @@ void solve_groundwater(Data **data, Map *smap, Map *gmap, Config *param, int ira
     // >>> Adaptive time stepping
     if (param->dt_adjust == 1)
     {adaptive_time_step(*data, gmap, &param, 0, irank);}
-    // free memory
-    Q_Destr(&A);
-    V_Destr(&b);
-    V_Destr(&x);
-
 }
 
 // >>>>> Compute hydraulic conductivity on cell faces <<<<<
@@ -178,31 +178,33 @@ void compute_K_face(Data **data, Map *gmap, Config *param, int irank, int nrank)
     if (param->baroclinic == 1)
     {update_rhovisc(data, gmap, param, irank);}
     // conductivities for interior cells
+    #pragma omp parallel for private(Kp, Km)
     for (ii = 0; ii < param->n3ci; ii++)
     {
         // Kx
-        Kp = compute_K(*data, (*data)->Ksx, gmap->iPjckc[ii], param) * (*data)->r_rho[gmap->iPjckc[ii]] * (*data)->r_visc[gmap->iPjckc[ii]];
-        Km = compute_K(*data, (*data)->Ksx, ii, param) * (*data)->r_rho[ii] * (*data)->r_visc[ii];
+        Kp = compute_K(*data, 0, gmap->iPjckc[ii], param) * (*data)->r_rho[gmap->iPjckc[ii]] * (*data)->r_visc[gmap->iPjckc[ii]];
+        Km = compute_K(*data, 0, ii, param) * (*data)->r_rho[ii] * (*data)->r_visc[ii];
         (*data)->Kx[ii] = 0.5 * (Kp + Km);
         if (gmap->actv[ii] == 0 | gmap->actv[gmap->iPjckc[ii]] == 0)    {(*data)->Kx[ii] = 0.0;}
         // Ky
-        Kp = compute_K(*data, (*data)->Ksy, gmap->icjPkc[ii], param) * (*data)->r_rho[gmap->icjPkc[ii]] * (*data)->r_visc[gmap->icjPkc[ii]];
-        Km = compute_K(*data, (*data)->Ksy, ii, param) * (*data)->r_rho[ii] * (*data)->r_visc[ii];
+        Kp = compute_K(*data, 1, gmap->icjPkc[ii], param) * (*data)->r_rho[gmap->icjPkc[ii]] * (*data)->r_visc[gmap->icjPkc[ii]];
+        Km = compute_K(*data, 1, ii, param) * (*data)->r_rho[ii] * (*data)->r_visc[ii];
         (*data)->Ky[ii] = 0.5 * (Kp + Km);
         if (gmap->actv[ii] == 0 | gmap->actv[gmap->icjPkc[ii]] == 0)    {(*data)->Ky[ii] = 0.0;}
         // Kz
-        Kp = compute_K(*data, (*data)->Ksz, gmap->icjckP[ii], param) * (*data)->r_rho[gmap->icjckP[ii]] * (*data)->r_visc[gmap->icjPkc[ii]];
-        Km = compute_K(*data, (*data)->Ksz, ii, param) * (*data)->r_rho[ii] * (*data)->r_visc[ii];
+        Kp = compute_K(*data, 2, gmap->icjckP[ii], param) * (*data)->r_rho[gmap->icjckP[ii]] * (*data)->r_visc[gmap->icjPkc[ii]];
+        Km = compute_K(*data, 2, ii, param) * (*data)->r_rho[ii] * (*data)->r_visc[ii];
         if (gmap->istop[gmap->icjckP[ii]] == 1) {(*data)->Kz[ii] = Kp;}
         else if (gmap->actv[ii] == 0)   {(*data)->Kz[ii] = 0.0;}
         else if (gmap->icjckP[ii] > param->n3ci)    {(*data)->Kz[ii] = Km;}
         else    {(*data)->Kz[ii] = 0.5 * (Kp + Km);}
     }
     // conductivities on iM, jM, kM faces
+    #pragma omp parallel for private(Kp, Km)
     for (ii = 0; ii < param->ny*param->nz; ii++)
     {
-        Kp = compute_K(*data, (*data)->Ksx, gmap->iMin[ii], param) * (*data)->r_rho[gmap->iMin[ii]] * (*data)->r_visc[gmap->iMin[ii]];
-        Km = compute_K(*data, (*data)->Ksx, gmap->iMou[ii], param) * (*data)->r_rho[gmap->iMou[ii]] * (*data)->r_visc[gmap->iMou[ii]];
+        Kp = compute_K(*data, 0, gmap->iMin[ii], param) * (*data)->r_rho[gmap->iMin[ii]] * (*data)->r_visc[gmap->iMin[ii]];
+        Km = compute_K(*data, 0, gmap->iMou[ii], param) * (*data)->r_rho[gmap->iMou[ii]] * (*data)->r_visc[gmap->iMou[ii]];
         (*data)->Kx[gmap->iMou[ii]] = 0.5 * (Kp + Km);
         if (param->bctype_GW[0] == 0 & (irank+1) % param->mpi_nx == 0)
         {(*data)->Kx[gmap->iPin[ii]] = 0;}
@@ -212,10 +214,11 @@ void compute_K_face(Data **data, Map *gmap, Config *param, int irank, int nrank)
         {(*data)->Kx[gmap->iMou[ii]] = 0;}
 
     }
+    #pragma omp parallel for private(Kp, Km)
     for (ii = 0; ii < param->nx*param->nz; ii++)
     {
-        Kp = compute_K(*data, (*data)->Ksy, gmap->jMin[ii], param) * (*data)->r_rho[gmap->jMin[ii]] * (*data)->r_visc[gmap->jMin[ii]];
-        Km = compute_K(*data, (*data)->Ksy, gmap->jMou[ii], param) * (*data)->r_rho[gmap->jMou[ii]] * (*data)->r_visc[gmap->jMou[ii]];
+        Kp = compute_K(*data, 1, gmap->jMin[ii], param) * (*data)->r_rho[gmap->jMin[ii]] * (*data)->r_visc[gmap->jMin[ii]];
+        Km = compute_K(*data, 1, gmap->jMou[ii], param) * (*data)->r_rho[gmap->jMou[ii]] * (*data)->r_visc[gmap->jMou[ii]];
         (*data)->Ky[gmap->jMou[ii]] = 0.5 * (Kp + Km);
         if (param->bctype_GW[2] == 0 & irank >= param->mpi_nx*(param->mpi_ny-1))
         {(*data)->Ky[gmap->jPin[ii]] = 0;}
@@ -229,12 +232,14 @@ void compute_K_face(Data **data, Map *gmap, Config *param, int irank, int nrank)
         (*data)->Kz[gmap->kMou[ii]] = 0.0;
         if (param->bctype_GW[4] == 0)   {(*data)->Kz[gmap->kPin[ii]] = 0;}
     }
+    // one top cell per column
+    #pragma omp parallel for private(Kp, Km)
     for (ii = 0; ii < param->n3ci; ii++)
     {
         if (gmap->istop[ii] == 1)
         {
-            Kp = compute_K(*data, (*data)->Ksz, ii, param) * (*data)->r_rho[ii] * (*data)->r_visc[ii];
-            Km = param->Ksz * (*data)->r_rho[ii] * (*data)->r_visc[ii];
+            Kp = compute_K(*data, 2, ii, param) * (*data)->r_rho[ii] * (*data)->r_visc[ii];
+            Km = (*data)->mat[(*data)->soil[ii]].Ks[2] * (*data)->r_rho[ii] * (*data)->r_visc[ii];
             if (param->sim_shallowwater == 1)
             {
                 if ((*data)->dept[gmap->top2d[ii]] > 0)
@@ -253,15 +258,25 @@ void compute_K_face(Data **data, Map *gmap, Config *param, int irank, int nrank)
         }
     }
     // Set K to zero for unsaturated side faces
+    // the xp/yp faces of a cell first and its xm/ym faces in a second pass,
+    // so that every face is written by one cell per pass
     if (param->use_full3d == 0)
     {
+        #pragma omp parallel for
         for (ii = 0; ii < param->n3ci; ii++)
         {
-            if (gmap->actv[ii] == 1 & (*data)->wc[ii] < param->wcs)
+            if (gmap->actv[ii] == 1 & (*data)->wc[ii] < (*data)->mat[(*data)->soil[ii]].wcs)
             {
                 (*data)->Kx[ii] = 0.0;
-                (*data)->Kx[gmap->iMjckc[ii]] = 0.0;
                 (*data)->Ky[ii] = 0.0;
+            }
+        }
+        #pragma omp parallel for
+        for (ii = 0; ii < param->n3ci; ii++)
+        {
+            if (gmap->actv[ii] == 1 & (*data)->wc[ii] < (*data)->mat[(*data)->soil[ii]].wcs)
+            {
+                (*data)->Kx[gmap->iMjckc[ii]] = 0.0;
                 (*data)->Ky[gmap->icjMkc[ii]] = 0.0;
             }
         }
@@ -274,6 +289,7 @@ void groundwater_mat_coeff(Data **data, Map *gmap, Config *param)
 {
     int ii;
     double dzf;
+    #pragma omp parallel for private(dzf)
     for (ii = 0; ii < param->n3ci; ii++)
     {
         // coeff xp
@@ -292,7 +308,7 @@ void groundwater_mat_coeff(Data **data, Map *gmap, Config *param)
         else    {dzf = 0.5 * (gmap->dz3d[ii] + gmap->dz3d[gmap->icjckM[ii]]);}
         (*data)->Gzm[ii] = - (*data)->Kz[gmap->icjckM[ii]] * param->dt / (gmap->dz3d[ii]*dzf);
         // coeff ct
-        (*data)->Gct[ii] = ((*data)->ch[ii] + param->Ss*(*data)->wcn[ii]/(*data)->wcs[ii]) * (*data)->r_rho[ii];
+        (*data)->Gct[ii] = ((*data)->ch[ii] + param->Ss*(*data)->wcn[ii]/(*data)->mat[(*data)->soil[ii]].wcs) * (*data)->r_rho[ii];
         (*data)->Gct[ii] -= ((*data)->Gxp[ii] + (*data)->Gxm[ii] + (*data)->Gyp[ii] + (*data)->Gym[ii]);
         // ct on zp
         if (gmap->kk[ii] == param->nz-1 & param->bctype_GW[4] != 1)
@@ -313,24 +329,27 @@ void groundwater_mat_coeff(Data **data, Map *gmap, Config *param)
 }
 
 // >>>>> Compute right hand side <<<<<
-void groundwater_rhs(Data **data, Map *gmap, Config *param)
+void groundwater_rhs(Data **data, Map *gmap, Config *param, int irank)
 {
     int ii;
+    Material *s;
+    #pragma omp parallel for private(s)
     for (ii = 0; ii < param->n3ci; ii++)
     {
+        s = &(*data)->mat[(*data)->soil[ii]];
         // base terms
-        (*data)->Grhs[ii] = ((*data)->ch[ii] + param->Ss*(*data)->wcn[ii]/(*data)->wcs[ii]) * (*data)->hn[ii] * (*data)->r_rho[ii];
+        (*data)->Grhs[ii] = ((*data)->ch[ii] + param->Ss*(*data)->wcn[ii]/s->wcs) * (*data)->hn[ii] * (*data)->r_rho[ii];
         (*data)->Grhs[ii] -= param->dt * ((*data)->Kz[ii]*(*data)->r_rho[ii] - (*data)->Kz[gmap->icjckM[ii]]*(*data)->r_rho[gmap->icjckM[ii]]) / gmap->dz3d[ii];
         // density term
         (*data)->Grhs[ii] -= (*data)->wc[ii] * ((*data)->r_rho[ii] - (*data)->r_rhon[ii]);
-        // boundary terms
-        if (gmap->ii[ii] == param->nx-1)
+        // boundary terms, faces to other ranks are coupled by groundwater_halo for global solves
+        if (gmap->ii[ii] == param->nx-1 & ((*data)->Gpcg == NULL | irank % param->mpi_nx == param->mpi_nx - 1))
         {(*data)->Grhs[ii] -= (*data)->Gxp[ii] * (*data)->hn[gmap->iPjckc[ii]];}
-        if (gmap->ii[ii] == 0)
+        if (gmap->ii[ii] == 0 & ((*data)->Gpcg == NULL | irank % param->mpi_nx == 0))
         {(*data)->Grhs[ii] -= (*data)->Gxm[ii] * (*data)->hn[gmap->iMjckc[ii]];}
-        if (gmap->jj[ii] == (param->ny-1))
+        if (gmap->jj[ii] == (param->ny-1) & ((*data)->Gpcg == NULL | irank >= param->mpi_nx*(param->mpi_ny-1)))
         {(*data)->Grhs[ii] -= (*data)->Gyp[ii] * (*data)->hn[gmap->icjPkc[ii]];}
-        if (gmap->jj[ii] == 0)
+        if (gmap->jj[ii] == 0 & ((*data)->Gpcg == NULL | irank < param->mpi_nx))
         {(*data)->Grhs[ii] -= (*data)->Gym[ii] * (*data)->hn[gmap->icjMkc[ii]];}
         if (gmap->kk[ii] == param->nz-1)
         {
@@ -349,9 +368,9 @@ void groundwater_rhs(Data **data, Map *gmap, Config *param)
                 {
                     if (param->bctype_GW[5] == 2)
                     {
-                        if ((*data)->qtop[gmap->top2d[ii]] > 0.0 & (*data)->wc[ii] < (*data)->wcs[ii])
+                        if ((*data)->qtop[gmap->top2d[ii]] > 0.0 & (*data)->wc[ii] < s->wcs)
                         {(*data)->Grhs[ii] += - param->dt * ((*data)->qtop[gmap->top2d[ii]] + (*data)->Kz[gmap->icjckM[ii]]*(*data)->r_rho[gmap->icjckM[ii]]) / gmap->dz3d[ii];}
-                        else if ((*data)->qtop[gmap->top2d[ii]] < 0.0 & (*data)->wc[ii] > (*data)->wcr[ii])
+                        else if ((*data)->qtop[gmap->top2d[ii]] < 0.0 & (*data)->wc[ii] > s->wcr)
                         {(*data)->Grhs[ii] += - param->dt * ((*data)->qtop[gmap->top2d[ii]] + (*data)->Kz[gmap->icjckM[ii]]*(*data)->r_rho[gmap->icjckM[ii]]) / gmap->dz3d[ii];}
                         else
                         {(*data)->Grhs[ii] += - param->dt * (*data)->Kz[gmap->icjckM[ii]]*(*data)->r_rho[gmap->icjckM[ii]] / gmap->dz3d[ii];}
@@ -364,9 +383,9 @@ void groundwater_rhs(Data **data, Map *gmap, Config *param)
             {
                 if (param->bctype_GW[5] == 2)
                 {
-                    // if ((*data)->qtop > 0.0 & (*data)->wc[ii] < (*data)->wcs[ii])
+                    // if ((*data)->qtop > 0.0 & (*data)->wc[ii] < s->wcs)
                     // {(*data)->Grhs[ii] += - param->dt * ((*data)->qtop + (*data)->Kz[gmap->icjckM[ii]]) / gmap->dz3d[ii];}
-                    // else if ((*data)->qtop < 0.0 & (*data)->wc[ii] > (*data)->wcr[ii])
+                    // else if ((*data)->qtop < 0.0 & (*data)->wc[ii] > s->wcr)
                     // {(*data)->Grhs[ii] += - param->dt * ((*data)->qtop + (*data)->Kz[gmap->icjckM[ii]]) / gmap->dz3d[ii];}
                     // else
                     // {(*data)->Grhs[ii] += - param->dt * (*data)->Kz[gmap->icjckM[ii]] / gmap->dz3d[ii];}
@@ -380,82 +399,168 @@ void groundwater_rhs(Data **data, Map *gmap, Config *param)
     }
 }
 
-// >>>>> Build linear system <<<<<
-void build_groundwater_system(Data *data, Map *gmap, Config *param, QMatrix A, Vector b)
+// >>>>> Allocate linear system and set its sparsity pattern <<<<<
+// The unknowns are the active cells only, numbered by gmap->actv_row.
+// Only connections to active cells are stored.
+void init_groundwater_system(Data **data, Map *gmap, Config *param, int irank, int nrank)
 {
-    size_t ii, jj, kk, n, dist, irow;
-    int im;
-    double value, *row;
-    row = malloc(8*sizeof(double));
-
-    irow = 1;
-    for (ii = 1; ii <= param->n3ci; ii++)
+    size_t ii, jj, kk, pos[7], *start;
+    int im, ncol = param->nx*param->ny;
+    LinSys *sys;
+    init_linsys(&(*data)->Gsys, "Ag", gmap->nactv);
+    init_solvelog(&(*data)->Glog);
+    // under MPI the ranks may solve one global system
+    (*data)->Gpcg = NULL;
+    if (param->use_mpi == 1 & param->global_solve == 1)
     {
-
-        for (jj = 0; jj < 8; jj++)  {row[jj] = 0.0;}
-        im = ii - 1;
-        if (gmap->actv[im] == 0)
+        init_parcg(&(*data)->Gpcg, gmap->nactv, param->n3ct, 2*(param->nx+param->ny)*param->nz, \
+            mpi_exchange_subsurf, gmap, param, irank, nrank);
+        parcg_compact((*data)->Gpcg, gmap->actv_cell);
+        if (param->krylov_GW == 4)  {(*data)->Gpcg->pipelined = 1;}
+    }
+    sys = (*data)->Gsys;
+    sys->krylov = param->krylov_GW;
+    sys->maxiter = param->maxiter_GW;
+    sys->omega = param->omega_GW;
+    for (ii = 1; ii <= sys->dim; ii++)
+    {
+        im = gmap->actv_cell[ii-1];
+        kk = 0;
+        // ym, xm and zm entries
+        if (neighbor_row(gmap, param, gmap->icjMkc[im]) >= 0)
+        {pos[kk] = neighbor_row(gmap, param, gmap->icjMkc[im]) + 1;    kk++;}
+        if (neighbor_row(gmap, param, gmap->iMjckc[im]) >= 0)
+        {pos[kk] = neighbor_row(gmap, param, gmap->iMjckc[im]) + 1;    kk++;}
+        if (neighbor_row(gmap, param, gmap->icjckM[im]) >= 0)
+        {pos[kk] = neighbor_row(gmap, param, gmap->icjckM[im]) + 1;    kk++;}
+        // ct entry
+        pos[kk] = ii;
+        kk++;
+        // zp, xp and yp entries
+        if (neighbor_row(gmap, param, gmap->icjckP[im]) >= 0)
+        {pos[kk] = neighbor_row(gmap, param, gmap->icjckP[im]) + 1;    kk++;}
+        if (neighbor_row(gmap, param, gmap->iPjckc[im]) >= 0)
+        {pos[kk] = neighbor_row(gmap, param, gmap->iPjckc[im]) + 1;    kk++;}
+        if (neighbor_row(gmap, param, gmap->icjPkc[im]) >= 0)
+        {pos[kk] = neighbor_row(gmap, param, gmap->icjPkc[im]) + 1;    kk++;}
+        Q_SetLen(&sys->A, ii, kk);
+        for (jj = 0; jj < kk; jj++)
         {
-            Q_SetLen(&A, ii, 1);
-            Q_SetEntry(&A, ii, 0, ii, 1.0);
-            V_SetCmp(&b, ii, data->hn[im]);
-            row[3] = 1.0;   row[7] = data->hn[im];
+            if (pos[jj] == ii)  {Q_SetEntry(&sys->A, ii, jj, pos[jj], 1.0);}
+            else    {Q_SetEntry(&sys->A, ii, jj, pos[jj], 0.0);}
         }
-        else
-        {
-            kk = 0;
-            n = 7;
-            if (gmap->ii[im] == 0)  {n -= 1;}
-            if (gmap->ii[im] == param->nx-1)    {n -= 1;}
-            if (gmap->jj[im] == 0)  {n -= 1;}
-            if (gmap->jj[im] == param->ny-1)    {n -= 1;}
-            if (gmap->istop[im] == 1)   {n -= 1;}
-            if (gmap->kk[im] == param->nz-1)    {n -= 1;}
-            Q_SetLen(&A, ii, n);
-            // set ym entry
-            dist = im - gmap->icjMkc[im];
-            if (ii-dist > 0 & ii-dist <= param->n3ci & gmap->actv[gmap->icjMkc[im]] == 1)
-            {Q_SetEntry(&A, ii, kk, ii-dist, data->Gym[im]);    kk++;   row[0]=data->Gym[im];}
-            // set xm entry
-            dist = im - gmap->iMjckc[im];
-            if (ii-dist > 0 & ii-dist <= param->n3ci & gmap->actv[gmap->iMjckc[im]] == 1)
-            {Q_SetEntry(&A, ii, kk, ii-dist, data->Gxm[im]);    kk++;   row[1]=data->Gxm[im];}
-            // set zm entry
-            dist = im - gmap->icjckM[im];
-            if (ii-dist > 0 & ii-dist <= param->n3ci & gmap->actv[gmap->icjckM[im]] == 1)
-            {Q_SetEntry(&A, ii, kk, ii-dist, data->Gzm[im]);    kk++;   row[2]=data->Gzm[im];}
-            // set ct entry
-            Q_SetEntry(&A, ii, kk, ii, data->Gct[im]);
-            row[3]=data->Gct[im];
-            kk++;
-            // set zp entry
-            dist = gmap->icjckP[im] - im;
-            if (ii+dist > 0 & ii+dist <= param->n3ci & gmap->actv[gmap->icjckP[im]] == 1)
-            {Q_SetEntry(&A, ii, kk, ii+dist, data->Gzp[im]);    kk++;   row[4]=data->Gzp[im];}
-            // set xp entry
-            dist = gmap->iPjckc[im] - im;
-            if (ii+dist > 0 & ii+dist <= param->n3ci & gmap->actv[gmap->iPjckc[im]] == 1)
-            {Q_SetEntry(&A, ii, kk, ii+dist, data->Gxp[im]);    kk++;   row[5]=data->Gxp[im];}
-            // set yp entry
-            dist = gmap->icjPkc[im] - im;
-            if (ii+dist > 0 & ii+dist <= param->n3ci & gmap->actv[gmap->icjPkc[im]] == 1)
-            {Q_SetEntry(&A, ii, kk, ii+dist, data->Gyp[im]);    kk++;   row[6]=data->Gyp[im];}
-            // set right hand side
-            V_SetCmp(&b, ii, data->Grhs[im]);
-            row[7]=data->Grhs[im];
+    }
+    linsys_pattern_done(sys);
+    linsys_mixed(sys, param->mixed_GW);
+    if (param->krylov_GW == 5)  {init_deflate(&sys->defl, sys->dim, param->deflate_GW);}
+    if (param->precond_GW == 2 | param->precond_GW == 3)
+    {
+        // first row of every column in the compacted numbering
+        start = calloc(ncol+1, sizeof(size_t));
+        for (ii = 0; ii < sys->dim; ii++)   {start[gmap->top2d[gmap->actv_cell[ii]]+1] += 1;}
+        for (jj = 0; jj < ncol; jj++)   {start[jj+1] += start[jj];}
+        init_zline(&sys->line, ncol, start);
+        free(start);
+    }
+    if (param->precond_GW == 4) {init_ilu(&sys->ilu, &sys->A, param->ilu_drift);}
+    else if (param->precond_GW == 5)    {init_mcssor(&sys->color, &sys->A);}
+    if (param->precond_GW == 1 | param->precond_GW == 3)
+    {
+        init_amg(&sys->amg, &sys->A, param->amg_drift);
+        sys->amg->line = sys->line;
+    }
+}
 
-        }
+// >>>>> Row of a neighbor cell in the compacted system, -1 if it is not an unknown <<<<<
+static int neighbor_row(Map *gmap, Config *param, int nb)
+{
+    if (nb < param->n3ci)   {return gmap->actv_row[nb];}
+    else    {return -1;}
+}
+
+// >>>>> Couplings to the ghost cells of the neighbor ranks <<<<<
+// Faces on the outer boundary are handled by groundwater_rhs
+void groundwater_halo(Data *data, Map *gmap, Config *param, ParCG *cg, int irank)
+{
+    int ii, row;
+    parcg_reset(cg);
+    for (row = 0; row < gmap->nactv; row++)
+    {
+        ii = gmap->actv_cell[row];
+        if (gmap->ii[ii] == 0 & irank % param->mpi_nx != 0)
+        {parcg_couple(cg, row, gmap->iMjckc[ii], data->Gxm[ii]);}
+        if (gmap->ii[ii] == param->nx-1 & irank % param->mpi_nx != param->mpi_nx - 1)
+        {parcg_couple(cg, row, gmap->iPjckc[ii], data->Gxp[ii]);}
+        if (gmap->jj[ii] == 0 & irank >= param->mpi_nx)
+        {parcg_couple(cg, row, gmap->icjMkc[ii], data->Gym[ii]);}
+        if (gmap->jj[ii] == param->ny-1 & irank < param->mpi_nx*(param->mpi_ny-1))
+        {parcg_couple(cg, row, gmap->icjPkc[ii], data->Gyp[ii]);}
+    }
+}
+
+// >>>>> Build linear system <<<<<
+// The pattern is fixed by init_groundwater_system, only values are updated here
+void build_groundwater_system(Data *data, Map *gmap, Config *param, LinSys *sys)
+{
+    size_t ii, kk;
+    int im;
+    ElType *row;
+
+    for (ii = 1; ii <= sys->dim; ii++)
+    {
+        im = gmap->actv_cell[ii-1];
+        row = sys->A.El[ii];
+        kk = 0;
+        // set ym, xm and zm entries
+        if (neighbor_row(gmap, param, gmap->icjMkc[im]) >= 0)   {row[kk].Val = data->Gym[im];    kk++;}
+        if (neighbor_row(gmap, param, gmap->iMjckc[im]) >= 0)   {row[kk].Val = data->Gxm[im];    kk++;}
+        if (neighbor_row(gmap, param, gmap->icjckM[im]) >= 0)   {row[kk].Val = data->Gzm[im];    kk++;}
+        // set ct entry
+        row[kk].Val = data->Gct[im];
+        kk++;
+        // set zp, xp and yp entries
+        if (neighbor_row(gmap, param, gmap->icjckP[im]) >= 0)   {row[kk].Val = data->Gzp[im];    kk++;}
+        if (neighbor_row(gmap, param, gmap->iPjckc[im]) >= 0)   {row[kk].Val = data->Gxp[im];    kk++;}
+        if (neighbor_row(gmap, param, gmap->icjPkc[im]) >= 0)   {row[kk].Val = data->Gyp[im];    kk++;}
+        // set right hand side
+        V__SetCmp(&sys->b, ii, data->Grhs[im]);
     }
+    linsys_update_diag(sys);
 }
 
 // >>>>> solve linear system <<<<<
-void solve_groundwater_system(Data **data, Map *gmap, QMatrix A, Vector b, Vector x, Config *param)
+// Inactive cells are not unknowns and keep the head of the last step. They
+// used to be identity rows with b = hn, which counted towards |b| in the
+// relative stopping criterion, so the tolerance is scaled to stop at the
+// same absolute residual as before.
+void solve_groundwater_system(Data **data, Map *gmap, LinSys *sys, Config *param)
 {
     size_t ii;
-    V_SetAllCmp(&x, 0.0);
-    SetRTCAccuracy(0.00000001);
-    CGIter(&A, &x, &b, 10000000, SSORPrecond, 1);
-    for (ii = 0; ii < param->n3ci; ii++)    {(*data)->h[ii] = V_GetCmp(&x, ii+1);}
+    double eps = param->tol_GW * param->tol_fac, bsum[2] = {0.0, 0.0};
+    ParCG *cg = (*data)->Gpcg;
+    double t0 = omp_get_wtime(), t1;
+    for (ii = 1; ii <= sys->dim; ii++)  {bsum[0] += sys->b.Cmp[ii] * sys->b.Cmp[ii];}
+    for (ii = 0; ii < param->n3ci; ii++)
+    {if (gmap->actv[ii] == 0)  {bsum[1] += (*data)->hn[ii] * (*data)->hn[ii];}}
+    if (cg != NULL) {parcg_allreduce(cg, bsum, 2);}
+    if (bsum[0] > 0.0)  {eps = eps * sqrt((bsum[0] + bsum[1]) / bsum[0]);}
+    // a repeated step starts again from hn, the rejected solution is no history
+    if ((*data)->repeat[0] == 1)    {(*data)->Glog->nwarm = 0;}
+    if (cg == NULL)  {linsys_solve(sys, (*data)->Glog, param->warm_start, param->dt, eps);}
+    else
+    {
+        // global solve over all ranks
+        warm_start(sys->x.Cmp+1, sys->xprev, sys->dim, param->warm_start, (*data)->Glog, param->dt);
+        t1 = omp_get_wtime();
+        linsys_setup_precond(sys);
+        (*data)->Glog->setup = omp_get_wtime() - t1;
+        parcg_solve(cg, linsys_apply, sys, linsys_precond, sys, sys->x.Cmp+1, sys->b.Cmp+1, eps, param->maxiter_GW);
+        (*data)->Glog->res0 = cg->res0;
+        log_solve((*data)->Glog, cg->iter, cg->acc, eps);
+    }
+    log_time((*data)->Glog, t0);
+    for (ii = 0; ii < param->n3ci; ii++)    {(*data)->h[ii] = (*data)->hn[ii];}
+    for (ii = 0; ii < sys->dim; ii++)   {(*data)->h[gmap->actv_cell[ii]] = V__GetCmp(&sys->x, ii+1);}
 }
 
 // >>>>> enforce head boundary conditions
@@ -505,6 +610,8 @@ void groundwater_flux(Data **data, Map *gmap, Config *param, int irank)
 {
     int ii, jj;
     double dzf, vseep;
+    Material *s, *sa;
+    #pragma omp parallel for private(dzf)
     for (ii = 0; ii < param->n3ci; ii++)
     {
         dzf = 0.5 * (gmap->dz3d[ii] + gmap->dz3d[gmap->icjckP[ii]]);
@@ -519,22 +626,29 @@ void groundwater_flux(Data **data, Map *gmap, Config *param, int irank)
         else
         {(*data)->qz[ii] = (*data)->Kz[ii] * ((*data)->h[gmap->icjckP[ii]]-(*data)->h[ii]) / dzf - (*data)->Kz[ii]*(*data)->r_rho[ii];}
     }
+    #pragma omp parallel for
     for (ii = 0; ii < param->ny*param->nz; ii++)
     {
         (*data)->qx[gmap->iMou[ii]] = (*data)->Kx[gmap->iMou[ii]]
                     * ((*data)->h[gmap->iMin[ii]]-(*data)->h[gmap->iMou[ii]]) / param->dx;
     }
+    #pragma omp parallel for
     for (ii = 0; ii < param->nx*param->nz; ii++)
     {
         (*data)->qy[gmap->jMou[ii]] = (*data)->Ky[gmap->jMou[ii]]
                     * ((*data)->h[gmap->jMin[ii]]-(*data)->h[gmap->jMou[ii]]) / param->dy;
     }
+    // top faces and seepage, one top cell per column
+    #pragma omp parallel for private(ii, dzf, vseep, s, sa)
     for (jj = 0; jj < param->n3ci; jj++)
     {
         if (gmap->istop[jj] == 1)
         {
             ii = gmap->icjckM[jj];
             dzf = 0.5 * gmap->dz3d[jj];
+            // soil of the top cell and of the cell above it
+            s = &(*data)->mat[(*data)->soil[jj]];
+            sa = &(*data)->mat[(*data)->soil[ii]];
 
             if (param->sim_shallowwater == 1)
             {
@@ -544,9 +658,9 @@ void groundwater_flux(Data **data, Map *gmap, Config *param, int irank)
                     if ((*data)->qz[ii] < 0)
                     {
                         // check if infiltration > depth available
-                        vseep = fabs((*data)->qz[ii])*param->dt*(*data)->wcs[jj];
+                        vseep = fabs((*data)->qz[ii])*param->dt*s->wcs;
                         if (vseep > (*data)->dept[gmap->top2d[jj]])
-                        {(*data)->qz[ii] = -(*data)->dept[gmap->top2d[jj]]/(param->dt*(*data)->wcs[jj]);}
+                        {(*data)->qz[ii] = -(*data)->dept[gmap->top2d[jj]]/(param->dt*s->wcs);}
                     }
                 }
                 else if (param->bctype_GW[5] == 2)
@@ -557,9 +671,9 @@ void groundwater_flux(Data **data, Map *gmap, Config *param, int irank)
                     //      applied to the subsurface domain, ZhiLi20201116
                     if ((*data)->qz[ii] < 0.0)  {(*data)->qz[ii] = 0.0;}
                     // add evaporation
-                    if ((*data)->qtop[gmap->top2d[jj]] > 0.0 & (*data)->wc[jj] > (*data)->wcr[jj])
+                    if ((*data)->qtop[gmap->top2d[jj]] > 0.0 & (*data)->wc[jj] > s->wcr)
                     {
-                        if ((*data)->wc[jj] > (*data)->wcr[jj] + (*data)->qtop[gmap->top2d[jj]] * param->dt / gmap->dz3d[jj])
+                        if ((*data)->wc[jj] > s->wcr + (*data)->qtop[gmap->top2d[jj]] * param->dt / gmap->dz3d[jj])
                         {(*data)->qz[ii] += (*data)->qtop[gmap->top2d[jj]];}
                     }
 
@@ -578,7 +692,7 @@ void groundwater_flux(Data **data, Map *gmap, Config *param, int irank)
                 }
                 (*data)->qseepage[gmap->top2d[jj]] += (*data)->qz[ii];
                 // if evaporation exists, evaporation does not contribute to seepage
-                if (param->bctype_GW[5] == 2 & (*data)->qtop[gmap->top2d[jj]] > 0.0 & (*data)->wc[jj] > (*data)->wcr[jj])
+                if (param->bctype_GW[5] == 2 & (*data)->qtop[gmap->top2d[jj]] > 0.0 & (*data)->wc[jj] > s->wcr)
                 {(*data)->qseepage[gmap->top2d[jj]] -= (*data)->qtop[gmap->top2d[jj]];}
             }
             else
@@ -587,9 +701,9 @@ void groundwater_flux(Data **data, Map *gmap, Config *param, int irank)
                 {(*data)->qz[ii] = (*data)->Kz[ii] * ((*data)->h[jj]-(*data)->h[ii]) / dzf - (*data)->Kz[ii]*(*data)->r_rho[ii];}
                 else if (param->bctype_GW[5] == 2)
                 {
-                    if ((*data)->qtop[gmap->top2d[jj]] < 0.0 & (*data)->wc[ii] < (*data)->wcs[ii])
+                    if ((*data)->qtop[gmap->top2d[jj]] < 0.0 & (*data)->wc[ii] < sa->wcs)
                     {(*data)->qz[ii] = (*data)->qtop[gmap->top2d[jj]];}
-                    else if ((*data)->qtop[gmap->top2d[jj]] > 0.0 & (*data)->wc[ii] > (*data)->wcr[ii])
+                    else if ((*data)->qtop[gmap->top2d[jj]] > 0.0 & (*data)->wc[ii] > sa->wcr)
                     {(*data)->qz[ii] = (*data)->qtop[gmap->top2d[jj]];}
                     else
                     {(*data)->qz[ii] = 0.0;}
@@ -609,12 +723,13 @@ void groundwater_flux(Data **data, Map *gmap, Config *param, int irank)
 void check_room(Data **data, Map *gmap, Config *param)
 {
     int ii;
+    #pragma omp parallel for
     for (ii = 0; ii < param->n3ci; ii++)
     {
         if (gmap->actv[ii] == 0)
         {(*data)->room[ii] = 0.0;}
         else
-        {(*data)->room[ii] = ((*data)->wcs[ii]-(*data)->wc[ii]) * gmap->dz3d[ii]*param->dx*param->dy;}
+        {(*data)->room[ii] = ((*data)->mat[(*data)->soil[ii]].wcs-(*data)->wc[ii]) * gmap->dz3d[ii]*param->dx*param->dy;}
     }
 }
 
@@ -623,10 +738,11 @@ void update_water_content(Data **data, Map *gmap, Config *param)
 {
     int ii, jj, i_sat;
     double coeff, dqx, dqy, dqz, room_col;
+    #pragma omp parallel for private(coeff, dqx, dqy, dqz)
     for (ii = 0; ii < param->n3ci; ii++)
     {
         // update water content
-        coeff = 1.0 + param->Ss * ((*data)->h[ii]-(*data)->hn[ii]) / (*data)->wcs[ii];
+        coeff = 1.0 + param->Ss * ((*data)->h[ii]-(*data)->hn[ii]) / (*data)->mat[(*data)->soil[ii]].wcs;
         dqx = param->dt * ((*data)->qx[ii] - (*data)->qx[gmap->iMjckc[ii]]) / param->dx;
         dqy = param->dt * ((*data)->qy[ii] - (*data)->qy[gmap->icjMkc[ii]]) / param->dy;
         dqz = param->dt * ((*data)->qz[ii] - (*data)->qz[gmap->icjckM[ii]]) / gmap->dz3d[ii];
@@ -659,106 +775,130 @@ void enforce_moisture_bc(Data **data, Map *gmap, Config *param)
 }
 
 // >>>>> post-allocation of moisture <<<<<
+// A cell sends moisture within its own column only unless use_full3d = 1,
+// but reads the water content of its lateral neighbors. Serially the columns
+// are processed in index order, so the neighbors at xm/ym are already done
+// and those at xp/yp are not. The anti-diagonals i+j = const of the columns
+// keep exactly this order and have no lateral neighbors among themselves,
+// so the columns of one anti-diagonal are processed in parallel.
 void reallocate_water_content(Data **data, Map *gmap, Config *param, int irank)
 {
-    int ii, adj_sat, dir, alloc_type1=0, alloc_type2=0, alloc_type3=0, alloc_type4=0;
-    double dV, wcp;
+    int ii, kk, col, diag, repeat = 0;
+    double rsplit[6];
+    if (param->use_full3d == 1)
+    {
+        for (ii = 0; ii < param->n3ci; ii++)
+        {repeat |= reallocate_cell(data, gmap, param, ii, rsplit);}
+    }
+    else
+    {
+        for (diag = 0; diag < param->nx+param->ny-1; diag++)
+        {
+            #pragma omp parallel for private(col, kk, rsplit) reduction(|:repeat)
+            for (ii = 0; ii < param->nx; ii++)
+            {
+                if (diag-ii < 0 | diag-ii >= param->ny)    {continue;}
+                col = (diag-ii)*param->nx + ii;
+                for (kk = col*param->nz; kk < (col+1)*param->nz; kk++)
+                {repeat |= reallocate_cell(data, gmap, param, kk, rsplit);}
+            }
+        }
+    }
+    if (repeat == 1)    {(*data)->repeat[0] = 1;}
+}
 
-    int flag = 0;
-    for (ii = 0; ii < param->n3ci; ii++)
+// >>>>> post-allocation of one cell, returns 1 if the step must be repeated <<<<<
+// rsplit is the workspace of the allocation directions.
+static int reallocate_cell(Data **data, Map *gmap, Config *param, int ii, double *rsplit)
+{
+    int adj_sat, repeat = 0;
+    double dV;
+    Material *s = &(*data)->mat[(*data)->soil[ii]];
+    if (gmap->actv[ii] == 1)
     {
-        wcp = (*data)->wc[ii];
-        if (gmap->actv[ii] == 1)
+        (*data)->wch[ii] = compute_wch(*data, ii, param);
+        (*data)->hwc[ii] = compute_hwc(*data, ii, param);
+        // over-saturated cell
+        if ((*data)->wc[ii] >= s->wcs)
         {
-            (*data)->wch[ii] = compute_wch(*data, ii, param);
-            (*data)->hwc[ii] = compute_hwc(*data, ii, param);
-            // over-saturated cell
-            if ((*data)->wc[ii] >= (*data)->wcs[ii])
+            // send moisture
+            if (param->post_allocate == 1)
             {
-                // send moisture
-                if (param->post_allocate == 1)
+                dV = ((*data)->wc[ii] - s->wcs) * gmap->dz3d[ii] * param->dx * param->dy;
+                if (dV > 0.1 * s->wcs*gmap->dz3d[ii]*param->dx*param->dy)
                 {
-                    dV = ((*data)->wc[ii] - (*data)->wcs[ii]) * gmap->dz3d[ii] * param->dx * param->dy;
-                    if (dV > 0.1 * (*data)->wcs[ii]*gmap->dz3d[ii]*param->dx*param->dy)
-                    {
-                        // printf("1 : ii = %d, wc = %f, dwc = %f\n",ii,(*data)->wc[ii],(*data)->wc[ii] - (*data)->wcs[ii]);
-                        (*data)->repeat[0] = 1;
-                    }
-                    check_head_gradient(data, gmap, param, ii);
-                    dV = allocate_send(data, gmap, param, ii, dV);
-                    if (dV > 0)    {dV = allocate_send(data, gmap, param, ii, dV);}
+                    // printf("1 : ii = %d, wc = %f, dwc = %f\n",ii,(*data)->wc[ii],(*data)->wc[ii] - s->wcs);
+                    repeat = 1;
                 }
-                (*data)->wc[ii] = (*data)->wcs[ii];
-                alloc_type1 += 1;
+                check_head_gradient(data, gmap, param, ii, rsplit);
+                dV = allocate_send(data, gmap, param, ii, dV, rsplit);
+                if (dV > 0)    {dV = allocate_send(data, gmap, param, ii, dV, rsplit);}
             }
-            // unsaturated cell
+            (*data)->wc[ii] = s->wcs;
+        }
+        // unsaturated cell
+        else
+        {
+            // check if a cell is adjacent to a saturated cell
+            adj_sat = check_adj_sat(*data, gmap, param, ii);
+            // isolated unsaturated cell
+            if (adj_sat == 0)
+            {
+                // if ((*data)->h[ii] < 0)
+                if ((*data)->wc[ii] < 0.9999*s->wcs)
+                {(*data)->h[ii] = (*data)->hwc[ii];}
+            }
+            // unsaturated cell adjacent to saturated cell
             else
             {
-                // check if a cell is adjacent to a saturated cell
-                adj_sat = check_adj_sat(*data, gmap, param, ii);
-                // isolated unsaturated cell
-                if (adj_sat == 0)
-                {
-                    // if ((*data)->h[ii] < 0)
-                    if ((*data)->wc[ii] < 0.9999*(*data)->wcs[ii])
-                    {(*data)->h[ii] = (*data)->hwc[ii]; alloc_type2 += 1;}
-                }
-                // unsaturated cell adjacent to saturated cell
-                else
+                // receive moisture
+                if (param->post_allocate == 1)
                 {
-                    // receive moisture
-                    if (param->post_allocate == 1)
+                    if ((*data)->wch[ii] > (*data)->wc[ii])
                     {
-                        if ((*data)->wch[ii] > (*data)->wc[ii])
-                        {
-                            dV = ((*data)->wch[ii] - (*data)->wc[ii]) * gmap->dz3d[ii] * param->dx * param->dy;
-                            if (dV > 0.1 * (*data)->wcs[ii]*gmap->dz3d[ii]*param->dx*param->dy)
-                            {(*data)->repeat[0] = 1;}
-                            check_head_gradient(data, gmap, param, ii);
-                            // dV = allocate_recv(data, gmap, param, ii, dV);
-                            // if (dV > 0)    {dV = allocate_recv(data, gmap, param, ii, dV);}
-                            alloc_type3 += 1;
-
-                        }
-                        // send moisture
-                        else
+                        dV = ((*data)->wch[ii] - (*data)->wc[ii]) * gmap->dz3d[ii] * param->dx * param->dy;
+                        if (dV > 0.1 * s->wcs*gmap->dz3d[ii]*param->dx*param->dy)
+                        {repeat = 1;}
+                        check_head_gradient(data, gmap, param, ii, rsplit);
+                        // dV = allocate_recv(data, gmap, param, ii, dV, rsplit);
+                        // if (dV > 0)    {dV = allocate_recv(data, gmap, param, ii, dV, rsplit);}
+                    }
+                    // send moisture
+                    else
+                    {
+                        dV = ((*data)->wc[ii] - (*data)->wch[ii]) * gmap->dz3d[ii] * param->dx * param->dy;
+                        if (dV > 0.1 * s->wcs*gmap->dz3d[ii]*param->dx*param->dy)
                         {
-                            dV = ((*data)->wc[ii] - (*data)->wch[ii]) * gmap->dz3d[ii] * param->dx * param->dy;
-                            if (dV > 0.1 * (*data)->wcs[ii]*gmap->dz3d[ii]*param->dx*param->dy)
-                            {
-                                // printf("3 : ii = %d, wc = %f, dwc = %f\n",ii,(*data)->wc[ii],(*data)->wc[ii] - (*data)->wch[ii]);
-                                (*data)->repeat[0] = 1;
-                            }
-                            check_head_gradient(data, gmap, param, ii);
-                            dV = allocate_send(data, gmap, param, ii, dV);
-                            if (dV > 0)    {dV = allocate_send(data, gmap, param, ii, dV);}
-                            alloc_type4 += 1;
-
+                            // printf("3 : ii = %d, wc = %f, dwc = %f\n",ii,(*data)->wc[ii],(*data)->wc[ii] - (*data)->wch[ii]);
+                            repeat = 1;
                         }
+                        check_head_gradient(data, gmap, param, ii, rsplit);
+                        dV = allocate_send(data, gmap, param, ii, dV, rsplit);
+                        if (dV > 0)    {dV = allocate_send(data, gmap, param, ii, dV, rsplit);}
                     }
-                    (*data)->wc[ii] = (*data)->wch[ii];
-                    (*data)->room[ii] = ((*data)->wcs[ii] - (*data)->wc[ii]) * param->dx*param->dy*gmap->dz3d[ii];
                 }
+                (*data)->wc[ii] = (*data)->wch[ii];
+                (*data)->room[ii] = (s->wcs - (*data)->wc[ii]) * param->dx*param->dy*gmap->dz3d[ii];
             }
-
         }
-
     }
+    return repeat;
 }
-
 // >>>>> Check if a grid cell is adjacent to a saturated cell <<<<<
 int check_adj_sat(Data *data, Map *gmap, Config *param, int ii)
 {
     int adj_sat = 0;
-    if (gmap->actv[gmap->icjckP[ii]] == 1 & data->wc[gmap->icjckP[ii]] >= data->wcs[gmap->icjckP[ii]])
+    Material *mat = data->mat;
+    unsigned char *soil = data->soil;
+    if (gmap->actv[gmap->icjckP[ii]] == 1 & data->wc[gmap->icjckP[ii]] >= mat[soil[gmap->icjckP[ii]]].wcs)
     {adj_sat = 1;}
-    else if (data->Kx[ii] != 0 & data->wc[gmap->iPjckc[ii]] >= data->wcs[gmap->iPjckc[ii]])
+    else if (data->Kx[ii] != 0 & data->wc[gmap->iPjckc[ii]] >= mat[soil[gmap->iPjckc[ii]]].wcs)
     {adj_sat = 1;}
-    else if (data->Kx[gmap->iMjckc[ii]] != 0 & data->wc[gmap->iMjckc[ii]] >= data->wcs[gmap->iMjckc[ii]])
+    else if (data->Kx[gmap->iMjckc[ii]] != 0 & data->wc[gmap->iMjckc[ii]] >= mat[soil[gmap->iMjckc[ii]]].wcs)
     {adj_sat = 1;}
-    else if (data->Ky[ii] != 0 & data->wc[gmap->icjPkc[ii]] >= data->wcs[gmap->icjPkc[ii]])
+    else if (data->Ky[ii] != 0 & data->wc[gmap->icjPkc[ii]] >= mat[soil[gmap->icjPkc[ii]]].wcs)
     {adj_sat = 1;}
-    else if (data->Ky[gmap->icjMkc[ii]] != 0 & data->wc[gmap->icjMkc[ii]] >= data->wcs[gmap->icjMkc[ii]])
+    else if (data->Ky[gmap->icjMkc[ii]] != 0 & data->wc[gmap->icjMkc[ii]] >= mat[soil[gmap->icjMkc[ii]]].wcs)
     {adj_sat = 1;}
     else
     {
@@ -769,7 +909,7 @@ int check_adj_sat(Data *data, Map *gmap, Config *param, int ii)
         }
         else
         {
-            if (gmap->actv[gmap->icjckM[ii]] == 1 & data->wc[gmap->icjckM[ii]] >= data->wcs[gmap->icjckM[ii]])
+            if (gmap->actv[gmap->icjckM[ii]] == 1 & data->wc[gmap->icjckM[ii]] >= mat[soil[gmap->icjckM[ii]]].wcs)
             {adj_sat = 1;}
         }
     }
@@ -777,34 +917,34 @@ int check_adj_sat(Data *data, Map *gmap, Config *param, int ii)
 }
 
 // >>>>> check the direction of allocation
-void check_head_gradient(Data **data, Map *gmap, Config *param, int ii)
+void check_head_gradient(Data **data, Map *gmap, Config *param, int ii, double *rsplit)
 {
     int jj;
-    double dh, dzp, dzm, gradx, grady, gradz, grad_tot;
+    double dh6[6], dh, dzp, dzm, gradx, grady, gradz, grad_tot;
     // get dh at the iP face
     dh = ((*data)->h[gmap->iPjckc[ii]]-(*data)->h[ii]) / param->dx;
-    if (gmap->actv[gmap->iPjckc[ii]] == 1 & (*data)->Kx[ii] > 0)   {(*data)->dh6[0] = dh;}
-    else    {(*data)->dh6[0] = 0.0;}
+    if (gmap->actv[gmap->iPjckc[ii]] == 1 & (*data)->Kx[ii] > 0)   {dh6[0] = dh;}
+    else    {dh6[0] = 0.0;}
     // get dh at the iM face
     dh = ((*data)->h[ii]-(*data)->h[gmap->iMjckc[ii]]) / param->dx;
-    if (gmap->actv[gmap->iMjckc[ii]] == 1 & (*data)->Kx[gmap->iMjckc[ii]] > 0) {(*data)->dh6[1] = dh;}
-    else    {(*data)->dh6[1] = 0.0;}
+    if (gmap->actv[gmap->iMjckc[ii]] == 1 & (*data)->Kx[gmap->iMjckc[ii]] > 0) {dh6[1] = dh;}
+    else    {dh6[1] = 0.0;}
     // get dh at the jP face
     dh = ((*data)->h[gmap->icjPkc[ii]]-(*data)->h[ii]) / param->dy;
-    if (gmap->actv[gmap->icjPkc[ii]] == 1 & (*data)->Ky[ii] > 0)   {(*data)->dh6[2] = dh;}
-    else    {(*data)->dh6[2] = 0.0;}
+    if (gmap->actv[gmap->icjPkc[ii]] == 1 & (*data)->Ky[ii] > 0)   {dh6[2] = dh;}
+    else    {dh6[2] = 0.0;}
     // get dh at the jM face
     dh = ((*data)->h[ii]-(*data)->h[gmap->icjMkc[ii]]) / param->dy;
-    if (gmap->actv[gmap->icjMkc[ii]] == 1 & (*data)->Ky[gmap->icjMkc[ii]] > 0) {(*data)->dh6[3] = dh;}
-    else    {(*data)->dh6[3] = 0.0;}
+    if (gmap->actv[gmap->icjMkc[ii]] == 1 & (*data)->Ky[gmap->icjMkc[ii]] > 0) {dh6[3] = dh;}
+    else    {dh6[3] = 0.0;}
     // get dh at the kP face
     if (gmap->kk[ii] == param->nz-1)
     {if (param->bctype_GW[4] == 1)   {dzp = 0.5 * gmap->dz3d[ii];}}
     else    {dzp = 0.5 * (gmap->dz3d[ii] + gmap->dz3d[gmap->icjckP[ii]]);}
     if (dzp == 0.0) {dh = 0.0;}
     else    {dh = ((*data)->h[gmap->icjckP[ii]]-(*data)->h[ii]) / dzp - 1.0;}
-    if (gmap->actv[gmap->icjckP[ii]] == 1 & (*data)->Kz[ii] > 0)    {(*data)->dh6[4] = dh;}
-    else    {(*data)->dh6[4] = 0.0;}
+    if (gmap->actv[gmap->icjckP[ii]] == 1 & (*data)->Kz[ii] > 0)    {dh6[4] = dh;}
+    else    {dh6[4] = 0.0;}
     // get dh at the kM face
     if (gmap->istop[ii] == 1)
     {
@@ -816,54 +956,54 @@ void check_head_gradient(Data **data, Map *gmap, Config *param, int ii)
     else    {dzm = 0.5 * (gmap->dz3d[ii] + gmap->icjckM[ii]);}
     if (dzm == 0.0) {dh = 0.0;}
     else    {dh = ((*data)->h[ii]-(*data)->h[gmap->icjckM[ii]]) / dzm - 1.0;}
-    if (gmap->actv[gmap->icjckM[ii]] == 1 & (*data)->Kz[gmap->icjckM[ii]] > 0)    {(*data)->dh6[5] = dh;}
-    else    {(*data)->dh6[5] = 0.0;}
+    if (gmap->actv[gmap->icjckM[ii]] == 1 & (*data)->Kz[gmap->icjckM[ii]] > 0)    {dh6[5] = dh;}
+    else    {dh6[5] = 0.0;}
 
     if (param->use_full3d == 0)
     {
-        (*data)->dh6[0] = 0.0;
-        (*data)->dh6[1] = 0.0;
-        (*data)->dh6[2] = 0.0;
-        (*data)->dh6[3] = 0.0;
+        dh6[0] = 0.0;
+        dh6[1] = 0.0;
+        dh6[2] = 0.0;
+        dh6[3] = 0.0;
     }
 
     // combine gradients in each direction
     grad_tot = 0.0;
-    if ((*data)->dh6[0]*(*data)->dh6[1] >= 0)
-    {gradx = 0.5*((*data)->dh6[0]+(*data)->dh6[1]);     grad_tot += fabs(gradx);}
-    else    {gradx = 0.0;   grad_tot += (fabs((*data)->dh6[0]) + fabs((*data)->dh6[1]));}
-    if ((*data)->dh6[2]*(*data)->dh6[3] >= 0)
-    {grady = 0.5*((*data)->dh6[2]+(*data)->dh6[3]);     grad_tot += fabs(grady);}
-    else    {grady = 0.0;   grad_tot += (fabs((*data)->dh6[2]) + fabs((*data)->dh6[3]));}
-    if ((*data)->dh6[4]*(*data)->dh6[5] >= 0)
-    {gradz = 0.5*((*data)->dh6[4]+(*data)->dh6[5]);     grad_tot += fabs(gradz);}
-    else    {gradz = 0.0;   grad_tot += (fabs((*data)->dh6[4]) + fabs((*data)->dh6[5]));}
+    if (dh6[0]*dh6[1] >= 0)
+    {gradx = 0.5*(dh6[0]+dh6[1]);     grad_tot += fabs(gradx);}
+    else    {gradx = 0.0;   grad_tot += (fabs(dh6[0]) + fabs(dh6[1]));}
+    if (dh6[2]*dh6[3] >= 0)
+    {grady = 0.5*(dh6[2]+dh6[3]);     grad_tot += fabs(grady);}
+    else    {grady = 0.0;   grad_tot += (fabs(dh6[2]) + fabs(dh6[3]));}
+    if (dh6[4]*dh6[5] >= 0)
+    {gradz = 0.5*(dh6[4]+dh6[5]);     grad_tot += fabs(gradz);}
+    else    {gradz = 0.0;   grad_tot += (fabs(dh6[4]) + fabs(dh6[5]));}
     // get moisture split ratio
     if (grad_tot > 0)
     {
-        if (gradx > 0)  {(*data)->rsplit[0] = 0.0;  (*data)->rsplit[1] = gradx / grad_tot;}
-        else if (gradx < 0) {(*data)->rsplit[1] = 0.0;  (*data)->rsplit[0] = -gradx / grad_tot;}
-        else    {(*data)->rsplit[0] = fabs((*data)->dh6[0])/grad_tot;   (*data)->rsplit[1] = fabs((*data)->dh6[1])/grad_tot;}
-        if (grady > 0)  {(*data)->rsplit[2] = 0.0;  (*data)->rsplit[3] = grady / grad_tot;}
-        else if (grady < 0) {(*data)->rsplit[3] = 0.0;  (*data)->rsplit[2] = -grady / grad_tot;}
-        else    {(*data)->rsplit[2] = fabs((*data)->dh6[2])/grad_tot;   (*data)->rsplit[3] = fabs((*data)->dh6[3])/grad_tot;}
-        if (gradz > 0)  {(*data)->rsplit[4] = 0.0;  (*data)->rsplit[5] = gradz / grad_tot;}
-        else if (gradz < 0) {(*data)->rsplit[5] = 0.0;  (*data)->rsplit[4] = -gradz / grad_tot;}
-        else    {(*data)->rsplit[4] = fabs((*data)->dh6[4])/grad_tot;   (*data)->rsplit[5] = fabs((*data)->dh6[5])/grad_tot;}
+        if (gradx > 0)  {rsplit[0] = 0.0;  rsplit[1] = gradx / grad_tot;}
+        else if (gradx < 0) {rsplit[1] = 0.0;  rsplit[0] = -gradx / grad_tot;}
+        else    {rsplit[0] = fabs(dh6[0])/grad_tot;   rsplit[1] = fabs(dh6[1])/grad_tot;}
+        if (grady > 0)  {rsplit[2] = 0.0;  rsplit[3] = grady / grad_tot;}
+        else if (grady < 0) {rsplit[3] = 0.0;  rsplit[2] = -grady / grad_tot;}
+        else    {rsplit[2] = fabs(dh6[2])/grad_tot;   rsplit[3] = fabs(dh6[3])/grad_tot;}
+        if (gradz > 0)  {rsplit[4] = 0.0;  rsplit[5] = gradz / grad_tot;}
+        else if (gradz < 0) {rsplit[5] = 0.0;  rsplit[4] = -gradz / grad_tot;}
+        else    {rsplit[4] = fabs(dh6[4])/grad_tot;   rsplit[5] = fabs(dh6[5])/grad_tot;}
     }
     else
-    {for (jj = 0; jj < 6; jj++)  {(*data)->rsplit[jj] = 0.0;}}
+    {for (jj = 0; jj < 6; jj++)  {rsplit[jj] = 0.0;}}
 }
 
 // >>>>> send moisture <<<<<
-double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV)
+double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV, double *rsplit)
 {
     int ll, rev = 0;
     double dVxp=0, dVxm=0, dVyp=0, dVym=0, dVzp=0, dVzm=0, temp, Vres=0.0;
     // send up
-    if ((*data)->rsplit[5] > 0)
+    if (rsplit[5] > 0)
     {
-        dVzm = dV * (*data)->rsplit[5];
+        dVzm = dV * rsplit[5];
         ll = ii;
         while (gmap->istop[ll] != 1)
         {
@@ -906,9 +1046,9 @@ double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV)
         }
     }
     // send down
-    if ((*data)->rsplit[4] > 0)
+    if (rsplit[4] > 0)
     {
-        dVzp = dV * (*data)->rsplit[4];
+        dVzp = dV * rsplit[4];
         ll = ii;
         while (gmap->kk[ll] != param->nz-1)
         {
@@ -937,9 +1077,9 @@ double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV)
         {if (param->bctype_GW[5] == 1)   {dVzp = 0.0;}}
     }
     // send in x direction
-    if ((*data)->rsplit[0] > 0)
+    if (rsplit[0] > 0)
     {
-        dVxp = dV * (*data)->rsplit[0];
+        dVxp = dV * rsplit[0];
         ll = gmap->iPjckc[ii];
         if ((*data)->room[ll] > 0)
         {
@@ -959,9 +1099,9 @@ double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV)
             }
         }
     }
-    if ((*data)->rsplit[1] > 0)
+    if (rsplit[1] > 0)
     {
-        dVxm = dV * (*data)->rsplit[1];
+        dVxm = dV * rsplit[1];
         ll = gmap->iMjckc[ii];
         if ((*data)->room[ll] > 0)
         {
@@ -982,9 +1122,9 @@ double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV)
         }
     }
     // send in y direction
-    if ((*data)->rsplit[2] > 0)
+    if (rsplit[2] > 0)
     {
-        dVyp = dV * (*data)->rsplit[2];
+        dVyp = dV * rsplit[2];
         ll = gmap->icjPkc[ii];
         if ((*data)->room[ll] > 0)
         {
@@ -1004,9 +1144,9 @@ double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV)
             }
         }
     }
-    if ((*data)->rsplit[3] > 0)
+    if (rsplit[3] > 0)
     {
-        dVym = dV * (*data)->rsplit[3];
+        dVym = dV * rsplit[3];
         ll = gmap->icjMkc[ii];
         if ((*data)->room[ll] > 0)
         {
@@ -1029,23 +1169,23 @@ double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV)
     // Check if reversed send is needed
     if (dVzp + dVzm > 0)
     {
-        temp = (*data)->rsplit[5];
-        (*data)->rsplit[5] = (*data)->rsplit[4];
-        (*data)->rsplit[4] = temp;
+        temp = rsplit[5];
+        rsplit[5] = rsplit[4];
+        rsplit[4] = temp;
         Vres += (dVzp + dVzm);
     }
     if (dVxp + dVxm > 0)
     {
-        temp = (*data)->rsplit[1];
-        (*data)->rsplit[1] = (*data)->rsplit[0];
-        (*data)->rsplit[0] = temp;
+        temp = rsplit[1];
+        rsplit[1] = rsplit[0];
+        rsplit[0] = temp;
         Vres += (dVxp + dVxm);
     }
     if (dVyp + dVym > 0)
     {
-        temp = (*data)->rsplit[3];
-        (*data)->rsplit[3] = (*data)->rsplit[2];
-        (*data)->rsplit[2] = temp;
+        temp = rsplit[3];
+        rsplit[3] = rsplit[2];
+        rsplit[2] = temp;
         Vres += (dVyp + dVym);
     }
     return Vres;
@@ -1053,21 +1193,23 @@ double allocate_send(Data **data, Map *gmap, Config *param, int ii, double dV)
 
 
 // >>>>> send moisture <<<<<
-double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
+double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV, double *rsplit)
 {
     int ll, dir, rev = 0;
     double dVxp=0, dVxm=0, dVyp=0, dVym=0, dVzp=0, dVzm=0, temp, Vres=0.0;
+    Material *s;
     // recv from up
-    if ((*data)->rsplit[5] > 0)
+    if (rsplit[5] > 0)
     {
-        dVzm = dV * (*data)->rsplit[5];
+        dVzm = dV * rsplit[5];
         ll = ii;
         while (gmap->istop[ll] != 1)
         {
             ll -= 1;
-            if ((*data)->wc[ll] > (*data)->wcr[ll])
+            s = &(*data)->mat[(*data)->soil[ll]];
+            if ((*data)->wc[ll] > s->wcr)
             {
-                if (((*data)->wc[ll]-(*data)->wcr[ll]) > dVzm / (param->dx*param->dy*gmap->dz3d[ll]))
+                if (((*data)->wc[ll]-s->wcr) > dVzm / (param->dx*param->dy*gmap->dz3d[ll]))
                 {
                     (*data)->wc[ll] -= dVzm / (param->dx*param->dy*gmap->dz3d[ll]);
                     (*data)->qz[ll] -= dVzm / (param->dx * param->dy * param->dt);
@@ -1077,10 +1219,10 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
                 }
                 else
                 {
-                    dVzm -= ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                    (*data)->qz[ll] -= ((*data)->wc[ll]-(*data)->wcr[ll]) / (param->dx * param->dy * param->dt);
-                    (*data)->room[ll] += ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                    (*data)->wc[ll] = (*data)->wcr[ll];
+                    dVzm -= ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                    (*data)->qz[ll] -= ((*data)->wc[ll]-s->wcr) / (param->dx * param->dy * param->dt);
+                    (*data)->room[ll] += ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                    (*data)->wc[ll] = s->wcr;
                 }
             }
             // limite recv to 1 adjacent cell, ZhiLi20200827
@@ -1106,16 +1248,17 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
         }
     }
     // recv from bottom
-    if ((*data)->rsplit[4] > 0)
+    if (rsplit[4] > 0)
     {
-        dVzp = dV * (*data)->rsplit[4];
+        dVzp = dV * rsplit[4];
         ll = ii;
         while (gmap->kk[ll] != param->nz-1)
         {
             ll += 1;
-            if ((*data)->wc[ll] > (*data)->wcr[ll])
+            s = &(*data)->mat[(*data)->soil[ll]];
+            if ((*data)->wc[ll] > s->wcr)
             {
-                if (((*data)->wc[ll]-(*data)->wcr[ll]) > dVzp / (param->dx*param->dy*gmap->dz3d[ll]))
+                if (((*data)->wc[ll]-s->wcr) > dVzp / (param->dx*param->dy*gmap->dz3d[ll]))
                 {
                     (*data)->wc[ll] -= dVzp / (param->dx*param->dy*gmap->dz3d[ll]);
                     (*data)->qz[gmap->icjckM[ll]] += dVzp / (param->dx * param->dy * param->dt);
@@ -1125,10 +1268,10 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
                 }
                 else
                 {
-                    dVzp -= ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                    (*data)->qz[gmap->icjckM[ll]] += ((*data)->wc[ll]-(*data)->wcr[ll]) / (param->dx * param->dy * param->dt);
-                    (*data)->room[ll] += ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                    (*data)->wc[ll] = (*data)->wcr[ll];
+                    dVzp -= ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                    (*data)->qz[gmap->icjckM[ll]] += ((*data)->wc[ll]-s->wcr) / (param->dx * param->dy * param->dt);
+                    (*data)->room[ll] += ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                    (*data)->wc[ll] = s->wcr;
                     // Limit recv within 1 neighbor cell to avoid instability! ZhiLi20200621
                     dVzp = 0.0;
                 }
@@ -1140,13 +1283,14 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
         if (dVzp > 0.0) {if (param->bctype_GW[4] == 1)   {dVzp = 0.0;}}
     }
     // send in x direction
-    if ((*data)->rsplit[0] > 0)
+    if (rsplit[0] > 0)
     {
-        dVxp = dV * (*data)->rsplit[0];
+        dVxp = dV * rsplit[0];
         ll = gmap->iPjckc[ii];
-        if ((*data)->wc[ll] > (*data)->wcr[ll])
+        s = &(*data)->mat[(*data)->soil[ll]];
+        if ((*data)->wc[ll] > s->wcr)
         {
-            if (((*data)->wc[ll]-(*data)->wcr[ll]) > dVxp / (param->dx*param->dy*gmap->dz3d[ll]))
+            if (((*data)->wc[ll]-s->wcr) > dVxp / (param->dx*param->dy*gmap->dz3d[ll]))
             {
                 (*data)->wc[ll] -= dVxp / (param->dx*param->dy*gmap->dz3d[ll]);
                 (*data)->qx[gmap->iMjckc[ll]] += dVxp / (gmap->dz3d[ll] * param->dy * param->dt);
@@ -1155,20 +1299,21 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
             }
             else
             {
-                dVxp -= ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                (*data)->qx[gmap->iMjckc[ll]] += ((*data)->wc[ll]-(*data)->wcr[ll]) / (gmap->dz3d[ll] * param->dy * param->dt);
-                (*data)->room[ll] += ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                (*data)->wc[ll] = (*data)->wcr[ll];
+                dVxp -= ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                (*data)->qx[gmap->iMjckc[ll]] += ((*data)->wc[ll]-s->wcr) / (gmap->dz3d[ll] * param->dy * param->dt);
+                (*data)->room[ll] += ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                (*data)->wc[ll] = s->wcr;
             }
         }
     }
-    if ((*data)->rsplit[1] > 0)
+    if (rsplit[1] > 0)
     {
-        dVxm = dV * (*data)->rsplit[1];
+        dVxm = dV * rsplit[1];
         ll = gmap->iMjckc[ii];
-        if ((*data)->wc[ll] > (*data)->wcr[ll])
+        s = &(*data)->mat[(*data)->soil[ll]];
+        if ((*data)->wc[ll] > s->wcr)
         {
-            if (((*data)->wc[ll]-(*data)->wcr[ll]) > dVxm / (param->dx*param->dy*gmap->dz3d[ll]))
+            if (((*data)->wc[ll]-s->wcr) > dVxm / (param->dx*param->dy*gmap->dz3d[ll]))
             {
                 (*data)->wc[ll] -= dVxm / (param->dx*param->dy*gmap->dz3d[ll]);
                 (*data)->qx[ll] -= dVxm / (gmap->dz3d[ll] * param->dy * param->dt);
@@ -1177,21 +1322,22 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
             }
             else
             {
-                dVxm -= ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                (*data)->qx[ll] -= ((*data)->wc[ll]-(*data)->wcr[ll]) / (gmap->dz3d[ll] * param->dy * param->dt);
-                (*data)->room[ll] += ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                (*data)->wc[ll] = (*data)->wcr[ll];
+                dVxm -= ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                (*data)->qx[ll] -= ((*data)->wc[ll]-s->wcr) / (gmap->dz3d[ll] * param->dy * param->dt);
+                (*data)->room[ll] += ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                (*data)->wc[ll] = s->wcr;
             }
         }
     }
     // send in y direction
-    if ((*data)->rsplit[2] > 0)
+    if (rsplit[2] > 0)
     {
-        dVyp = dV * (*data)->rsplit[2];
+        dVyp = dV * rsplit[2];
         ll = gmap->icjPkc[ii];
-        if ((*data)->wc[ll] > (*data)->wcr[ll])
+        s = &(*data)->mat[(*data)->soil[ll]];
+        if ((*data)->wc[ll] > s->wcr)
         {
-            if (((*data)->wc[ll]-(*data)->wcr[ll]) > dVyp / (param->dx*param->dy*gmap->dz3d[ll]))
+            if (((*data)->wc[ll]-s->wcr) > dVyp / (param->dx*param->dy*gmap->dz3d[ll]))
             {
                 (*data)->wc[ll] -= dVyp / (param->dx*param->dy*gmap->dz3d[ll]);
                 (*data)->qy[gmap->icjMkc[ll]] += dVyp / (gmap->dz3d[ll] * param->dx * param->dt);
@@ -1200,22 +1346,23 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
             }
             else
             {
-                dVyp -= ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                (*data)->qy[gmap->icjMkc[ll]] += ((*data)->wc[ll]-(*data)->wcr[ll]) / (gmap->dz3d[ll] * param->dx * param->dt);
-                (*data)->room[ll] += ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                (*data)->wc[ll] = (*data)->wcr[ll];
+                dVyp -= ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                (*data)->qy[gmap->icjMkc[ll]] += ((*data)->wc[ll]-s->wcr) / (gmap->dz3d[ll] * param->dx * param->dt);
+                (*data)->room[ll] += ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                (*data)->wc[ll] = s->wcr;
             }
         }
         // limite recv to 1 adjacent cell, ZhiLi20200827
         dVyp = 0.0;
     }
-    if ((*data)->rsplit[3] > 0)
+    if (rsplit[3] > 0)
     {
-        dVym = dV * (*data)->rsplit[3];
+        dVym = dV * rsplit[3];
         ll = gmap->icjMkc[ii];
-        if ((*data)->wc[ll] > (*data)->wcr[ll])
+        s = &(*data)->mat[(*data)->soil[ll]];
+        if ((*data)->wc[ll] > s->wcr)
         {
-            if (((*data)->wc[ll]-(*data)->wcr[ll]) > dVym / (param->dx*param->dy*gmap->dz3d[ll]))
+            if (((*data)->wc[ll]-s->wcr) > dVym / (param->dx*param->dy*gmap->dz3d[ll]))
             {
                 (*data)->wc[ll] -= dVym / (param->dx*param->dy*gmap->dz3d[ll]);
                 (*data)->qy[ll] -= dVym / (gmap->dz3d[ll] * param->dx * param->dt);
@@ -1224,10 +1371,10 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
             }
             else
             {
-                dVym -= ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                (*data)->qy[ll] -= ((*data)->wc[ll]-(*data)->wcr[ll]) / (gmap->dz3d[ll] * param->dx * param->dt);
-                (*data)->room[ll] += ((*data)->wc[ll]-(*data)->wcr[ll]) * (param->dx*param->dy*gmap->dz3d[ll]);
-                (*data)->wc[ll] = (*data)->wcr[ll];
+                dVym -= ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                (*data)->qy[ll] -= ((*data)->wc[ll]-s->wcr) / (gmap->dz3d[ll] * param->dx * param->dt);
+                (*data)->room[ll] += ((*data)->wc[ll]-s->wcr) * (param->dx*param->dy*gmap->dz3d[ll]);
+                (*data)->wc[ll] = s->wcr;
             }
         }
         // limite recv to 1 adjacent cell, ZhiLi20200827
@@ -1236,23 +1383,23 @@ double allocate_recv(Data **data, Map *gmap, Config *param, int ii, double dV)
     // Check if reversed send is needed
     if (dVzp + dVzm > 0)
     {
-        temp = (*data)->rsplit[5];
-        (*data)->rsplit[5] = (*data)->rsplit[4];
-        (*data)->rsplit[4] = temp;
+        temp = rsplit[5];
+        rsplit[5] = rsplit[4];
+        rsplit[4] = temp;
         Vres += (dVzp + dVzm);
     }
     if (dVxp + dVxm > 0)
     {
-        temp = (*data)->rsplit[1];
-        (*data)->rsplit[1] = (*data)->rsplit[0];
-        (*data)->rsplit[0] = temp;
+        temp = rsplit[1];
+        rsplit[1] = rsplit[0];
+        rsplit[0] = temp;
         Vres += (dVxp + dVxm);
     }
     if (dVyp + dVym > 0)
     {
-        temp = (*data)->rsplit[3];
-        (*data)->rsplit[3] = (*data)->rsplit[2];
-        (*data)->rsplit[2] = temp;
+        temp = rsplit[3];
+        rsplit[3] = rsplit[2];
+        rsplit[2] = temp;
         Vres += (dVyp + dVym);
     }
     return Vres;
@@ -1298,7 +1445,7 @@ void adaptive_time_step(Data *data, Map *gmap, Config **param, int root, int ira
             if (dq > dq_max)    {dq_max = dq;}
             if (data->wc[ii] < (*param)->wcs)
             {
-                dKdwc = compute_dKdwc(data, data->Ksz, ii, *param);
+                dKdwc = compute_dKdwc(data, 2, ii, *param);
                 dt_Co = (*param)->Co_max * gmap->dz3d[ii] / dKdwc;
                 if (dt_Co < dt_Comin)   {dt_Comin = dt_Co;}
             }
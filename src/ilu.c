@@ -0,0 +1,138 @@
+// Incomplete LU preconditioner for the surface and subsurface systems
+// LASPack ILUPrecond factorizes the matrix and composes temporary matrices
+// on every application. Here the factors are stored with the system, the
+// triangular solves run on compressed rows, and a new factorization is only
+// computed when the diagonal has changed by more than the drift since the
+// last one. The off-diagonals of Sct and Gct change with the diagonal, so the
+// drift of the diagonal measures how stale the factors are.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include "ilu.h"
+
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+void init_ilu(Ilu **ilu, QMatrix *A, double drift);
+void ilu_update(Ilu *ilu, QMatrix *A);
+void ilu_factor(Ilu *ilu, QMatrix *A);
+void ilu_solve(Ilu *ilu, double *y, double *c);
+void ilu_activate(Ilu *ilu);
+Vector *ILU0Precond(QMatrix *A, Vector *y, Vector *c, double omega);
+
+// factors used by ILU0Precond, LASPack passes no context to preconditioners
+static Ilu *active_ilu = NULL;
+
+// >>>>> Copy the final pattern of A <<<<<
+void init_ilu(Ilu **ilu, QMatrix *A, double drift)
+{
+    size_t ii, kk, n = Q_GetDim(A);
+    *ilu = malloc(sizeof(Ilu));
+    (*ilu)->n = n;
+    (*ilu)->ia = malloc((n+1)*sizeof(size_t));
+    (*ilu)->id = malloc(n*sizeof(size_t));
+    (*ilu)->ia[0] = 0;
+    for (ii = 0; ii < n; ii++)  {(*ilu)->ia[ii+1] = (*ilu)->ia[ii] + A->Len[ii+1];}
+    (*ilu)->ja = malloc((*ilu)->ia[n]*sizeof(int));
+    for (ii = 0; ii < n; ii++)
+    {
+        for (kk = 0; kk < A->Len[ii+1]; kk++)
+        {
+            (*ilu)->ja[(*ilu)->ia[ii]+kk] = A->El[ii+1][kk].Pos - 1;
+            if (A->El[ii+1][kk].Pos == ii+1)    {(*ilu)->id[ii] = (*ilu)->ia[ii] + kk;}
+        }
+    }
+    (*ilu)->mark = malloc(n*sizeof(int));
+    for (ii = 0; ii < n; ii++)  {(*ilu)->mark[ii] = -1;}
+    (*ilu)->a = malloc((*ilu)->ia[n]*sizeof(double));
+    (*ilu)->invd = malloc(n*sizeof(double));
+    (*ilu)->dsetup = calloc(n, sizeof(double));
+    (*ilu)->drift = drift;
+    (*ilu)->nsetup = 0;
+    (*ilu)->nreuse = 0;
+}
+
+// >>>>> Refactorize if the diagonal has drifted <<<<<
+// The old factors stay a good preconditioner as long as no diagonal entry
+// has changed by more than the relative drift since the last factorization.
+void ilu_update(Ilu *ilu, QMatrix *A)
+{
+    size_t ii;
+    double diag, change = 0.0;
+    for (ii = 0; ii < ilu->n; ii++)
+    {
+        diag = A->DiagEl[ii+1]->Val;
+        if (fabs(diag - ilu->dsetup[ii]) > change * fabs(ilu->dsetup[ii]))
+        {change = fabs(diag - ilu->dsetup[ii]) / fabs(ilu->dsetup[ii]);}
+    }
+    if (ilu->nsetup == 0 | change > ilu->drift)  {ilu_factor(ilu, A);}
+    else    {ilu->nreuse += 1;}
+}
+
+// >>>>> ILU(0) factorization of the current values of A <<<<<
+// Row by row, every entry left of the diagonal eliminates with the U row of
+// its column, updates outside the pattern are dropped. A pivot that is not
+// positive is replaced by the diagonal of A.
+void ilu_factor(Ilu *ilu, QMatrix *A)
+{
+    size_t ii, jj, kk, ll;
+    int *mark = ilu->mark;
+    double *a = ilu->a;
+    for (ii = 0; ii < ilu->n; ii++)
+    {
+        for (kk = 0; kk < A->Len[ii+1]; kk++)   {a[ilu->ia[ii]+kk] = A->El[ii+1][kk].Val;}
+        ilu->dsetup[ii] = A->DiagEl[ii+1]->Val;
+    }
+    for (ii = 0; ii < ilu->n; ii++)
+    {
+        for (kk = ilu->ia[ii]; kk < ilu->ia[ii+1]; kk++)    {mark[ilu->ja[kk]] = kk;}
+        for (kk = ilu->ia[ii]; kk < ilu->id[ii]; kk++)
+        {
+            jj = ilu->ja[kk];
+            a[kk] *= ilu->invd[jj];
+            for (ll = ilu->id[jj]+1; ll < ilu->ia[jj+1]; ll++)
+            {if (mark[ilu->ja[ll]] >= 0)   {a[mark[ilu->ja[ll]]] -= a[kk] * a[ll];}}
+        }
+        for (kk = ilu->ia[ii]; kk < ilu->ia[ii+1]; kk++)    {mark[ilu->ja[kk]] = -1;}
+        if (a[ilu->id[ii]] <= 0.0)  {a[ilu->id[ii]] = ilu->dsetup[ii];}
+        ilu->invd[ii] = 1.0 / a[ilu->id[ii]];
+    }
+    ilu->nsetup += 1;
+}
+
+// >>>>> y = (LU)^(-1) * c, works in place <<<<<
+void ilu_solve(Ilu *ilu, double *y, double *c)
+{
+    size_t ii, kk;
+    double sum;
+    for (ii = 0; ii < ilu->n; ii++)
+    {
+        sum = c[ii];
+        for (kk = ilu->ia[ii]; kk < ilu->id[ii]; kk++) {sum -= ilu->a[kk] * y[ilu->ja[kk]];}
+        y[ii] = sum;
+    }
+    for (ii = ilu->n; ii-- > 0; )
+    {
+        sum = y[ii];
+        for (kk = ilu->id[ii]+1; kk < ilu->ia[ii+1]; kk++)  {sum -= ilu->a[kk] * y[ilu->ja[kk]];}
+        y[ii] = sum * ilu->invd[ii];
+    }
+}
+
+// >>>>> Select the factors applied by ILU0Precond <<<<<
+void ilu_activate(Ilu *ilu)
+{
+    active_ilu = ilu;
+}
+
+// >>>>> LASPack preconditioner interface, omega is not used <<<<<
+Vector *ILU0Precond(QMatrix *A, Vector *y, Vector *c, double omega)
+{
+    size_t ii;
+    ilu_solve(active_ilu, y->Cmp+1, c->Cmp+1);
+    // the solve is linear, a pending multiplier of c carries over to y
+    for (ii = 1; ii <= y->Dim; ii++)    {y->Cmp[ii] *= c->Multipl;}
+    y->Multipl = 1.0;
+    return y;
+}
@@ -0,0 +1,27 @@
+// Header file for ilu.c
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+#ifndef ILU_H
+#define ILU_H
+
+// incomplete LU factorization without fill-in of a LASPack matrix
+// L and U share the pattern of A in compressed rows, id is the position of
+// the diagonal in every row, L has a unit diagonal. For the symmetric
+// systems of FREHG this is IC(0) with the diagonal kept separately. The
+// factors are kept until the diagonal drifts beyond drift.
+typedef struct Ilu
+{
+    size_t n, *ia, *id;
+    int *ja, *mark, nsetup, nreuse;
+    double *a, *invd, *dsetup, drift;
+}Ilu;
+
+#endif
+
+void init_ilu(Ilu **ilu, QMatrix *A, double drift);
+void ilu_update(Ilu *ilu, QMatrix *A);
+void ilu_factor(Ilu *ilu, QMatrix *A);
+void ilu_solve(Ilu *ilu, double *y, double *c);
+void ilu_activate(Ilu *ilu);
+Vector *ILU0Precond(QMatrix *A, Vector *y, Vector *c, double omega);
@@ -26,7 +26,10 @@ void ic_surface(Data **data, Map *smap, Map *gmap, Config *param, int irank, int
 void bc_surface(Data **data, Map *smap, Config *param, int irank);
 void get_BC_location(int **loc, int *loc_len, Config *param, int irank, int n_bc, int *locX, int *locY);
 void update_depth(Data **data, Map *smap, Config *param, int irank);
+void update_face_depth(Data **data, Map *smap, Config *param, int ii);
+void update_boundary_depth(Data **data, Map *smap, Config *param);
 void ic_subsurface(Data **data, Map *gmap, Config *param, int irank, int nrank);
+void init_soil(Data **data, Map *gmap, Config *param, int irank, int nrank);
 void restart_subsurface(double *ic_array, char *fname, Config *param, int irank);
 
 // >>>>> Initialize FREHG <<<<<
@@ -45,6 +48,11 @@ void init(Data **data, Map **smap, Map **gmap, Config **param, int irank, int nr
     boundary_bath(data, *smap, *param, irank, nrank);
     // initialize data array
     init_Data(data, *param);
+    if (irank == 0)
+    {
+        printf(" >>> %d data fields allocated in %.1f MB, huge pages = %d\n", \
+            (*data)->arena->nfield,(*data)->arena->used/1048576.0,(*data)->arena->huge);
+    }
     // boundary condition for shallow water solver
     bc_surface(data, *smap, *param, irank);
     get_current_bc(data, *param, 0.0);
@@ -59,6 +67,10 @@ void init(Data **data, Map **smap, Map **gmap, Config **param, int irank, int nr
     // boundary condition for groundwater solver
     enforce_head_bc(data, *gmap, *param);
     mpi_print(" >>> Initial conditions applied !", irank);
+    // linear systems are allocated once and reused in every time step
+    if ((*param)->sim_shallowwater == 1)    {init_shallowwater_system(data, *smap, *param, irank, nrank);}
+    if ((*param)->sim_groundwater == 1) {init_groundwater_system(data, *gmap, *param, irank, nrank);}
+    mpi_print(" >>> Linear systems allocated !", irank);
 
     mpi_print(" >>> Initialization completed !", irank);
 
@@ -172,119 +184,112 @@ void boundary_bath(Data **data, Map *smap, Config *param, int irank, int nrank)
 void init_Data(Data **data, Config *param)
 {
     int ii, n2_root, n3_root;
+    Arena *arena;
     n2_root = param->n2ci*param->mpi_nx*param->mpi_ny;
     n3_root = param->n3ci*param->mpi_nx*param->mpi_ny;
+    init_arena(&arena, param->use_hugepage);
+    (*data)->arena = arena;
     // surface fields
-    (*data)->uu = malloc(param->n2ct*sizeof(double));
-    (*data)->un = malloc(param->n2ct*sizeof(double));
-    (*data)->uy = malloc(param->n2ct*sizeof(double));
-    (*data)->vv = malloc(param->n2ct*sizeof(double));
-    (*data)->vn = malloc(param->n2ct*sizeof(double));
-    (*data)->vx = malloc(param->n2ct*sizeof(double));
-    (*data)->eta = malloc(param->n2ct*sizeof(double));
-    (*data)->etan = malloc(param->n2ct*sizeof(double));
-    (*data)->dept = malloc(param->n2ct*sizeof(double));
-    (*data)->deptx = malloc(param->n2ct*sizeof(double));
-    (*data)->depty = malloc(param->n2ct*sizeof(double));
-    (*data)->Fu = malloc(param->n2ct*sizeof(double));
-    (*data)->Fv = malloc(param->n2ct*sizeof(double));
-    (*data)->Ex = malloc(param->n2ct*sizeof(double));
-    (*data)->Ey = malloc(param->n2ct*sizeof(double));
-    (*data)->Dx = malloc(param->n2ct*sizeof(double));
-    (*data)->Dy = malloc(param->n2ct*sizeof(double));
-    (*data)->CDx = malloc(param->n2ct*sizeof(double));
-    (*data)->CDy = malloc(param->n2ct*sizeof(double));
-    (*data)->Vs = malloc(param->n2ct*sizeof(double));
-    (*data)->Vsn = malloc(param->n2ct*sizeof(double));
-    (*data)->Vflux = malloc(param->n2ci*sizeof(double));
-    (*data)->Vsx = malloc(param->n2ct*sizeof(double));
-    (*data)->Vsy = malloc(param->n2ct*sizeof(double));
-    (*data)->Asz = malloc(param->n2ct*sizeof(double));
-    (*data)->Aszx = malloc(param->n2ct*sizeof(double));
-    (*data)->Aszy = malloc(param->n2ct*sizeof(double));
-    (*data)->Asx = malloc(param->n2ct*sizeof(double));
-    (*data)->Asy = malloc(param->n2ct*sizeof(double));
-    (*data)->wtfx = malloc(param->n2ct*sizeof(double));
-    (*data)->wtfy = malloc(param->n2ct*sizeof(double));
+    arena_add(arena, &(*data)->uu, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->un, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->uy, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->vv, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->vn, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->vx, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->eta, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->etan, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->dept, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->deptx, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->depty, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Fu, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Fv, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Ex, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Ey, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Dx, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Dy, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->CDx, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->CDy, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Vs, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Vsn, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Vflux, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->Vsx, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Vsy, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Asz, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Aszx, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Aszy, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Asx, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->Asy, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->wtfx, param->n2ct, sizeof(double));
+    arena_add(arena, &(*data)->wtfy, param->n2ct, sizeof(double));
 
-    (*data)->uu_root = malloc(n2_root*sizeof(double));
-    (*data)->vv_root = malloc(n2_root*sizeof(double));
-    (*data)->un_root = malloc(n2_root*sizeof(double));
-    (*data)->vn_root = malloc(n2_root*sizeof(double));
-    (*data)->eta_root = malloc(n2_root*sizeof(double));
-    (*data)->dept_root = malloc(n2_root*sizeof(double));
-    (*data)->seep_root = malloc(n2_root*sizeof(double));
-    (*data)->uu_out = malloc(n2_root*sizeof(double));
-    (*data)->vv_out = malloc(n2_root*sizeof(double));
-    (*data)->un_out = malloc(n2_root*sizeof(double));
-    (*data)->vn_out = malloc(n2_root*sizeof(double));
-    (*data)->eta_out = malloc(n2_root*sizeof(double));
-    (*data)->dept_out = malloc(n2_root*sizeof(double));
-    (*data)->seep_out = malloc(n2_root*sizeof(double));
+    arena_add(arena, &(*data)->uu_root, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->vv_root, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->un_root, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->vn_root, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->eta_root, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->dept_root, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->seep_root, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->uu_out, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->vv_out, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->un_out, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->vn_out, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->eta_out, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->dept_out, n2_root, sizeof(double));
+    arena_add(arena, &(*data)->seep_out, n2_root, sizeof(double));
 
-    (*data)->reset_seepage = malloc(param->n2ci*sizeof(int));
-    (*data)->qseepage = malloc(param->n2ci*sizeof(double));
-    (*data)->cflx = malloc(param->n2ci*sizeof(double));
-    (*data)->cfly = malloc(param->n2ci*sizeof(double));
-    (*data)->cfl_active = malloc(param->n2ci*sizeof(double));
+    arena_add(arena, &(*data)->reset_seepage, param->n2ci, sizeof(int));
+    arena_add(arena, &(*data)->qseepage, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->cflx, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->cfly, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->cfl_active, param->n2ci, sizeof(double));
 
-    (*data)->wind_spd = malloc(1*sizeof(double));
-    (*data)->wind_dir = malloc(1*sizeof(double));
+    arena_add(arena, &(*data)->wind_spd, 1, sizeof(double));
+    arena_add(arena, &(*data)->wind_dir, 1, sizeof(double));
 
-    (*data)->rain = malloc(1*sizeof(double));
-    (*data)->rain_sum = malloc(1*sizeof(double));
-    (*data)->rain_sum[0] = 0.0;
-    (*data)->evap = malloc(param->n2ci*sizeof(double));
+    arena_add(arena, &(*data)->rain, 1, sizeof(double));
+    arena_add(arena, &(*data)->rain_sum, 1, sizeof(double));
+    arena_add(arena, &(*data)->evap, param->n2ci, sizeof(double));
 
     // subsurface fields
-    (*data)->repeat = malloc(1*sizeof(int));
-    (*data)->h = malloc(param->n3ct*sizeof(double));
-    (*data)->hp = malloc(param->n3ct*sizeof(double));
-    (*data)->hn = malloc(param->n3ct*sizeof(double));
-    (*data)->hwc = malloc(param->n3ct*sizeof(double));
-    (*data)->wc = malloc(param->n3ct*sizeof(double));
-    (*data)->wcn = malloc(param->n3ct*sizeof(double));
-    (*data)->wcp = malloc(param->n3ct*sizeof(double));
-    (*data)->wch = malloc(param->n3ct*sizeof(double));
-    (*data)->ch = malloc(param->n3ct*sizeof(double));
-    (*data)->wcs = malloc(param->n3ct*sizeof(double));
-    (*data)->wcr = malloc(param->n3ct*sizeof(double));
-    (*data)->vga = malloc(param->n3ct*sizeof(double));
-    (*data)->vgn = malloc(param->n3ct*sizeof(double));
-    (*data)->Ksx = malloc(param->n3ct*sizeof(double));
-    (*data)->Ksy = malloc(param->n3ct*sizeof(double));
-    (*data)->Ksz = malloc(param->n3ct*sizeof(double));
-    (*data)->Kx = malloc(param->n3ct*sizeof(double));
-    (*data)->Ky = malloc(param->n3ct*sizeof(double));
-    (*data)->Kz = malloc(param->n3ct*sizeof(double));
-    (*data)->r_rho = malloc(param->n3ct*sizeof(double));
-    (*data)->r_rhon = malloc(param->n3ct*sizeof(double));
-    (*data)->r_visc = malloc(param->n3ct*sizeof(double));
-    (*data)->qx = malloc(param->n3ct*sizeof(double));
-    (*data)->qy = malloc(param->n3ct*sizeof(double));
-    (*data)->qz = malloc(param->n3ct*sizeof(double));
-    (*data)->Vg = malloc(param->n3ct*sizeof(double));
-    (*data)->Vgn = malloc(param->n3ct*sizeof(double));
-    (*data)->Vgflux = malloc(param->n3ci*sizeof(double));
-    (*data)->room = malloc(param->n3ct*sizeof(double));
-    (*data)->vloss = malloc(param->n3ci*sizeof(double));
-    (*data)->h_root = malloc(n3_root*sizeof(double));
-    (*data)->wc_root = malloc(n3_root*sizeof(double));
-    (*data)->vloss_root = malloc(n3_root*sizeof(double));
-    (*data)->qx_root = malloc(n3_root*sizeof(double));
-    (*data)->qy_root = malloc(n3_root*sizeof(double));
-    (*data)->qz_root = malloc(n3_root*sizeof(double));
-    (*data)->h_out = malloc(n3_root*sizeof(double));
-    (*data)->wc_out = malloc(n3_root*sizeof(double));
-    (*data)->qx_out = malloc(n3_root*sizeof(double));
-    (*data)->qy_out = malloc(n3_root*sizeof(double));
-    (*data)->qz_out = malloc(n3_root*sizeof(double));
-    (*data)->dh6 = malloc(6*sizeof(double));
-    (*data)->rsplit = malloc(6*sizeof(double));
-    (*data)->qbc = malloc(2*sizeof(double));
-    (*data)->qbc[0] = 0.0;
-    (*data)->qbc[1] = 0.0;
-    (*data)->qtop = malloc(param->n2ci*sizeof(double));
+    arena_add(arena, &(*data)->repeat, 1, sizeof(int));
+    arena_add(arena, &(*data)->h, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->hp, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->hn, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->hwc, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->wc, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->wcn, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->wcp, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->wch, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->ch, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->soil, param->n3ct, sizeof(unsigned char));
+    arena_add(arena, &(*data)->wcs_top, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->Kx, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->Ky, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->Kz, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->r_rho, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->r_rhon, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->r_visc, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->qx, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->qy, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->qz, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->Vg, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->Vgn, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->Vgflux, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->room, param->n3ct, sizeof(double));
+    arena_add(arena, &(*data)->vloss, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->h_root, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->wc_root, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->vloss_root, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->qx_root, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->qy_root, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->qz_root, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->h_out, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->wc_out, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->qx_out, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->qy_out, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->qz_out, n3_root, sizeof(double));
+    arena_add(arena, &(*data)->qbc, 2, sizeof(double));
+    arena_add(arena, &(*data)->qtop, param->n2ci, sizeof(double));
 
     // scalar
     if (param->n_scalar > 0)
@@ -301,44 +306,50 @@ void init_Data(Data **data, Config *param)
         (*data)->s_surfkP = malloc(param->n_scalar*sizeof(double *));
         for (ii = 0; ii < param->n_scalar; ii++)
         {
-            (*data)->s_surf[ii] = malloc(param->n2ct*sizeof(double));
-            (*data)->s_subs[ii] = malloc(param->n3ct*sizeof(double));
-            (*data)->sm_surf[ii] = malloc(param->n2ct*sizeof(double));
-            (*data)->sm_subs[ii] = malloc(param->n3ct*sizeof(double));
-            (*data)->s_surf_root[ii] = malloc(n2_root*sizeof(double));
-            (*data)->s_subs_root[ii] = malloc(n3_root*sizeof(double));
-            (*data)->s_surf_out[ii] = malloc(n2_root*sizeof(double));
-            (*data)->s_subs_out[ii] = malloc(n3_root*sizeof(double));
-            (*data)->sseepage[ii] = malloc(param->n2ci*sizeof(double));
-            (*data)->s_surfkP[ii] = malloc(param->n2ci*sizeof(double));
+            arena_add(arena, &(*data)->s_surf[ii], param->n2ct, sizeof(double));
+            arena_add(arena, &(*data)->s_subs[ii], param->n3ct, sizeof(double));
+            arena_add(arena, &(*data)->sm_surf[ii], param->n2ct, sizeof(double));
+            arena_add(arena, &(*data)->sm_subs[ii], param->n3ct, sizeof(double));
+            arena_add(arena, &(*data)->s_surf_root[ii], n2_root, sizeof(double));
+            arena_add(arena, &(*data)->s_subs_root[ii], n3_root, sizeof(double));
+            arena_add(arena, &(*data)->s_surf_out[ii], n2_root, sizeof(double));
+            arena_add(arena, &(*data)->s_subs_out[ii], n3_root, sizeof(double));
+            arena_add(arena, &(*data)->sseepage[ii], param->n2ci, sizeof(double));
+            arena_add(arena, &(*data)->s_surfkP[ii], param->n2ci, sizeof(double));
         }
-        (*data)->Dxx = malloc(param->n3ct*sizeof(double));
-        (*data)->Dxy = malloc(param->n3ct*sizeof(double));
-        (*data)->Dxz = malloc(param->n3ct*sizeof(double));
-        (*data)->Dyy = malloc(param->n3ct*sizeof(double));
-        (*data)->Dyx = malloc(param->n3ct*sizeof(double));
-        (*data)->Dyz = malloc(param->n3ct*sizeof(double));
-        (*data)->Dzz = malloc(param->n3ct*sizeof(double));
-        (*data)->Dzx = malloc(param->n3ct*sizeof(double));
-        (*data)->Dzy = malloc(param->n3ct*sizeof(double));
+        arena_add(arena, &(*data)->Dxx, param->n3ct, sizeof(double));
+        arena_add(arena, &(*data)->Dxy, param->n3ct, sizeof(double));
+        arena_add(arena, &(*data)->Dxz, param->n3ct, sizeof(double));
+        arena_add(arena, &(*data)->Dyy, param->n3ct, sizeof(double));
+        arena_add(arena, &(*data)->Dyx, param->n3ct, sizeof(double));
+        arena_add(arena, &(*data)->Dyz, param->n3ct, sizeof(double));
+        arena_add(arena, &(*data)->Dzz, param->n3ct, sizeof(double));
+        arena_add(arena, &(*data)->Dzx, param->n3ct, sizeof(double));
+        arena_add(arena, &(*data)->Dzy, param->n3ct, sizeof(double));
     }
 
     // linear system solver
-    (*data)->Sct = malloc(param->n2ci*sizeof(double));
-    (*data)->Sxp = malloc(param->n2ci*sizeof(double));
-    (*data)->Sxm = malloc(param->n2ci*sizeof(double));
-    (*data)->Syp = malloc(param->n2ci*sizeof(double));
-    (*data)->Sym = malloc(param->n2ci*sizeof(double));
-    (*data)->Srhs = malloc(param->n2ci*sizeof(double));
+    arena_add(arena, &(*data)->Sct, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->Sxp, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->Sxm, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->Syp, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->Sym, param->n2ci, sizeof(double));
+    arena_add(arena, &(*data)->Srhs, param->n2ci, sizeof(double));
 
-    (*data)->Gct = malloc(param->n3ci*sizeof(double));
-    (*data)->Gxp = malloc(param->n3ci*sizeof(double));
-    (*data)->Gxm = malloc(param->n3ci*sizeof(double));
-    (*data)->Gyp = malloc(param->n3ci*sizeof(double));
-    (*data)->Gym = malloc(param->n3ci*sizeof(double));
-    (*data)->Gzp = malloc(param->n3ci*sizeof(double));
-    (*data)->Gzm = malloc(param->n3ci*sizeof(double));
-    (*data)->Grhs = malloc(param->n3ci*sizeof(double));
+    arena_add(arena, &(*data)->Gct, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->Gxp, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->Gxm, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->Gyp, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->Gym, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->Gzp, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->Gzm, param->n3ci, sizeof(double));
+    arena_add(arena, &(*data)->Grhs, param->n3ci, sizeof(double));
+
+    // carve out and first touch all fields
+    arena_alloc(arena);
+    (*data)->rain_sum[0] = 0.0;
+    (*data)->qbc[0] = 0.0;
+    (*data)->qbc[1] = 0.0;
 }
 
 // >>>>> Initial condition for shallow water solver <<<<<
@@ -712,7 +723,7 @@ void get_BC_location(int **loc, int *loc_len, Config *param, int irank, int n_bc
 void update_depth(Data **data, Map *smap, Config *param, int irank)
 {
     int ii;
-    double eta_hi, bot_hi, diff;
+    double diff;
     // remove small depth
     for (ii = 0; ii < param->n2ci; ii++)
     {
@@ -729,23 +740,45 @@ void update_depth(Data **data, Map *smap, Config *param, int irank)
         (*data)->depty[ii] = 0.0;
     }
     // internal face depth
-    for (ii = 0; ii < param->n2ci; ii++)
-    {
-        // x
-        eta_hi = (*data)->eta[ii];
-        bot_hi = (*data)->bottom[ii];
-        if ((*data)->eta[smap->iPjc[ii]] > eta_hi)  {eta_hi = (*data)->eta[smap->iPjc[ii]];}
-        if ((*data)->bottom[smap->iPjc[ii]] > bot_hi)   {bot_hi = (*data)->bottom[smap->iPjc[ii]];}
-        (*data)->deptx[ii] = eta_hi - bot_hi;
+    for (ii = 0; ii < param->n2ci; ii++)    {update_face_depth(data, smap, param, ii);}
+    // boundary face depth
+    update_boundary_depth(data, smap, param);
+    // zero depth at outer boundaries
+    // To Be implemented, ZhiLi20200622
 
-        // y
-        eta_hi = (*data)->eta[ii];
-        bot_hi = (*data)->bottom[ii];
-        if ((*data)->eta[smap->icjP[ii]] > eta_hi)  {eta_hi = (*data)->eta[smap->icjP[ii]];}
-        if ((*data)->bottom[smap->icjP[ii]] > bot_hi)   {bot_hi = (*data)->bottom[smap->icjP[ii]];}
-        (*data)->depty[ii] = eta_hi - bot_hi;
+    // zero negative depth
+    for (ii = 0; ii < param->n2ct; ii++)
+    {
+        if ((*data)->deptx[ii] < 0)    {(*data)->deptx[ii] = 0.0;}
+        if ((*data)->depty[ii] < 0)    {(*data)->depty[ii] = 0.0;}
     }
-    // boundary face depth
+
+}
+
+// >>>>> Face depth at xp and yp of an internal cell <<<<<
+void update_face_depth(Data **data, Map *smap, Config *param, int ii)
+{
+    double eta_hi, bot_hi;
+    // x
+    eta_hi = (*data)->eta[ii];
+    bot_hi = (*data)->bottom[ii];
+    if ((*data)->eta[smap->iPjc[ii]] > eta_hi)  {eta_hi = (*data)->eta[smap->iPjc[ii]];}
+    if ((*data)->bottom[smap->iPjc[ii]] > bot_hi)   {bot_hi = (*data)->bottom[smap->iPjc[ii]];}
+    (*data)->deptx[ii] = eta_hi - bot_hi;
+
+    // y
+    eta_hi = (*data)->eta[ii];
+    bot_hi = (*data)->bottom[ii];
+    if ((*data)->eta[smap->icjP[ii]] > eta_hi)  {eta_hi = (*data)->eta[smap->icjP[ii]];}
+    if ((*data)->bottom[smap->icjP[ii]] > bot_hi)   {bot_hi = (*data)->bottom[smap->icjP[ii]];}
+    (*data)->depty[ii] = eta_hi - bot_hi;
+}
+
+// >>>>> Face depth at the ghost cells of the boundaries <<<<<
+void update_boundary_depth(Data **data, Map *smap, Config *param)
+{
+    int ii;
+    double eta_hi, bot_hi;
     for (ii = 0; ii < param->nx; ii++)
     {
         // ym
@@ -776,16 +809,6 @@ void update_depth(Data **data, Map *smap, Config *param, int irank)
         if ((*data)->bottom[smap->iPou[ii]] > bot_hi)   {bot_hi = (*data)->bottom[smap->iPou[ii]];}
         (*data)->deptx[smap->iPou[ii]] = eta_hi - bot_hi;
     }
-    // zero depth at outer boundaries
-    // To Be implemented, ZhiLi20200622
-
-    // zero negative depth
-    for (ii = 0; ii < param->n2ct; ii++)
-    {
-        if ((*data)->deptx[ii] < 0)    {(*data)->deptx[ii] = 0.0;}
-        if ((*data)->depty[ii] < 0)    {(*data)->depty[ii] = 0.0;}
-    }
-
 }
 
 
@@ -799,33 +822,15 @@ void ic_subsurface(Data **data, Map *gmap, Config *param, int irank, int nrank)
     (*data)->htop = param->htop;
     (*data)->hbot = param->hbot;
 
-    for (ii = 0; ii < param->n2ci; ii++)
-    {
-        (*data)->qtop[ii] = ((*data)->evap[ii] - (*data)->rain[0]) / param->wcs;
-    }
+    // soil classes and materials
+    init_soil(data, gmap, param, irank, nrank);
 
-    // initialize soil properties
-    for (ii = 0; ii < param->n3ct; ii++)
+    for (ii = 0; ii < param->n2ci; ii++)
     {
-        // homogeneous soil properties for now, Zhi Li 20200724
-        (*data)->vga[ii] = param->soil_a;
-        (*data)->vgn[ii] = param->soil_n;
-        (*data)->wcr[ii] = param->wcr;
-        (*data)->wcs[ii] = param->wcs;
-        (*data)->Ksx[ii] = param->Ksx;
-        (*data)->Ksy[ii] = param->Ksy;
-        (*data)->Ksz[ii] = param->Ksz;
-        // Maina heterogeneous problem
-        // if (gmap->kk[ii] > 600 & gmap->kk[ii] < 1200)
-        // if (gmap->kk[ii] > 120 & gmap->kk[ii] < 240)
-        // {
-        //     (*data)->vga[ii] = 1.04;
-        //     (*data)->vgn[ii] = 1.395;
-        //     (*data)->wcr[ii] = 0.106;
-        //     (*data)->wcs[ii] = 0.469;
-        //     (*data)->Ksz[ii] = 0.00000151;
-        // }
+        (*data)->qtop[ii] = ((*data)->evap[ii] - (*data)->rain[0]) / (*data)->wcs_top[ii];
     }
+    if (param->use_vg_table == 1)
+    {build_vg_table(&(*data)->vgt, (*data)->mat, (*data)->nsoil, param, irank);}
     // if init_wc within [wcr, wcs], initialize domain with init_wc
     if (param->init_wc >= param->wcr & param->init_wc <= param->wcs)
     {
@@ -872,7 +877,7 @@ void ic_subsurface(Data **data, Map *gmap, Config *param, int irank, int nrank)
                 zwt = (*data)->bottom[gmap->top2d[ii]] - param->init_wt_rel;
                 if (gmap->bot3d[ii] < zwt)
                 {
-                    (*data)->wc[ii] = param->wcs;
+                    (*data)->wc[ii] = (*data)->mat[(*data)->soil[ii]].wcs;
                     (*data)->h[ii] = zwt - gmap->bot3d[ii] - 0.5*gmap->dz3d[ii];
                 }
                 else
@@ -882,7 +887,7 @@ void ic_subsurface(Data **data, Map *gmap, Config *param, int irank, int nrank)
                     // (*data)->wc[ii] = param->wcr +
                         // (param->wcs-param->wcr)*((*data)->bottom[gmap->top2d[ii]]-gmap->bot3d[ii])/zwt + 0.01;
 
-                    (*data)->wc[ii] = param->wcr + 0.01;
+                    (*data)->wc[ii] = (*data)->mat[(*data)->soil[ii]].wcr + 0.01;
                     // (*data)->wc[ii] = 0.38;
                     (*data)->h[ii] = compute_hwc(*data, ii, param);
                 }
@@ -895,7 +900,7 @@ void ic_subsurface(Data **data, Map *gmap, Config *param, int irank, int nrank)
             {
                 if (gmap->bot3d[ii] < param->init_wt_abs)
                 {
-                    (*data)->wc[ii] = param->wcs;
+                    (*data)->wc[ii] = (*data)->mat[(*data)->soil[ii]].wcs;
                     (*data)->h[ii] = param->init_wt_abs - gmap->bot3d[ii] - 0.5*gmap->dz3d[ii];
                 }
                 else
@@ -935,9 +940,9 @@ void ic_subsurface(Data **data, Map *gmap, Config *param, int irank, int nrank)
         (*data)->wcn[ii] = (*data)->wc[ii];
         (*data)->wcp[ii] = (*data)->wc[ii];
         (*data)->wch[ii] = compute_wch(*data, ii, param);
-        (*data)->Kx[ii] = compute_K(*data, (*data)->Ksx, ii, param);
-        (*data)->Ky[ii] = compute_K(*data, (*data)->Ksy, ii, param);
-        (*data)->Kz[ii] = compute_K(*data, (*data)->Ksz, ii, param);
+        (*data)->Kx[ii] = compute_K(*data, 0, ii, param);
+        (*data)->Ky[ii] = compute_K(*data, 1, ii, param);
+        (*data)->Kz[ii] = compute_K(*data, 2, ii, param);
         (*data)->qx[ii] = 0.0;
         (*data)->qy[ii] = 0.0;
         (*data)->qz[ii] = 0.0;
@@ -1005,6 +1010,91 @@ void ic_subsurface(Data **data, Map *gmap, Config *param, int irank, int nrank)
     }
 }
 
+// >>>>> Soil classes and their materials <<<<<
+// Without soil_file every cell is class 0, the soil of the input file. With
+// soil_file = 1 the class of every cell is read from soil_class, laid out as
+// head_ic, and the n_soil materials from soil_table, one row per class:
+// vga, vgn, wcr, wcs, Ksx, Ksy, Ksz.
+void init_soil(Data **data, Map *gmap, Config *param, int irank, int nrank)
+{
+    int ii, kk;
+    char fullname[50];
+    double *row, *cls;
+    if (param->soil_file == 1)
+    {
+        (*data)->nsoil = param->n_soil;
+        if (param->n_soil < 1 | param->n_soil > MAX_SOIL)
+        {printf("ERROR: n_soil must be within 1 and %d!\n",MAX_SOIL);   mpi_abort(param);}
+        row = malloc(7*param->n_soil*sizeof(double));
+        strcpy(fullname, param->finput);
+        strcat(fullname, "soil_table");
+        load_data(row, fullname, 7*param->n_soil);
+        (*data)->mat = malloc(param->n_soil*sizeof(Material));
+        for (kk = 0; kk < param->n_soil; kk++)
+        {
+            (*data)->mat[kk].vga = row[7*kk];
+            (*data)->mat[kk].vgn = row[7*kk+1];
+            (*data)->mat[kk].wcr = row[7*kk+2];
+            (*data)->mat[kk].wcs = row[7*kk+3];
+            (*data)->mat[kk].Ks[0] = row[7*kk+4];
+            (*data)->mat[kk].Ks[1] = row[7*kk+5];
+            (*data)->mat[kk].Ks[2] = row[7*kk+6];
+        }
+        free(row);
+        cls = calloc(param->n3ct, sizeof(double));
+        restart_subsurface(cls, "soil_class", param, irank);
+        // every rank checks its own cells before any exchange
+        for (ii = 0; ii < param->n3ci; ii++)
+        {
+            kk = (int) cls[ii];
+            if (kk < 0 | kk >= param->n_soil)
+            {printf("ERROR: Soil class %d on rank %d is not in soil_table!\n",kk,irank);   mpi_abort(param);}
+        }
+        // ghost cells take the class of their interior neighbor
+        for (ii = 0; ii < param->ny*param->nz; ii++)
+        {
+            cls[gmap->iPou[ii]] = cls[gmap->iPin[ii]];
+            cls[gmap->iMou[ii]] = cls[gmap->iMin[ii]];
+        }
+        for (ii = 0; ii < param->nx*param->nz; ii++)
+        {
+            cls[gmap->jPou[ii]] = cls[gmap->jPin[ii]];
+            cls[gmap->jMou[ii]] = cls[gmap->jMin[ii]];
+        }
+        for (ii = 0; ii < param->nx*param->ny; ii++)
+        {
+            cls[gmap->kPou[ii]] = cls[gmap->kPin[ii]];
+            cls[gmap->kMou[ii]] = cls[gmap->kMin[ii]];
+        }
+        if (param->use_mpi == 1)
+        {mpi_exchange_subsurf(cls, gmap, 2, param, irank, nrank);}
+        for (ii = 0; ii < param->n3ct; ii++)    {(*data)->soil[ii] = (unsigned char) cls[ii];}
+        free(cls);
+    }
+    // homogeneous soil of the input file, the arena zeroed the classes
+    else
+    {
+        (*data)->nsoil = 1;
+        (*data)->mat = malloc(sizeof(Material));
+        (*data)->mat[0].vga = param->soil_a;
+        (*data)->mat[0].vgn = param->soil_n;
+        (*data)->mat[0].wcr = param->wcr;
+        (*data)->mat[0].wcs = param->wcs;
+        (*data)->mat[0].Ks[0] = param->Ksx;
+        (*data)->mat[0].Ks[1] = param->Ksy;
+        (*data)->mat[0].Ks[2] = param->Ksz;
+    }
+    // columns without a top cell on this rank exchange nothing
+    for (ii = 0; ii < param->n2ci; ii++)    {(*data)->wcs_top[ii] = param->wcs;}
+    for (ii = 0; ii < param->n3ci; ii++)
+    {
+        if (gmap->istop[ii] == 1)
+        {(*data)->wcs_top[gmap->top2d[ii]] = (*data)->mat[(*data)->soil[ii]].wcs;}
+    }
+    if (irank == 0)
+    {printf(" >>> %d soil classes assigned !\n",(*data)->nsoil);}
+}
+
 // >>>>> Read subsurface initial condition from file
 void restart_subsurface(double *ic_array, char *fname, Config *param, int irank)
 {
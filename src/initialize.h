@@ -1,6 +1,12 @@
 // Header file for initialize.c
+#include"arena.h"
+#include"vgtable.h"
 #include"map.h"
 #include"configuration.h"
+#include"linsys.h"
+#include"stencil.h"
+#include"multigrid.h"
+#include"parcg.h"
 
 #ifndef INITIALIZE_H
 #define INITIALIZE_H
@@ -19,17 +25,31 @@ typedef struct Data
     double *Fu, *Fv, *Ex, *Ey, *Dx, *Dy, *CDx, *CDy, *wtfx, *wtfy, *cflx, *cfly, *cfl_active;
     double *Vs, *Vsn, *Vflux, *Vsx, *Vsy, *Asx, *Asy, *Asz, *Aszx, *Aszy;
     // subsurface domain
-    double *h, *hn, *hp, *hwc, *wc, *wcn, *wcp, *wch, *h_root, *wc_root, *dh6, *rsplit;
+    double *h, *hn, *hp, *hwc, *wc, *wcn, *wcp, *wch, *h_root, *wc_root;
     double *vloss, *vloss_root, *room, *qtop, qbot, hbot, htop;
     double *Kx, *Ky, *Kz, *qx, *qy, *qz, *qx_root, *qy_root, *qz_root, *Vg, *Vgn, *Vgflux, *ch;
     double *h_out, *wc_out, *qx_out, *qy_out, *qz_out;
-    double *wcs, *wcr, *vga, *vgn, *Ksz, *Ksx, *Ksy;
+    // soil class of each cell, its material and tabulated relations
+    // wcs_top is the wcs of the top cell of each column, which converts the
+    // surface-subsurface exchange on both sides
+    int nsoil;
+    unsigned char *soil;
+    Material *mat;
+    double *wcs_top;
+    VGTable *vgt;
     double *t_out, *qbc;
     double *r_rho, *r_rhon, *r_visc;
     int *repeat;
     // linear system
     double *Sct, *Srhs, *Sxp, *Syp, *Sxm, *Sym;
     double *Gct, *Grhs, *Gxp, *Gxm, *Gyp, *Gym, *Gzp, *Gzm;
+    LinSys *Ssys, *Gsys;
+    Stencil *Sst;
+    Multigrid *Smg;
+    SolveLog *Slog, *Glog;
+    ParCG *Spcg, *Gpcg;
+    // single allocation of the fields above
+    Arena *arena;
     // boundary conditions
     int **tideloc, *tideloc_len, **inflowloc, *inflowloc_len;
     double **tide, **t_tide, *current_tide;
@@ -54,7 +74,10 @@ void ic_surface(Data **data, Map *smap, Map *gmap, Config *param, int irank, int
 void bc_surface(Data **data, Map *smap, Config *param, int irank);
 void get_BC_location(int **loc, int *loc_len, Config *param, int irank, int n_bc, int *locX, int *locY);
 void update_depth(Data **data, Map *smap, Config *param, int irank);
+void update_face_depth(Data **data, Map *smap, Config *param, int ii);
+void update_boundary_depth(Data **data, Map *smap, Config *param);
 void read_bathymetry(Data **data, Config *param, int irank, int nrank);
 void boundary_bath(Data **data, Map *smap, Config *param, int irank, int nrank);
 void ic_subsurface(Data **data, Map *gmap, Config *param, int irank, int nrank);
+void init_soil(Data **data, Map *gmap, Config *param, int irank, int nrank);
 void restart_subsurface(double *ic_array, char *fname, Config *param, int irank);
@@ -0,0 +1,473 @@
+// Persistent linear systems shared by the surface and subsurface solvers
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include<time.h>
+#include<omp.h>
+
+#include "linsys.h"
+
+#include "laspack/errhandl.h"
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+#include "laspack/precond.h"
+#include "laspack/rtc.h"
+#include "laspack/itersolv.h"
+
+void init_linsys(LinSys **sys, char *name, size_t dim);
+void linsys_pattern_done(LinSys *sys);
+void linsys_update_diag(LinSys *sys);
+void linsys_mixed(LinSys *sys, int mixed);
+void linsys_setup_precond(LinSys *sys);
+void linsys_solve(LinSys *sys, SolveLog *slog, int warm, double dt, double eps);
+static int linsys_cg(LinSys *sys, SolveLog *slog, double eps, int maxiter);
+static int linsys_refine(LinSys *sys, SolveLog *slog, double eps, int maxiter);
+static int linsys_laspack(LinSys *sys, SolveLog *slog, double eps, int maxiter);
+void linsys_apply(void *ctx, double *y, double *x);
+static void linsys_apply_t(void *ctx, double *y, double *x);
+void linsys_precond(void *ctx, double *y, double *c);
+static void linsys_ssor(LinSys *sys, double *y, double *c);
+void init_solvelog(SolveLog **slog);
+void warm_start(double *x, double *xprev, size_t n, int warm, SolveLog *slog, double dt);
+void log_solve(SolveLog *slog, int iter, double acc, double eps);
+void log_time(SolveLog *slog, double t0);
+static void record_res0(int iter, double rnorm, double bnorm, IterIdType id);
+
+// statistics of the LASPack solve in progress, filled by record_res0
+static SolveLog *active_log = NULL;
+
+// >>>>> Allocate matrix and vectors of a linear system <<<<<
+void init_linsys(LinSys **sys, char *name, size_t dim)
+{
+    *sys = malloc(sizeof(LinSys));
+    (*sys)->dim = dim;
+    Q_Constr(&(*sys)->A, name, dim, False, Rowws, Normal, True);
+    V_Constr(&(*sys)->b, "b", dim, Normal, True);
+    V_Constr(&(*sys)->x, "x", dim, Normal, True);
+    V_SetAllCmp(&(*sys)->x, 0.0);
+    (*sys)->xprev = calloc(dim, sizeof(double));
+    (*sys)->amg = NULL;
+    (*sys)->line = NULL;
+    (*sys)->single = NULL;
+    (*sys)->ilu = NULL;
+    (*sys)->color = NULL;
+    (*sys)->defl = NULL;
+    (*sys)->refine = 0;
+    // workspace of the CG iteration
+    (*sys)->r = malloc(dim*sizeof(double));
+    (*sys)->p = malloc(dim*sizeof(double));
+    (*sys)->q = malloc(dim*sizeof(double));
+    (*sys)->z = malloc(dim*sizeof(double));
+    (*sys)->acc = 0.0;
+    (*sys)->krylov = 0;
+    (*sys)->maxiter = 10000000;
+    (*sys)->omega = 1.0;
+}
+
+// >>>>> Finalize the sparsity pattern <<<<<
+// Entries must be set in ascending column order with a non-zero diagonal,
+// so sorting and the diagonal pointers are computed here only once.
+void linsys_pattern_done(LinSys *sys)
+{
+    Q_SortEl(&sys->A);
+    Q_AllocInvDiagEl(&sys->A);
+    if (LASResult() != LASOK)
+    {
+        printf("ERROR: Failed to build sparsity pattern of %s!\n", Q_GetName(&sys->A));
+        WriteLASErrDescr(stdout);
+    }
+}
+
+// >>>>> Refresh inverse diagonal after values are updated in place <<<<<
+void linsys_update_diag(LinSys *sys)
+{
+    size_t ii;
+    QMatrix *A = &sys->A;
+    for (ii = 1; ii <= sys->dim; ii++)  {A->InvDiagEl[ii] = 1.0 / A->DiagEl[ii]->Val;}
+    // incomplete factorization belongs to the old values
+    *A->ILUExists = False;
+}
+
+// >>>>> Select the precision of the SSOR preconditioner <<<<<
+// mixed = 0 : double precision
+// mixed = 1 : single precision SSOR inside the double precision CG
+// mixed = 2 : iterative refinement in double precision around a single
+//             precision CG
+// The pattern must be final.
+void linsys_mixed(LinSys *sys, int mixed)
+{
+    if (mixed == 0) {return;}
+    init_mixed(&sys->single, &sys->A);
+    if (mixed == 2) {sys->refine = 1;}
+}
+
+// >>>>> Bring the attached preconditioners up to the current values <<<<<
+void linsys_setup_precond(LinSys *sys)
+{
+    if (sys->single != NULL)    {mixed_update(sys->single, &sys->A);}
+    if (sys->ilu != NULL)   {ilu_update(sys->ilu, &sys->A);}
+    if (sys->line != NULL)  {zline_factor(sys->line, &sys->A);}
+    if (sys->amg != NULL)   {amg_update(sys->amg, &sys->A);}
+}
+
+// >>>>> Preconditioned Krylov solve of a persistent system <<<<<
+// On entry x still holds the solution of the previous call. The system is
+// preconditioned by its multigrid hierarchy if one is attached, else by its
+// line solve if one is attached, else by SSOR. krylov = 0 is the CG of this
+// file, krylov = 5 the same CG deflated by a recycled subspace, the other
+// methods are taken from LASPack.
+void linsys_solve(LinSys *sys, SolveLog *slog, int warm, double dt, double eps)
+{
+    int iter;
+    double t0;
+    warm_start(sys->x.Cmp+1, sys->xprev, sys->dim, warm, slog, dt);
+    t0 = omp_get_wtime();
+    linsys_setup_precond(sys);
+    slog->setup = omp_get_wtime() - t0;
+    if (sys->refine == 1)   {iter = linsys_refine(sys, slog, eps, sys->maxiter);}
+    else if (sys->krylov == 0 | sys->krylov == 5)   {iter = linsys_cg(sys, slog, eps, sys->maxiter);}
+    else    {iter = linsys_laspack(sys, slog, eps, sys->maxiter);}
+    log_solve(slog, iter, sys->acc, eps);
+}
+
+// >>>>> Solve with a LASPack iteration <<<<<
+// krylov = 1 : BiCGSTAB
+// krylov = 2 : GMRES restarted after 20 steps
+// krylov = 3 : CG
+static int linsys_laspack(LinSys *sys, SolveLog *slog, double eps, int maxiter)
+{
+    PrecondProcType precond = SSORPrecond;
+    if (sys->amg != NULL)
+    {
+        amg_activate(sys->amg);
+        precond = AMGPrecond;
+    }
+    else if (sys->ilu != NULL)
+    {
+        ilu_activate(sys->ilu);
+        precond = ILU0Precond;
+    }
+    else if (sys->line != NULL)
+    {
+        zline_activate(sys->line);
+        precond = ZLinePrecond;
+    }
+    else if (sys->color != NULL)
+    {
+        mcssor_activate(sys->color);
+        precond = MCSSORPrecond;
+    }
+    active_log = slog;
+    SetRTCAuxProc(record_res0);
+    SetRTCAccuracy(eps);
+    if (sys->krylov == 1)   {BiCGSTABIter(&sys->A, &sys->x, &sys->b, maxiter, precond, sys->omega);}
+    else if (sys->krylov == 2)
+    {
+        SetGMRESRestart(20);
+        GMRESIter(&sys->A, &sys->x, &sys->b, maxiter, precond, sys->omega);
+    }
+    else    {CGIter(&sys->A, &sys->x, &sys->b, maxiter, precond, sys->omega);}
+    SetRTCAuxProc(NULL);
+    active_log = NULL;
+    if (LASResult() != LASOK)
+    {
+        printf("ERROR: LASPack solve of %s failed!\n", Q_GetName(&sys->A));
+        WriteLASErrDescr(stdout);
+    }
+    sys->acc = GetLastAccuracy();
+    return GetLastNoIter();
+}
+
+// >>>>> Preconditioned CG on the workspace of the system <<<<<
+// Stops when |r| < eps*|b| as LASPack CGIter does, but allocates no
+// temporary vectors and fuses the vector updates with the dot products.
+// Every iteration makes one pass for q = A*p together with (p,q), one for
+// the updates of x and r together with (r,r), one for (r,z) and one for p.
+static int linsys_cg(LinSys *sys, SolveLog *slog, double eps, int maxiter)
+{
+    int iter = 0;
+    size_t ii, kk, n = sys->dim;
+    double alpha, beta, rho, rho_old = 1.0, pq, bnorm, rnorm, sum;
+    double *x = sys->x.Cmp+1, *b = sys->b.Cmp+1;
+    double *r = sys->r, *p = sys->p, *q = sys->q, *z = sys->z;
+    ElType *row;
+
+    // r = b - A*x, with |b| and |r| in the same pass
+    bnorm = 0.0;
+    rnorm = 0.0;
+    for (ii = 0; ii < n; ii++)
+    {
+        row = sys->A.El[ii+1];
+        sum = b[ii];
+        for (kk = 0; kk < sys->A.Len[ii+1]; kk++)   {sum -= row[kk].Val * x[row[kk].Pos-1];}
+        r[ii] = sum;
+        bnorm += b[ii] * b[ii];
+        rnorm += sum * sum;
+    }
+    bnorm = sqrt(bnorm);
+    rnorm = sqrt(rnorm);
+    if (bnorm > 0.0)    {slog->res0 = rnorm / bnorm;}
+    else
+    {
+        // zero right hand side has the trivial solution
+        for (ii = 0; ii < n; ii++)  {x[ii] = 0.0;}
+        slog->res0 = 0.0;
+        rnorm = 0.0;
+    }
+    // deflation by the subspace recycled from the previous solves
+    if (sys->defl != NULL && bnorm > 0.0)
+    {
+        deflate_setup(sys->defl, linsys_apply, linsys_apply_t, sys);
+        deflate_start(sys->defl, x, r);
+        rnorm = 0.0;
+        for (ii = 0; ii < n; ii++)  {rnorm += r[ii] * r[ii];}
+        rnorm = sqrt(rnorm);
+    }
+    while (rnorm >= eps * bnorm && bnorm > 0.0 && iter < maxiter)
+    {
+        iter++;
+        linsys_precond(sys, z, r);
+        rho = 0.0;
+        for (ii = 0; ii < n; ii++)  {rho += r[ii] * z[ii];}
+        if (iter == 1)
+        {for (ii = 0; ii < n; ii++)    {p[ii] = z[ii];}}
+        else
+        {
+            beta = rho / rho_old;
+            for (ii = 0; ii < n; ii++)  {p[ii] = z[ii] + beta * p[ii];}
+        }
+        if (sys->defl != NULL)  {deflate_direction(sys->defl, p);}
+        // q = A*p and (p,q)
+        pq = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            row = sys->A.El[ii+1];
+            sum = 0.0;
+            for (kk = 0; kk < sys->A.Len[ii+1]; kk++)   {sum += row[kk].Val * p[row[kk].Pos-1];}
+            q[ii] = sum;
+            pq += p[ii] * sum;
+        }
+        if (sys->defl != NULL)  {deflate_store(sys->defl, p, q);}
+        alpha = rho / pq;
+        rho_old = rho;
+        // x += alpha*p, r -= alpha*q and (r,r)
+        rnorm = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            x[ii] += alpha * p[ii];
+            r[ii] -= alpha * q[ii];
+            rnorm += r[ii] * r[ii];
+        }
+        rnorm = sqrt(rnorm);
+    }
+    if (bnorm > 0.0)    {sys->acc = rnorm / bnorm;}
+    else    {sys->acc = 0.0;}
+    // a short solve has too few directions to improve the subspace
+    if (sys->defl != NULL && iter >= sys->defl->m)  {deflate_update(sys->defl);}
+    return iter;
+}
+
+// >>>>> Iterative refinement around the single precision CG <<<<<
+// The residual and the solution are kept in double precision, every
+// correction is solved in single precision to the relative accuracy
+// MIXED_INNER. If a correction fails to reduce the residual, the double
+// precision CG finishes the solve.
+static int linsys_refine(LinSys *sys, SolveLog *slog, double eps, int maxiter)
+{
+    int iter = 0, nouter = 0;
+    size_t ii, kk, n = sys->dim;
+    double bnorm = 0.0, rnorm, rnorm_old = 0.0, sum;
+    double *x = sys->x.Cmp+1, *b = sys->b.Cmp+1;
+    Mixed *mx = sys->single;
+    ElType *row;
+    for (ii = 0; ii < n; ii++)  {bnorm += b[ii] * b[ii];}
+    bnorm = sqrt(bnorm);
+    while (1)
+    {
+        // r = b - A*x in double precision, handed to the inner solve as float
+        rnorm = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            row = sys->A.El[ii+1];
+            sum = b[ii];
+            for (kk = 0; kk < sys->A.Len[ii+1]; kk++)   {sum -= row[kk].Val * x[row[kk].Pos-1];}
+            mx->b[ii] = (float) sum;
+            rnorm += sum * sum;
+        }
+        rnorm = sqrt(rnorm);
+        if (nouter == 0)
+        {
+            if (bnorm > 0.0)    {slog->res0 = rnorm / bnorm;}
+            else    {slog->res0 = 0.0;}
+        }
+        if (!(rnorm >= eps * bnorm && bnorm > 0.0 && iter < maxiter))   {break;}
+        if (nouter > 0 && !(rnorm <= 0.5 * rnorm_old))
+        {
+            // stagnation at the single precision limit of the operator
+            iter += linsys_cg(sys, slog, eps, maxiter - iter);
+            return iter;
+        }
+        iter += mixed_cg(mx, sys->omega, MIXED_INNER, maxiter - iter);
+        for (ii = 0; ii < n; ii++)  {x[ii] += mx->x[ii];}
+        rnorm_old = rnorm;
+        nouter++;
+    }
+    if (bnorm > 0.0)    {sys->acc = rnorm / bnorm;}
+    else
+    {
+        for (ii = 0; ii < n; ii++)  {x[ii] = 0.0;}
+        sys->acc = 0.0;
+    }
+    return iter;
+}
+
+// >>>>> y = A * x on plain arrays, for the Krylov solvers outside LASPack <<<<<
+void linsys_apply(void *ctx, double *y, double *x)
+{
+    size_t ii, kk;
+    double sum;
+    LinSys *sys = ctx;
+    ElType *row;
+    for (ii = 1; ii <= sys->dim; ii++)
+    {
+        row = sys->A.El[ii];
+        sum = 0.0;
+        for (kk = 0; kk < sys->A.Len[ii]; kk++) {sum += row[kk].Val * x[row[kk].Pos-1];}
+        y[ii-1] = sum;
+    }
+}
+
+// >>>>> y = A' * x on plain arrays <<<<<
+static void linsys_apply_t(void *ctx, double *y, double *x)
+{
+    size_t ii, kk;
+    LinSys *sys = ctx;
+    ElType *row;
+    for (ii = 0; ii < sys->dim; ii++)   {y[ii] = 0.0;}
+    for (ii = 1; ii <= sys->dim; ii++)
+    {
+        row = sys->A.El[ii];
+        for (kk = 0; kk < sys->A.Len[ii]; kk++) {y[row[kk].Pos-1] += row[kk].Val * x[ii-1];}
+    }
+}
+
+// >>>>> Preconditioner on plain arrays, multigrid or line solve if attached, else SSOR <<<<<
+void linsys_precond(void *ctx, double *y, double *c)
+{
+    LinSys *sys = ctx;
+    if (sys->amg != NULL)   {amg_cycle(sys->amg, y, c);}
+    else if (sys->ilu != NULL)  {ilu_solve(sys->ilu, y, c);}
+    else if (sys->line != NULL) {zline_solve(sys->line, y, c);}
+    else if (sys->color != NULL)    {mcssor_apply(sys->color, &sys->A, sys->omega, y, c);}
+    else if (sys->single != NULL)   {mixed_precond(sys->single, sys->omega, y, c);}
+    else    {linsys_ssor(sys, y, c);}
+}
+
+// >>>>> SSOR with relaxation omega, the same operator as LASPack SSORPrecond <<<<<
+static void linsys_ssor(LinSys *sys, double *y, double *c)
+{
+    size_t ii, kk;
+    double sum, omega = sys->omega;
+    ElType *row;
+    // forward sweep, (D/omega + L) t = c
+    for (ii = 1; ii <= sys->dim; ii++)
+    {
+        row = sys->A.El[ii];
+        sum = c[ii-1];
+        for (kk = 0; kk < sys->A.Len[ii] && row[kk].Pos < ii; kk++)  {sum -= row[kk].Val * y[row[kk].Pos-1];}
+        y[ii-1] = omega * sum * sys->A.InvDiagEl[ii];
+    }
+    // backward sweep, (D/omega + U) y = D t
+    for (ii = sys->dim; ii >= 1; ii--)
+    {
+        row = sys->A.El[ii];
+        sum = 0.0;
+        for (kk = sys->A.Len[ii]; kk-- > 0 && row[kk].Pos > ii; )   {sum -= row[kk].Val * y[row[kk].Pos-1];}
+        y[ii-1] = omega * (y[ii-1] + sum * sys->A.InvDiagEl[ii]);
+    }
+    if (omega != 1.0)
+    {for (ii = 0; ii < sys->dim; ii++)  {y[ii] *= (2.0 - omega) / omega;}}
+}
+
+// >>>>> Relative residual of the initial guess, called by LASPack RTC <<<<<
+static void record_res0(int iter, double rnorm, double bnorm, IterIdType id)
+{
+    if (iter == 0 && active_log != NULL)
+    {
+        if (bnorm > 0.0)    {active_log->res0 = rnorm / bnorm;}
+        else    {active_log->res0 = 0.0;}
+    }
+}
+
+// >>>>> Allocate solver statistics <<<<<
+void init_solvelog(SolveLog **slog)
+{
+    *slog = malloc(sizeof(SolveLog));
+    (*slog)->nsolve = 0;
+    (*slog)->nwarm = 0;
+    (*slog)->dt = 0.0;
+    (*slog)->iter = 0.0;
+    (*slog)->saved = 0.0;
+    (*slog)->res0 = 1.0;
+    (*slog)->rate = 0.0;
+    (*slog)->time = 0.0;
+    (*slog)->last = 0;
+    (*slog)->acc = 0.0;
+    (*slog)->setup = 0.0;
+    (*slog)->solve = 0.0;
+}
+
+// >>>>> Initial guess of a Krylov solve <<<<<
+// x holds the latest solution on entry, xprev the one before it.
+// warm = 0 : start from zero
+// warm = 1 : start from the latest solution
+// warm = 2 : linear extrapolation from the latest two solutions
+// The extrapolation is scaled by dt / slog->dt, the ratio of the coming step
+// to the step between the two solutions. slog->nwarm counts the solves since
+// the history was last reset; set it to 0 when x is not the end of the
+// previous step, e.g. when a rejected step is repeated.
+void warm_start(double *x, double *xprev, size_t n, int warm, SolveLog *slog, double dt)
+{
+    size_t ii;
+    double xi, ratio = 1.0;
+    if (slog->dt > 0.0) {ratio = dt / slog->dt;}
+    if (warm == 0)
+    {for (ii = 0; ii < n; ii++)    {x[ii] = 0.0;}}
+    else if (warm == 2 & slog->nwarm >= 2)
+    {
+        for (ii = 0; ii < n; ii++)
+        {
+            xi = x[ii];
+            x[ii] = xi + ratio * (xi - xprev[ii]);
+            xprev[ii] = xi;
+        }
+    }
+    else if (warm == 2)
+    {for (ii = 0; ii < n; ii++)    {xprev[ii] = x[ii];}}
+    slog->nwarm += 1;
+    slog->dt = dt;
+}
+
+// >>>>> Accumulate iteration counts of one solve <<<<<
+// CG reduces the residual at a nearly constant rate, so a solve started
+// from zero would have needed about log(eps)/rate iterations. The difference
+// to the actual count is booked as saved by the initial guess.
+void log_solve(SolveLog *slog, int iter, double acc, double eps)
+{
+    slog->nsolve += 1;
+    slog->iter += iter;
+    slog->last = iter;
+    slog->acc = acc;
+    if (iter > 0 & acc > 0.0 & acc < slog->res0)
+    {slog->rate = log(acc / slog->res0) / iter;}
+    if (slog->res0 < 1.0 & slog->rate < 0.0)
+    {slog->saved += ceil(log(eps) / slog->rate) - iter;}
+}
+
+// >>>>> Time of the solve started at t0, the setup is already recorded <<<<<
+void log_time(SolveLog *slog, double t0)
+{
+    double elapsed = omp_get_wtime() - t0;
+    slog->solve = elapsed - slog->setup;
+    slog->time += elapsed;
+}
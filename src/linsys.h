@@ -0,0 +1,64 @@
+// Header file for linsys.c
+#include<time.h>
+#include "laspack/errhandl.h"
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+#include "laspack/rtc.h"
+
+#include "amg.h"
+#include "deflate.h"
+#include "ilu.h"
+#include "mcssor.h"
+#include "mixed.h"
+#include "zline.h"
+
+#ifndef LINSYS_H
+#define LINSYS_H
+
+// relative accuracy of the single precision solves of an iterative refinement
+#define MIXED_INNER 0.0001
+
+// persistent linear system, allocated once and refilled every time step
+// r, p, q and z are the workspace of the CG iteration, acc its last accuracy.
+// krylov selects the method, omega is the SSOR relaxation. If single is set,
+// SSOR runs in single precision, and refine = 1 solves by iterative
+// refinement around the single precision CG.
+typedef struct LinSys
+{
+    size_t dim;
+    QMatrix A;
+    Vector b, x;
+    double *xprev, *r, *p, *q, *z, acc;
+    int krylov, maxiter, refine;
+    double omega;
+    Mixed *single;
+    Ilu *ilu;
+    McSsor *color;
+    Deflate *defl;
+    Amg *amg;
+    ZLine *line;
+}LinSys;
+
+// iteration statistics accumulated over all solves of one system
+// last, res0, acc, setup and solve describe the most recent solve, setup is
+// the time of the preconditioner setup and solve the time of the rest.
+typedef struct SolveLog
+{
+    int nsolve, last, nwarm;
+    double iter, saved, res0, rate, time, acc, setup, solve, dt;
+}SolveLog;
+
+#endif
+
+void init_linsys(LinSys **sys, char *name, size_t dim);
+void linsys_pattern_done(LinSys *sys);
+void linsys_update_diag(LinSys *sys);
+void linsys_mixed(LinSys *sys, int mixed);
+void linsys_setup_precond(LinSys *sys);
+void linsys_solve(LinSys *sys, SolveLog *slog, int warm, double dt, double eps);
+void linsys_apply(void *ctx, double *y, double *x);
+void linsys_precond(void *ctx, double *y, double *c);
+void init_solvelog(SolveLog **slog);
+void warm_start(double *x, double *xprev, size_t n, int warm, SolveLog *slog, double dt);
+void log_solve(SolveLog *slog, int iter, double acc, double eps);
+void log_time(SolveLog *slog, double t0);
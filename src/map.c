@@ -291,6 +291,20 @@ void build_subsurf_map(Map **map, Map *smap, double *bath, double *offset, Confi
         (*map)->zcntr[ii] = (*map)->bot3d[ii] + 0.5*(*map)->dz3d[ii] - offset[0];
         if ((*map)->actv[ii] == 1)  {(*map)->nactv += 1;}
     }
+    // compacted numbering of the active cells, which keeps the column order
+    (*map)->actv_row = malloc(param->n3ci*sizeof(int));
+    (*map)->actv_cell = malloc((*map)->nactv*sizeof(int));
+    jj = 0;
+    for (ii = 0; ii < param->n3ci; ii++)
+    {
+        if ((*map)->actv[ii] == 1)
+        {
+            (*map)->actv_row[ii] = jj;
+            (*map)->actv_cell[jj] = ii;
+            jj += 1;
+        }
+        else    {(*map)->actv_row[ii] = -1;}
+    }
 
     // calculate iP, iM, jP, jM, kP, kM maps
     (*map)->iPjckc = malloc(param->n3ci*sizeof(int));
@@ -0,0 +1,123 @@
+// Multicolor SSOR preconditioner for the surface and subsurface systems
+// The SSOR sweeps in the natural order are sequential over the rows. If the
+// rows are swept color by color instead, the rows of one color are not
+// coupled and are updated in parallel. This is SSOR of the matrix in
+// multicolor order, a different preconditioner than the natural ordering,
+// usually somewhat weaker per iteration.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include "mcssor.h"
+
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+void init_mcssor(McSsor **mc, QMatrix *A);
+void mcssor_apply(McSsor *mc, QMatrix *A, double omega, double *y, double *c);
+void mcssor_activate(McSsor *mc);
+Vector *MCSSORPrecond(QMatrix *A, Vector *y, Vector *c, double omega);
+
+// ordering used by MCSSORPrecond, LASPack passes no context to preconditioners
+static McSsor *active_mcssor = NULL;
+
+// >>>>> Greedy coloring of the final pattern of A <<<<<
+// Every row takes the smallest color not used by its coupled rows of lower
+// index. On the 5-point and 7-point stencils in natural order this gives the
+// red-black ordering.
+void init_mcssor(McSsor **mc, QMatrix *A)
+{
+    int cc, *used;
+    size_t ii, kk, n = Q_GetDim(A), maxlen = 0;
+    *mc = malloc(sizeof(McSsor));
+    (*mc)->n = n;
+    (*mc)->color = malloc(n*sizeof(int));
+    for (ii = 1; ii <= n; ii++) {if (A->Len[ii] > maxlen) {maxlen = A->Len[ii];}}
+    used = malloc((maxlen+1)*sizeof(int));
+    (*mc)->ncolor = 0;
+    for (ii = 0; ii < n; ii++)
+    {
+        for (kk = 0; kk <= maxlen; kk++)    {used[kk] = 0;}
+        for (kk = 0; kk < A->Len[ii+1]; kk++)
+        {
+            if (A->El[ii+1][kk].Pos < ii+1) {used[(*mc)->color[A->El[ii+1][kk].Pos-1]] = 1;}
+        }
+        cc = 0;
+        while (used[cc] == 1)   {cc++;}
+        (*mc)->color[ii] = cc;
+        if (cc+1 > (*mc)->ncolor)   {(*mc)->ncolor = cc+1;}
+    }
+    free(used);
+    // rows grouped by color
+    (*mc)->start = calloc((*mc)->ncolor+1, sizeof(size_t));
+    (*mc)->row = malloc(n*sizeof(size_t));
+    for (ii = 0; ii < n; ii++)  {(*mc)->start[(*mc)->color[ii]+1] += 1;}
+    for (cc = 0; cc < (*mc)->ncolor; cc++)  {(*mc)->start[cc+1] += (*mc)->start[cc];}
+    for (ii = 0; ii < n; ii++)
+    {
+        cc = (*mc)->color[ii];
+        (*mc)->row[(*mc)->start[cc]] = ii;
+        (*mc)->start[cc] += 1;
+    }
+    for (cc = (*mc)->ncolor; cc > 0; cc--)  {(*mc)->start[cc] = (*mc)->start[cc-1];}
+    (*mc)->start[0] = 0;
+}
+
+// >>>>> SSOR with relaxation omega in multicolor order, y = M^(-1) * c <<<<<
+// Works in place. The couplings to lower colors form L, to higher colors U.
+void mcssor_apply(McSsor *mc, QMatrix *A, double omega, double *y, double *c)
+{
+    int cc;
+    long jj;
+    size_t ii, kk;
+    double sum;
+    ElType *row;
+    // forward sweep, (D/omega + L) t = c
+    for (cc = 0; cc < mc->ncolor; cc++)
+    {
+        #pragma omp parallel for private(ii, kk, sum, row)
+        for (jj = (long)mc->start[cc]; jj < (long)mc->start[cc+1]; jj++)
+        {
+            ii = mc->row[jj];
+            row = A->El[ii+1];
+            sum = c[ii];
+            // the first color has no lower couplings
+            for (kk = 0; kk < A->Len[ii+1] && cc > 0; kk++)
+            {if (mc->color[row[kk].Pos-1] < cc)   {sum -= row[kk].Val * y[row[kk].Pos-1];}}
+            y[ii] = omega * sum * A->InvDiagEl[ii+1];
+        }
+    }
+    // backward sweep, (D/omega + U) y = D t
+    for (cc = mc->ncolor-1; cc >= 0; cc--)
+    {
+        #pragma omp parallel for private(ii, kk, sum, row)
+        for (jj = (long)mc->start[cc]; jj < (long)mc->start[cc+1]; jj++)
+        {
+            ii = mc->row[jj];
+            row = A->El[ii+1];
+            sum = 0.0;
+            for (kk = 0; kk < A->Len[ii+1] && cc < mc->ncolor-1; kk++)
+            {if (mc->color[row[kk].Pos-1] > cc)   {sum -= row[kk].Val * y[row[kk].Pos-1];}}
+            y[ii] = omega * (y[ii] + sum * A->InvDiagEl[ii+1]);
+        }
+    }
+    if (omega != 1.0)
+    {for (ii = 0; ii < mc->n; ii++)    {y[ii] *= (2.0 - omega) / omega;}}
+}
+
+// >>>>> Select the ordering applied by MCSSORPrecond <<<<<
+void mcssor_activate(McSsor *mc)
+{
+    active_mcssor = mc;
+}
+
+// >>>>> LASPack preconditioner interface <<<<<
+Vector *MCSSORPrecond(QMatrix *A, Vector *y, Vector *c, double omega)
+{
+    size_t ii;
+    mcssor_apply(active_mcssor, A, omega, y->Cmp+1, c->Cmp+1);
+    // the solve is linear, a pending multiplier of c carries over to y
+    for (ii = 1; ii <= y->Dim; ii++)    {y->Cmp[ii] *= c->Multipl;}
+    y->Multipl = 1.0;
+    return y;
+}
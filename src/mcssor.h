@@ -0,0 +1,22 @@
+// Header file for mcssor.c
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+#ifndef MCSSOR_H
+#define MCSSOR_H
+
+// multicolor ordering of the rows of a LASPack matrix
+// No two coupled rows share a color, rows start[cc] to start[cc+1]-1 of the
+// list row have color cc. The 5-point and 7-point stencils take two colors.
+typedef struct McSsor
+{
+    int ncolor, *color;
+    size_t n, *start, *row;
+}McSsor;
+
+#endif
+
+void init_mcssor(McSsor **mc, QMatrix *A);
+void mcssor_apply(McSsor *mc, QMatrix *A, double omega, double *y, double *c);
+void mcssor_activate(McSsor *mc);
+Vector *MCSSORPrecond(QMatrix *A, Vector *y, Vector *c, double omega);
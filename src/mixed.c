@@ -0,0 +1,157 @@
+// Single precision matrix and SSOR for the mixed precision solves
+// SSOR and the matrix-vector product are bound by memory bandwidth, so a
+// float copy of the matrix with 32 bit column indices halves their cost.
+// It is used as the preconditioner of the double precision CG, or as the
+// inner solver of an iterative refinement in double precision.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include "mixed.h"
+
+#include "laspack/qmatrix.h"
+
+void init_mixed(Mixed **mx, QMatrix *A);
+void mixed_update(Mixed *mx, QMatrix *A);
+void mixed_ssor(Mixed *mx, double omega, float *y, float *c);
+void mixed_precond(Mixed *mx, double omega, double *y, double *c);
+int mixed_cg(Mixed *mx, double omega, double eps, int maxiter);
+
+// >>>>> Set up the compressed rows on the final pattern of A <<<<<
+void init_mixed(Mixed **mx, QMatrix *A)
+{
+    size_t ii, kk, nnz, n = Q_GetDim(A);
+    *mx = malloc(sizeof(Mixed));
+    (*mx)->n = n;
+    (*mx)->ia = malloc((n+1)*sizeof(size_t));
+    (*mx)->iu = malloc(n*sizeof(size_t));
+    (*mx)->ia[0] = 0;
+    for (ii = 0; ii < n; ii++)  {(*mx)->ia[ii+1] = (*mx)->ia[ii] + A->Len[ii+1] - 1;}
+    nnz = (*mx)->ia[n];
+    (*mx)->ja = malloc(nnz*sizeof(int));
+    for (ii = 0; ii < n; ii++)
+    {
+        nnz = (*mx)->ia[ii];
+        (*mx)->iu[ii] = (*mx)->ia[ii];
+        for (kk = 0; kk < A->Len[ii+1]; kk++)
+        {
+            if (A->El[ii+1][kk].Pos == ii+1)    {continue;}
+            (*mx)->ja[nnz] = A->El[ii+1][kk].Pos - 1;
+            if (A->El[ii+1][kk].Pos < ii+1) {(*mx)->iu[ii] = nnz + 1;}
+            nnz++;
+        }
+    }
+    (*mx)->a = malloc((*mx)->ia[n]*sizeof(float));
+    (*mx)->diag = malloc(n*sizeof(float));
+    (*mx)->invd = malloc(n*sizeof(float));
+    (*mx)->x = malloc(n*sizeof(float));
+    (*mx)->b = malloc(n*sizeof(float));
+    (*mx)->r = malloc(n*sizeof(float));
+    (*mx)->p = malloc(n*sizeof(float));
+    (*mx)->q = malloc(n*sizeof(float));
+    (*mx)->z = malloc(n*sizeof(float));
+}
+
+// >>>>> Round the current values of A to single precision <<<<<
+void mixed_update(Mixed *mx, QMatrix *A)
+{
+    size_t ii, kk, nnz;
+    for (ii = 0; ii < mx->n; ii++)
+    {
+        nnz = mx->ia[ii];
+        for (kk = 0; kk < A->Len[ii+1]; kk++)
+        {
+            if (A->El[ii+1][kk].Pos == ii+1)    {continue;}
+            mx->a[nnz] = (float) A->El[ii+1][kk].Val;
+            nnz++;
+        }
+        mx->diag[ii] = (float) A->DiagEl[ii+1]->Val;
+        mx->invd[ii] = (float) (1.0 / A->DiagEl[ii+1]->Val);
+    }
+}
+
+// >>>>> SSOR with relaxation omega in single precision, y = M^(-1) * c <<<<<
+// The same operator as LASPack SSORPrecond, works in place.
+void mixed_ssor(Mixed *mx, double omega, float *y, float *c)
+{
+    size_t ii, kk;
+    float sum, w = (float) omega;
+    // forward sweep, (D/omega + L) t = c
+    for (ii = 0; ii < mx->n; ii++)
+    {
+        sum = c[ii];
+        for (kk = mx->ia[ii]; kk < mx->iu[ii]; kk++)    {sum -= mx->a[kk] * y[mx->ja[kk]];}
+        y[ii] = w * sum * mx->invd[ii];
+    }
+    // backward sweep, (D/omega + U) y = D t
+    for (ii = mx->n; ii-- > 0; )
+    {
+        sum = 0.0;
+        for (kk = mx->iu[ii]; kk < mx->ia[ii+1]; kk++)  {sum -= mx->a[kk] * y[mx->ja[kk]];}
+        y[ii] = w * (y[ii] + sum * mx->invd[ii]);
+    }
+    if (omega != 1.0)
+    {for (ii = 0; ii < mx->n; ii++)    {y[ii] *= (2.0 - w) / w;}}
+}
+
+// >>>>> Single precision SSOR on double vectors <<<<<
+void mixed_precond(Mixed *mx, double omega, double *y, double *c)
+{
+    size_t ii;
+    for (ii = 0; ii < mx->n; ii++)  {mx->r[ii] = (float) c[ii];}
+    mixed_ssor(mx, omega, mx->z, mx->r);
+    for (ii = 0; ii < mx->n; ii++)  {y[ii] = mx->z[ii];}
+}
+
+// >>>>> SSOR preconditioned CG in single precision, x = A^(-1) * b <<<<<
+// Solves for mx->x from zero with the right hand side mx->b. The vectors
+// are float, the dot products are summed in double.
+int mixed_cg(Mixed *mx, double omega, double eps, int maxiter)
+{
+    int iter = 0;
+    size_t ii, kk, n = mx->n;
+    float sum, *x = mx->x, *b = mx->b, *r = mx->r, *p = mx->p, *q = mx->q, *z = mx->z;
+    double alpha, beta, rho, rho_old = 1.0, pq, bnorm = 0.0, rnorm;
+    for (ii = 0; ii < n; ii++)
+    {
+        x[ii] = 0.0;
+        r[ii] = b[ii];
+        bnorm += (double) b[ii] * b[ii];
+    }
+    bnorm = sqrt(bnorm);
+    rnorm = bnorm;
+    while (rnorm >= eps * bnorm && bnorm > 0.0 && iter < maxiter)
+    {
+        iter++;
+        mixed_ssor(mx, omega, z, r);
+        rho = 0.0;
+        for (ii = 0; ii < n; ii++)  {rho += (double) r[ii] * z[ii];}
+        if (iter == 1)
+        {for (ii = 0; ii < n; ii++)    {p[ii] = z[ii];}}
+        else
+        {
+            beta = rho / rho_old;
+            for (ii = 0; ii < n; ii++)  {p[ii] = z[ii] + (float) beta * p[ii];}
+        }
+        // q = A*p and (p,q)
+        pq = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            sum = mx->diag[ii] * p[ii];
+            for (kk = mx->ia[ii]; kk < mx->ia[ii+1]; kk++)  {sum += mx->a[kk] * p[mx->ja[kk]];}
+            q[ii] = sum;
+            pq += (double) p[ii] * sum;
+        }
+        alpha = rho / pq;
+        rho_old = rho;
+        rnorm = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            x[ii] += (float) alpha * p[ii];
+            r[ii] -= (float) alpha * q[ii];
+            rnorm += (double) r[ii] * r[ii];
+        }
+        rnorm = sqrt(rnorm);
+    }
+    return iter;
+}
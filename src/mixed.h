@@ -0,0 +1,25 @@
+// Header file for mixed.c
+#include "laspack/qmatrix.h"
+
+#ifndef MIXED_H
+#define MIXED_H
+
+// single precision copy of a LASPack matrix
+// Off-diagonal entries are kept in compressed rows with 32 bit columns,
+// iu is the first entry right of the diagonal. An entry takes 8 bytes
+// instead of the 16 bytes of a LASPack element.
+typedef struct Mixed
+{
+    size_t n, *ia, *iu;
+    int *ja;
+    float *a, *diag, *invd;
+    float *x, *b, *r, *p, *q, *z;
+}Mixed;
+
+#endif
+
+void init_mixed(Mixed **mx, QMatrix *A);
+void mixed_update(Mixed *mx, QMatrix *A);
+void mixed_ssor(Mixed *mx, double omega, float *y, float *c);
+void mixed_precond(Mixed *mx, double omega, double *y, double *c);
+int mixed_cg(Mixed *mx, double omega, double eps, int maxiter);
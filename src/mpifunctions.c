@@ -11,8 +11,83 @@ void mpi_bcast_double(double *y, int n, int root);
 void mpi_gather_int(int *y_root, int *y, int n, int root);
 void mpi_gather_double(double *y_root, double *y, int n, int root);
 void mpi_exchange_surf(double *y, Map *smap, int data_type, Config *param, int irank, int nrank);
+void mpi_exchange_surf_batch(double **y, int n, Map *smap, Config *param, int irank, int nrank);
 void mpi_exchange_subsurf(double *y, Map *gmap, int data_type, Config *param, int irank, int nrank);
+void mpi_decompose(Config *param, int irank, int nrank);
+void mpi_abort(Config *param);
 
+// >>>>> Stop all ranks after a fatal error <<<<<
+// A rank that only exits leaves the others waiting in the next collective.
+void mpi_abort(Config *param)
+{
+    fflush(stdout);
+    if (param->use_mpi == 1)    {MPI_Abort(MPI_COMM_WORLD, 1);}
+    exit(1);
+}
+
+// >>>>> Choose the ranks in x and y <<<<<
+// Every rank exchanges its subdomain edges with its neighbors, the cut of a
+// decomposition of mpi_nx by mpi_ny ranks is (mpi_nx-1)*NY + (mpi_ny-1)*NX
+// cells per layer. With mpi_auto = 1 the factorization of nrank with the
+// shortest cut that divides the domain evenly is used. The halo cells per
+// core are reported for the n_thread threads of every rank. An invalid
+// decomposition stops the job, rank 0 reports it while the others wait.
+void mpi_decompose(Config *param, int irank, int nrank)
+{
+    int px, py, cut, best = -1, nthread = 1;
+    if (param->mpi_auto == 1)
+    {
+        for (px = 1; px <= nrank; px++)
+        {
+            if (nrank % px != 0)    {continue;}
+            py = nrank / px;
+            if (param->NX % px != 0 | param->NY % py != 0)  {continue;}
+            cut = (px-1)*param->NY + (py-1)*param->NX;
+            if (best < 0 | cut < best)
+            {
+                best = cut;
+                param->mpi_nx = px;
+                param->mpi_ny = py;
+            }
+        }
+        if (best < 0)
+        {
+            if (irank == 0)
+            {
+                printf("ERROR: No decomposition of %d ranks divides the %d x %d domain!\n",nrank,param->NX,param->NY);
+                mpi_abort(param);
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+        free(param->dt_root);
+        param->dt_root = malloc(param->mpi_nx*param->mpi_ny*sizeof(double));
+    }
+    if (param->mpi_nx*param->mpi_ny != nrank)
+    {
+        if (irank == 0)
+        {
+            printf("ERROR: mpi_nx * mpi_ny = %d does not match %d ranks!\n",param->mpi_nx*param->mpi_ny,nrank);
+            mpi_abort(param);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    if (param->NX % param->mpi_nx != 0 | param->NY % param->mpi_ny != 0)
+    {
+        if (irank == 0)
+        {
+            printf("ERROR: %d x %d ranks do not divide the %d x %d domain evenly!\n",param->mpi_nx,param->mpi_ny,param->NX,param->NY);
+            mpi_abort(param);
+        }
+        MPI_Barrier(MPI_COMM_WORLD);
+    }
+    if (param->n_thread > 0)    {nthread = param->n_thread;}
+    cut = (param->mpi_nx-1)*param->NY + (param->mpi_ny-1)*param->NX;
+    if (irank == 0)
+    {
+        printf(" >> Decomposition %d x %d ranks, %d threads per rank, %.1f halo cells per core and layer\n", \
+            param->mpi_nx,param->mpi_ny,nthread,2.0*cut/(nrank*nthread));
+    }
+}
 
 // >>>>> MPI Broadcast <<<<<
 void mpi_bcast_int(int *y, int n, int root)
@@ -92,6 +167,76 @@ void mpi_exchange_surf(double *y, Map *smap, int data_type, Config *param, int i
 }
 
 
+// >>>>> MPI exchange of several surface fields <<<<<
+// The halos of the n fields are packed into one message per direction, so a
+// batch costs four messages instead of four per field. The pack buffers are
+// kept between calls and only grow when a larger batch arrives.
+void mpi_exchange_surf_batch(double **y, int n, Map *smap, Config *param, int irank, int nrank)
+{
+    MPI_Status status;
+    int ii, kk, idown, iup, ileft, iright, nx = param->nx, ny = param->ny;
+    static double *sbuf = NULL, *rbuf = NULL;
+    static int nbuf = 0;
+    if (irank < param->mpi_nx)  {ileft = MPI_PROC_NULL;}
+    else    {ileft = irank - param->mpi_nx;}
+    if (irank >= param->mpi_nx*(param->mpi_ny-1))   {iright = MPI_PROC_NULL;}
+    else    {iright = irank + param->mpi_nx;}
+    if (irank % param->mpi_nx == 0) {iup = MPI_PROC_NULL;}
+    else    {iup = irank - 1;}
+    if ((irank+1) % param->mpi_nx == 0) {idown = MPI_PROC_NULL;}
+    else    {idown = irank + 1;}
+    // start index of send/recv
+    int sendleft = smap->jMin[0], recvleft = smap->jPou[0];
+    int sendright = smap->jPin[0], recvright = smap->jMou[0];
+    int sendup = smap->iMin[0], recvup = smap->iPou[0];
+    int senddown = smap->iPin[0], recvdown = smap->iMou[0];
+    if (nx < ny)    {ii = n * ny;}
+    else    {ii = n * nx;}
+    if (ii > nbuf)
+    {
+        free(sbuf);
+        free(rbuf);
+        sbuf = calloc(ii, sizeof(double));
+        rbuf = calloc(ii, sizeof(double));
+        nbuf = ii;
+    }
+    // left-right exchange of rows
+    for (kk = 0; kk < n; kk++)
+    {for (ii = 0; ii < nx; ii++)    {sbuf[kk*nx+ii] = y[kk][sendleft+ii];}}
+    MPI_Sendrecv(sbuf, n*nx, MPI_DOUBLE, ileft, 9, rbuf, n*nx, MPI_DOUBLE, iright, 9, MPI_COMM_WORLD, &status);
+    if (iright != MPI_PROC_NULL)
+    {
+        for (kk = 0; kk < n; kk++)
+        {for (ii = 0; ii < nx; ii++)    {y[kk][recvleft+ii] = rbuf[kk*nx+ii];}}
+    }
+    for (kk = 0; kk < n; kk++)
+    {for (ii = 0; ii < nx; ii++)    {sbuf[kk*nx+ii] = y[kk][sendright+ii];}}
+    MPI_Sendrecv(sbuf, n*nx, MPI_DOUBLE, iright, 9, rbuf, n*nx, MPI_DOUBLE, ileft, 9, MPI_COMM_WORLD, &status);
+    if (ileft != MPI_PROC_NULL)
+    {
+        for (kk = 0; kk < n; kk++)
+        {for (ii = 0; ii < nx; ii++)    {y[kk][recvright+ii] = rbuf[kk*nx+ii];}}
+    }
+    // up-down exchange of columns
+    for (kk = 0; kk < n; kk++)
+    {for (ii = 0; ii < ny; ii++)    {sbuf[kk*ny+ii] = y[kk][sendup+ii*nx];}}
+    MPI_Sendrecv(sbuf, n*ny, MPI_DOUBLE, iup, 9, rbuf, n*ny, MPI_DOUBLE, idown, 9, MPI_COMM_WORLD, &status);
+    if (idown != MPI_PROC_NULL)
+    {
+        for (kk = 0; kk < n; kk++)
+        {for (ii = 0; ii < ny; ii++)    {y[kk][recvup+ii] = rbuf[kk*ny+ii];}}
+    }
+    for (kk = 0; kk < n; kk++)
+    {for (ii = 0; ii < ny; ii++)    {sbuf[kk*ny+ii] = y[kk][senddown+ii*nx];}}
+    MPI_Sendrecv(sbuf, n*ny, MPI_DOUBLE, idown, 9, rbuf, n*ny, MPI_DOUBLE, iup, 9, MPI_COMM_WORLD, &status);
+    if (iup != MPI_PROC_NULL)
+    {
+        for (kk = 0; kk < n; kk++)
+        {for (ii = 0; ii < ny; ii++)    {y[kk][recvdown+ii] = rbuf[kk*ny+ii];}}
+    }
+}
+
+
 // >>>>> MPI exchange for subsurface domain <<<<<
 void mpi_exchange_subsurf(double *y, Map *gmap, int data_type, Config *param, int irank, int nrank)
 {
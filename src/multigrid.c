@@ -0,0 +1,302 @@
+// Geometric multigrid preconditioner for structured stencil operators
+// Coarse grids merge 2x2 cells (2x1 or 1x2 once a direction is exhausted).
+// The coarse operators are Galerkin products with piecewise constant
+// transfer, so they keep the 5-point form. Cells whose rows carry no
+// off-diagonal coupling (dry cells) are left out of the transfer, they are
+// resolved exactly by the smoother and would only pollute coarse cells.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include"stencil.h"
+#include"multigrid.h"
+
+#define MG_NCOARSE 64
+#define MG_MAXLEVEL 20
+
+void init_multigrid(Multigrid **mg, Stencil *fine);
+void multigrid_setup(Multigrid *mg);
+void multigrid_vcycle(Multigrid *mg, double *x, double *b);
+int multigrid_pcg(Multigrid *mg, double *x, double *b, double eps, int maxiter);
+static void coupled_cells(Stencil *st, int *mask);
+static void coarsen_operator(Stencil *fine, Stencil *coarse, int *mask);
+static void restrict_residual(Stencil *fine, Stencil *coarse, int *mask, double *rc, double *rf);
+static void prolong_correction(Stencil *fine, Stencil *coarse, int *mask, double *xf, double *xc, double scale);
+static void coarse_factor(Multigrid *mg);
+static void coarse_solve(Multigrid *mg, double *x, double *b);
+static void vcycle(Multigrid *mg, int ll, double *x, double *b);
+void multigrid_precond(void *ctx, double *y, double *c);
+
+// >>>>> Build the grid hierarchy of a fine stencil operator <<<<<
+void init_multigrid(Multigrid **mg, Stencil *fine)
+{
+    int ll, nx, ny, cx, cy;
+    size_t n;
+    Stencil *st;
+    *mg = malloc(sizeof(Multigrid));
+    (*mg)->lev = malloc(MG_MAXLEVEL*sizeof(Stencil*));
+    (*mg)->x = malloc(MG_MAXLEVEL*sizeof(double*));
+    (*mg)->b = malloc(MG_MAXLEVEL*sizeof(double*));
+    (*mg)->res = malloc(MG_MAXLEVEL*sizeof(double*));
+    (*mg)->tmp = malloc(MG_MAXLEVEL*sizeof(double*));
+    (*mg)->cor = malloc(MG_MAXLEVEL*sizeof(double*));
+    (*mg)->mask = malloc(MG_MAXLEVEL*sizeof(int*));
+    // W-cycle with over-correction of the piecewise constant coarse grid
+    // correction keeps the iteration count nearly independent of the grid size
+    (*mg)->cycle = 2;
+    (*mg)->scale = 1.8;
+    (*mg)->lev[0] = fine;
+    (*mg)->x[0] = NULL;
+    (*mg)->b[0] = NULL;
+    (*mg)->tmp[0] = NULL;
+    (*mg)->cor[0] = NULL;
+    (*mg)->res[0] = malloc(fine->n*sizeof(double));
+    (*mg)->mask[0] = malloc(fine->n*sizeof(int));
+    ll = 0;
+    nx = fine->nx;
+    ny = fine->ny;
+    while (nx*ny > MG_NCOARSE & ll < MG_MAXLEVEL-1)
+    {
+        if (nx > 1) {cx = (nx + 1) / 2;}
+        else    {cx = 1;}
+        if (ny > 1) {cy = (ny + 1) / 2;}
+        else    {cy = 1;}
+        n = (size_t) cx * cy;
+        ll += 1;
+        init_stencil(&st, cx, cy, fine->sign, malloc(n*sizeof(double)), malloc(n*sizeof(double)), \
+            malloc(n*sizeof(double)), malloc(n*sizeof(double)), malloc(n*sizeof(double)));
+        (*mg)->lev[ll] = st;
+        // the Krylov workspace of coarse levels serves as multigrid vectors
+        (*mg)->x[ll] = st->z;
+        (*mg)->b[ll] = st->q;
+        (*mg)->res[ll] = st->r;
+        (*mg)->tmp[ll] = st->p;
+        (*mg)->cor[ll] = st->xprev;
+        (*mg)->mask[ll] = malloc(n*sizeof(int));
+        nx = cx;
+        ny = cy;
+    }
+    (*mg)->nlevel = ll + 1;
+    (*mg)->ncoarse = nx * ny;
+    (*mg)->lu = malloc((size_t) nx*ny*nx*ny*sizeof(double));
+}
+
+// >>>>> Galerkin coarse operators and coarse factorization <<<<<
+// Called whenever the fine coefficients have changed.
+void multigrid_setup(Multigrid *mg)
+{
+    int ll;
+    stencil_update_diag(mg->lev[0]);
+    for (ll = 1; ll < mg->nlevel; ll++)
+    {
+        coupled_cells(mg->lev[ll-1], mg->mask[ll-1]);
+        coarsen_operator(mg->lev[ll-1], mg->lev[ll], mg->mask[ll-1]);
+        stencil_update_diag(mg->lev[ll]);
+    }
+    coarse_factor(mg);
+}
+
+// >>>>> One V-cycle, x = M^(-1) * b <<<<<
+void multigrid_vcycle(Multigrid *mg, double *x, double *b)
+{
+    vcycle(mg, 0, x, b);
+}
+
+// >>>>> Multigrid preconditioned CG, x is the initial guess on entry <<<<<
+int multigrid_pcg(Multigrid *mg, double *x, double *b, double eps, int maxiter)
+{
+    multigrid_setup(mg);
+    return stencil_pcg(mg->lev[0], x, b, eps, maxiter, multigrid_precond, mg);
+}
+
+// >>>>> Multigrid preconditioner in the form used by the Krylov solvers <<<<<
+void multigrid_precond(void *ctx, double *y, double *c)
+{
+    multigrid_vcycle((Multigrid *) ctx, y, c);
+}
+
+// >>>>> Recursive (1,1) cycle with symmetric Gauss-Seidel smoothing <<<<<
+// cycle = 1 gives a V-cycle, cycle = 2 a W-cycle. Both are symmetric.
+static void vcycle(Multigrid *mg, int ll, double *x, double *b)
+{
+    int cc;
+    size_t ii;
+    Stencil *st = mg->lev[ll], *cs;
+    double *res = mg->res[ll];
+    if (ll == mg->nlevel-1)
+    {
+        coarse_solve(mg, x, b);
+        return;
+    }
+    // pre-smoothing from zero initial guess
+    stencil_ssor(st, x, b, 1.0);
+    stencil_matvec(st, res, x);
+    for (ii = 0; ii < st->n; ii++)  {res[ii] = b[ii] - res[ii];}
+    // coarse grid correction
+    cs = mg->lev[ll+1];
+    restrict_residual(st, cs, mg->mask[ll], mg->b[ll+1], res);
+    vcycle(mg, ll+1, mg->x[ll+1], mg->b[ll+1]);
+    for (cc = 1; cc < mg->cycle & ll+1 < mg->nlevel-1; cc++)
+    {
+        stencil_matvec(cs, mg->tmp[ll+1], mg->x[ll+1]);
+        for (ii = 0; ii < cs->n; ii++)  {mg->tmp[ll+1][ii] = mg->b[ll+1][ii] - mg->tmp[ll+1][ii];}
+        vcycle(mg, ll+1, mg->cor[ll+1], mg->tmp[ll+1]);
+        for (ii = 0; ii < cs->n; ii++)  {mg->x[ll+1][ii] += mg->cor[ll+1][ii];}
+    }
+    prolong_correction(st, cs, mg->mask[ll], x, mg->x[ll+1], mg->scale);
+    // post-smoothing, the same symmetric sweep keeps the cycle symmetric
+    stencil_matvec(st, res, x);
+    for (ii = 0; ii < st->n; ii++)  {res[ii] = b[ii] - res[ii];}
+    stencil_ssor(st, res, res, 1.0);
+    for (ii = 0; ii < st->n; ii++)  {x[ii] += res[ii];}
+}
+
+// >>>>> Mark cells that are coupled to at least one neighbor <<<<<
+static void coupled_cells(Stencil *st, int *mask)
+{
+    int ii, jj;
+    size_t im;
+    for (jj = 0; jj < st->ny; jj++)
+    {
+        for (ii = 0; ii < st->nx; ii++)
+        {
+            im = jj*st->nx + ii;
+            mask[im] = 0;
+            if (ii > 0 & st->xm[im] != 0.0)   {mask[im] = 1;}
+            if (ii < st->nx-1 & st->xp[im] != 0.0)    {mask[im] = 1;}
+            if (jj > 0 & st->ym[im] != 0.0)   {mask[im] = 1;}
+            if (jj < st->ny-1 & st->yp[im] != 0.0)    {mask[im] = 1;}
+        }
+    }
+}
+
+// >>>>> Galerkin operator R*A*P for piecewise constant transfer <<<<<
+// Couplings inside a coarse cell are added to its diagonal, couplings
+// across coarse cell faces are summed into the coarse off-diagonals.
+// Only cells with mask = 1 take part, coarse cells without any of them
+// get a unit diagonal.
+static void coarsen_operator(Stencil *fine, Stencil *coarse, int *mask)
+{
+    int ii, jj, ic, fx, fy, nx = fine->nx, ny = fine->ny;
+    size_t im;
+    double sg = fine->sign;
+    fx = (nx > 1) ? 2 : 1;
+    fy = (ny > 1) ? 2 : 1;
+    for (im = 0; im < coarse->n; im++)
+    {
+        coarse->ct[im] = 0.0;
+        coarse->xp[im] = 0.0;   coarse->xm[im] = 0.0;
+        coarse->yp[im] = 0.0;   coarse->ym[im] = 0.0;
+    }
+    for (jj = 0; jj < ny; jj++)
+    {
+        for (ii = 0; ii < nx; ii++)
+        {
+            im = jj*nx + ii;
+            if (mask[im] == 0)  {continue;}
+            ic = (jj/fy)*coarse->nx + ii/fx;
+            coarse->ct[ic] += fine->ct[im];
+            if (ii < nx-1 && mask[im+1] == 1)
+            {
+                if ((ii+1)/fx == ii/fx) {coarse->ct[ic] += sg * fine->xp[im];}
+                else    {coarse->xp[ic] += fine->xp[im];}
+            }
+            if (ii > 0 && mask[im-1] == 1)
+            {
+                if ((ii-1)/fx == ii/fx) {coarse->ct[ic] += sg * fine->xm[im];}
+                else    {coarse->xm[ic] += fine->xm[im];}
+            }
+            if (jj < ny-1 && mask[im+nx] == 1)
+            {
+                if ((jj+1)/fy == jj/fy) {coarse->ct[ic] += sg * fine->yp[im];}
+                else    {coarse->yp[ic] += fine->yp[im];}
+            }
+            if (jj > 0 && mask[im-nx] == 1)
+            {
+                if ((jj-1)/fy == jj/fy) {coarse->ct[ic] += sg * fine->ym[im];}
+                else    {coarse->ym[ic] += fine->ym[im];}
+            }
+        }
+    }
+    for (im = 0; im < coarse->n; im++)
+    {if (coarse->ct[im] == 0.0)    {coarse->ct[im] = 1.0;}}
+}
+
+// >>>>> Restriction, sum of the fine residuals in each coarse cell <<<<<
+static void restrict_residual(Stencil *fine, Stencil *coarse, int *mask, double *rc, double *rf)
+{
+    int ii, jj, fx, fy;
+    size_t im;
+    fx = (fine->nx > 1) ? 2 : 1;
+    fy = (fine->ny > 1) ? 2 : 1;
+    for (im = 0; im < coarse->n; im++)  {rc[im] = 0.0;}
+    for (jj = 0; jj < fine->ny; jj++)
+    {
+        for (ii = 0; ii < fine->nx; ii++)
+        {if (mask[jj*fine->nx + ii] == 1)  {rc[(jj/fy)*coarse->nx + ii/fx] += rf[jj*fine->nx + ii];}}
+    }
+}
+
+// >>>>> Prolongation, inject the coarse correction into each fine cell <<<<<
+static void prolong_correction(Stencil *fine, Stencil *coarse, int *mask, double *xf, double *xc, double scale)
+{
+    int ii, jj, fx, fy;
+    fx = (fine->nx > 1) ? 2 : 1;
+    fy = (fine->ny > 1) ? 2 : 1;
+    for (jj = 0; jj < fine->ny; jj++)
+    {
+        for (ii = 0; ii < fine->nx; ii++)
+        {if (mask[jj*fine->nx + ii] == 1)  {xf[jj*fine->nx + ii] += scale * xc[(jj/fy)*coarse->nx + ii/fx];}}
+    }
+}
+
+// >>>>> Dense LU factorization of the coarsest operator <<<<<
+// The operator is diagonally dominant, so no pivoting is applied.
+static void coarse_factor(Multigrid *mg)
+{
+    int ii, jj, kk, nx, n = mg->ncoarse;
+    double *lu = mg->lu, sg, fac;
+    Stencil *st = mg->lev[mg->nlevel-1];
+    nx = st->nx;
+    sg = st->sign;
+    for (ii = 0; ii < n*n; ii++)    {lu[ii] = 0.0;}
+    for (ii = 0; ii < n; ii++)
+    {
+        lu[ii*n+ii] = st->ct[ii];
+        if (ii % nx > 0)    {lu[ii*n+ii-1] = sg * st->xm[ii];}
+        if (ii % nx < nx-1) {lu[ii*n+ii+1] = sg * st->xp[ii];}
+        if (ii >= nx)   {lu[ii*n+ii-nx] = sg * st->ym[ii];}
+        if (ii < n-nx)  {lu[ii*n+ii+nx] = sg * st->yp[ii];}
+    }
+    for (kk = 0; kk < n; kk++)
+    {
+        for (ii = kk+1; ii < n; ii++)
+        {
+            if (lu[ii*n+kk] != 0.0)
+            {
+                fac = lu[ii*n+kk] / lu[kk*n+kk];
+                lu[ii*n+kk] = fac;
+                for (jj = kk+1; jj < n; jj++)   {lu[ii*n+jj] -= fac * lu[kk*n+jj];}
+            }
+        }
+    }
+}
+
+// >>>>> Solve with the coarsest operator <<<<<
+static void coarse_solve(Multigrid *mg, double *x, double *b)
+{
+    int ii, jj, n = mg->ncoarse;
+    double *lu = mg->lu, sum;
+    for (ii = 0; ii < n; ii++)
+    {
+        sum = b[ii];
+        for (jj = 0; jj < ii; jj++) {sum -= lu[ii*n+jj] * x[jj];}
+        x[ii] = sum;
+    }
+    for (ii = n-1; ii >= 0; ii--)
+    {
+        sum = x[ii];
+        for (jj = ii+1; jj < n; jj++)   {sum -= lu[ii*n+jj] * x[jj];}
+        x[ii] = sum / lu[ii*n+ii];
+    }
+}
@@ -0,0 +1,26 @@
+// Header file for multigrid.c
+#include "stencil.h"
+
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+// geometric multigrid hierarchy of a 5-point stencil operator
+// Level 0 is the fine operator, coarse levels merge 2x2 cells and carry
+// Galerkin operators, the coarsest level is solved by dense LU.
+typedef struct Multigrid
+{
+    int nlevel, ncoarse, cycle;
+    double scale;
+    Stencil **lev;
+    int **mask;
+    double **x, **b, **res, **tmp, **cor;
+    double *lu;
+}Multigrid;
+
+#endif
+
+void init_multigrid(Multigrid **mg, Stencil *fine);
+void multigrid_setup(Multigrid *mg);
+void multigrid_vcycle(Multigrid *mg, double *x, double *b);
+void multigrid_precond(void *ctx, double *y, double *c);
+int multigrid_pcg(Multigrid *mg, double *x, double *b, double eps, int maxiter);
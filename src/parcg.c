@@ -0,0 +1,296 @@
+// Preconditioned CG for linear systems distributed over the MPI ranks
+// Every rank holds the rows of its own cells. The matrix-vector product
+// exchanges the halo of the search direction, so the iteration solves the
+// global system and the partition only changes the preconditioner, which
+// acts on the local block of each rank (block Jacobi).
+// There is no coarse level, so the iteration count grows with the number
+// of ranks as information crosses one subdomain per iteration. Deflating the
+// subdomain constants (Nicolaides 1987) does not suit the surface matrix,
+// whose rows of dry and tidal cells break its symmetry.
+// The pipelined variant after Ghysels and Vanroose (2014) reduces all dot
+// products of an iteration at once and overlaps the reduction with the
+// preconditioner and the matrix-vector product.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include<mpi.h>
+
+#include "configuration.h"
+#include "map.h"
+#include "mpifunctions.h"
+#include "parcg.h"
+
+void init_parcg(ParCG **cg, size_t n, size_t nt, size_t maxhalo, HaloExchange exchange, \
+    Map *map, Config *param, int irank, int nrank);
+void parcg_compact(ParCG *cg, int *cell);
+void parcg_reset(ParCG *cg);
+void parcg_couple(ParCG *cg, size_t row, size_t col, double val);
+void parcg_allreduce(ParCG *cg, double *val, int n);
+int parcg_solve(ParCG *cg, ParOperator matvec, void *actx, ParOperator precond, void *pctx, \
+    double *x, double *b, double eps, int maxiter);
+static int parcg_pipelined(ParCG *cg, ParOperator matvec, void *actx, ParOperator precond, void *pctx, \
+    double *x, double *b, double eps, int maxiter);
+static void parcg_matvec(ParCG *cg, ParOperator matvec, void *actx, double *y, double *x);
+
+// >>>>> Allocate a distributed solver <<<<<
+// n is the number of rows of this rank, nt the size of the arrays including
+// ghost cells, maxhalo the largest number of couplings to ghost cells.
+void init_parcg(ParCG **cg, size_t n, size_t nt, size_t maxhalo, HaloExchange exchange, \
+    Map *map, Config *param, int irank, int nrank)
+{
+    *cg = malloc(sizeof(ParCG));
+    (*cg)->n = n;
+    (*cg)->nt = nt;
+    (*cg)->nhalo = 0;
+    (*cg)->maxhalo = maxhalo;
+    (*cg)->hrow = malloc(maxhalo*sizeof(size_t));
+    (*cg)->hcol = malloc(maxhalo*sizeof(size_t));
+    (*cg)->hval = malloc(maxhalo*sizeof(double));
+    (*cg)->r = malloc(n*sizeof(double));
+    (*cg)->q = malloc(n*sizeof(double));
+    (*cg)->z = malloc(n*sizeof(double));
+    // the search direction is exchanged, so it carries the ghost cells
+    (*cg)->p = calloc(nt, sizeof(double));
+    (*cg)->iter = 0;
+    (*cg)->acc = 0.0;
+    (*cg)->res0 = 1.0;
+    (*cg)->exchange = exchange;
+    (*cg)->map = map;
+    (*cg)->param = param;
+    (*cg)->irank = irank;
+    (*cg)->nrank = nrank;
+    (*cg)->cell = NULL;
+    (*cg)->full = NULL;
+    // workspace of the pipelined iteration, allocated on first use
+    (*cg)->pipelined = 0;
+    (*cg)->u = NULL;
+    (*cg)->w = NULL;
+    (*cg)->m = NULL;
+    (*cg)->s = NULL;
+    (*cg)->v = NULL;
+}
+
+// >>>>> Rows are a compacted subset of the cells, row ii is cell[ii] <<<<<
+// The search direction is then scattered into an array of all cells and
+// ghost cells before the halo exchange.
+void parcg_compact(ParCG *cg, int *cell)
+{
+    cg->cell = cell;
+    cg->full = calloc(cg->nt, sizeof(double));
+}
+
+// >>>>> Remove all couplings to ghost cells <<<<<
+void parcg_reset(ParCG *cg)
+{
+    cg->nhalo = 0;
+}
+
+// >>>>> Add the matrix entry of row to the ghost cell col <<<<<
+void parcg_couple(ParCG *cg, size_t row, size_t col, double val)
+{
+    if (val == 0.0) {return;}
+    // a dropped coupling would leave a wrong operator
+    if (cg->nhalo == cg->maxhalo)
+    {
+        printf("ERROR: Too many couplings to ghost cells on rank %d!\n", cg->irank);
+        mpi_abort(cg->param);
+    }
+    cg->hrow[cg->nhalo] = row;
+    cg->hcol[cg->nhalo] = col;
+    cg->hval[cg->nhalo] = val;
+    cg->nhalo += 1;
+}
+
+// >>>>> Sum of n values over all ranks, in place <<<<<
+void parcg_allreduce(ParCG *cg, double *val, int n)
+{
+    if (cg->param->use_mpi == 1)
+    {MPI_Allreduce(MPI_IN_PLACE, val, n, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);}
+}
+
+// >>>>> y = A * x over all ranks, x must have room for the ghost cells unless compacted <<<<<
+static void parcg_matvec(ParCG *cg, ParOperator matvec, void *actx, double *y, double *x)
+{
+    size_t ii;
+    double *xt = x;
+    if (cg->cell != NULL)
+    {
+        xt = cg->full;
+        for (ii = 0; ii < cg->n; ii++)  {xt[cg->cell[ii]] = x[ii];}
+    }
+    if (cg->param->use_mpi == 1)
+    {(*cg->exchange)(xt, cg->map, 2, cg->param, cg->irank, cg->nrank);}
+    (*matvec)(actx, y, x);
+    for (ii = 0; ii < cg->nhalo; ii++)  {y[cg->hrow[ii]] += cg->hval[ii] * xt[cg->hcol[ii]];}
+}
+
+// >>>>> Preconditioned CG, x is the initial guess on entry <<<<<
+// Stops when |r| < eps*|b| on the global vectors as LASPack CGIter does.
+// The residual norm is reduced together with (r,z), so every iteration
+// takes two global reductions and one halo exchange.
+int parcg_solve(ParCG *cg, ParOperator matvec, void *actx, ParOperator precond, void *pctx, \
+    double *x, double *b, double eps, int maxiter)
+{
+    int iter = 0;
+    if (cg->pipelined == 1)
+    {return parcg_pipelined(cg, matvec, actx, precond, pctx, x, b, eps, maxiter);}
+    size_t ii, n = cg->n;
+    double alpha, beta, rho_old = 1.0, bnorm, rnorm, sum[3];
+    double *r = cg->r, *p = cg->p, *q = cg->q, *z = cg->z;
+
+    parcg_matvec(cg, matvec, actx, r, x);
+    for (ii = 0; ii < n; ii++)  {r[ii] = b[ii] - r[ii];}
+    (*precond)(pctx, z, r);
+    sum[0] = 0.0;   sum[1] = 0.0;   sum[2] = 0.0;
+    for (ii = 0; ii < n; ii++)
+    {
+        sum[0] += b[ii] * b[ii];
+        sum[1] += r[ii] * r[ii];
+        sum[2] += r[ii] * z[ii];
+    }
+    parcg_allreduce(cg, sum, 3);
+    bnorm = sqrt(sum[0]);
+    rnorm = sqrt(sum[1]);
+    if (bnorm > 0.0)    {cg->res0 = rnorm / bnorm;}
+    else
+    {
+        // zero right hand side has the trivial solution
+        for (ii = 0; ii < n; ii++)  {x[ii] = 0.0;}
+        cg->res0 = 0.0;
+        rnorm = 0.0;
+    }
+    while (rnorm >= eps * bnorm && bnorm > 0.0 && iter < maxiter)
+    {
+        iter++;
+        if (iter == 1)
+        {for (ii = 0; ii < n; ii++)    {p[ii] = z[ii];}}
+        else
+        {
+            beta = sum[2] / rho_old;
+            for (ii = 0; ii < n; ii++)  {p[ii] = z[ii] + beta * p[ii];}
+        }
+        parcg_matvec(cg, matvec, actx, q, p);
+        sum[0] = 0.0;
+        for (ii = 0; ii < n; ii++)  {sum[0] += p[ii] * q[ii];}
+        parcg_allreduce(cg, sum, 1);
+        alpha = sum[2] / sum[0];
+        rho_old = sum[2];
+        for (ii = 0; ii < n; ii++)
+        {
+            x[ii] += alpha * p[ii];
+            r[ii] -= alpha * q[ii];
+        }
+        (*precond)(pctx, z, r);
+        sum[1] = 0.0;   sum[2] = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            sum[1] += r[ii] * r[ii];
+            sum[2] += r[ii] * z[ii];
+        }
+        parcg_allreduce(cg, sum+1, 2);
+        rnorm = sqrt(sum[1]);
+    }
+    cg->iter = iter;
+    if (bnorm > 0.0)    {cg->acc = rnorm / bnorm;}
+    else    {cg->acc = 0.0;}
+    return iter;
+}
+
+// >>>>> Pipelined preconditioned CG, x is the initial guess on entry <<<<<
+// Mathematically the same iteration as parcg_solve. The recurrences for
+// s = A*p, q = M*s and z = A*q replace the matrix-vector product of the
+// search direction, so (r,u), (w,u) and (r,r) are known before the next
+// preconditioner and matrix-vector product and are reduced in a single
+// non-blocking reduction that runs while these are applied.
+static int parcg_pipelined(ParCG *cg, ParOperator matvec, void *actx, ParOperator precond, void *pctx, \
+    double *x, double *b, double eps, int maxiter)
+{
+    int iter = 0;
+    size_t ii, n = cg->n, nt = cg->nt;
+    double alpha = 1.0, beta, gamma, gamma_old = 1.0, bnorm, rnorm, sum[3];
+    double *r, *p, *q, *z, *u, *w, *m, *s, *v;
+    MPI_Request request;
+
+    if (cg->u == NULL)
+    {
+        // u and m enter a matrix-vector product, so they carry the ghost cells
+        cg->u = calloc(nt, sizeof(double));
+        cg->m = calloc(nt, sizeof(double));
+        cg->w = malloc(n*sizeof(double));
+        cg->s = malloc(n*sizeof(double));
+        cg->v = malloc(n*sizeof(double));
+    }
+    r = cg->r;  p = cg->p;  q = cg->q;  z = cg->z;
+    u = cg->u;  w = cg->w;  m = cg->m;  s = cg->s;  v = cg->v;
+
+    // r = b - A*x, u = M*r, w = A*u
+    parcg_matvec(cg, matvec, actx, r, x);
+    for (ii = 0; ii < n; ii++)  {r[ii] = b[ii] - r[ii];}
+    (*precond)(pctx, u, r);
+    parcg_matvec(cg, matvec, actx, w, u);
+    sum[0] = 0.0;
+    for (ii = 0; ii < n; ii++)  {sum[0] += b[ii] * b[ii];}
+    parcg_allreduce(cg, sum, 1);
+    bnorm = sqrt(sum[0]);
+    if (bnorm == 0.0)
+    {
+        // zero right hand side has the trivial solution
+        for (ii = 0; ii < n; ii++)  {x[ii] = 0.0;}
+        cg->res0 = 0.0;
+        cg->acc = 0.0;
+        cg->iter = 0;
+        return 0;
+    }
+    while (1)
+    {
+        sum[0] = 0.0;   sum[1] = 0.0;   sum[2] = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            sum[0] += r[ii] * u[ii];
+            sum[1] += w[ii] * u[ii];
+            sum[2] += r[ii] * r[ii];
+        }
+        if (cg->param->use_mpi == 1)
+        {MPI_Iallreduce(MPI_IN_PLACE, sum, 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD, &request);}
+        // overlapped with the reduction, m = M*w and v = A*m
+        (*precond)(pctx, m, w);
+        parcg_matvec(cg, matvec, actx, v, m);
+        if (cg->param->use_mpi == 1)    {MPI_Wait(&request, MPI_STATUS_IGNORE);}
+        rnorm = sqrt(sum[2]);
+        if (iter == 0)  {cg->res0 = rnorm / bnorm;}
+        if (rnorm < eps * bnorm || iter >= maxiter) {break;}
+        iter++;
+        gamma = sum[0];
+        if (iter == 1)
+        {
+            alpha = gamma / sum[1];
+            for (ii = 0; ii < n; ii++)
+            {
+                z[ii] = v[ii];  q[ii] = m[ii];  s[ii] = w[ii];  p[ii] = u[ii];
+            }
+        }
+        else
+        {
+            beta = gamma / gamma_old;
+            alpha = gamma / (sum[1] - beta * gamma / alpha);
+            for (ii = 0; ii < n; ii++)
+            {
+                z[ii] = v[ii] + beta * z[ii];
+                q[ii] = m[ii] + beta * q[ii];
+                s[ii] = w[ii] + beta * s[ii];
+                p[ii] = u[ii] + beta * p[ii];
+            }
+        }
+        gamma_old = gamma;
+        for (ii = 0; ii < n; ii++)
+        {
+            x[ii] += alpha * p[ii];
+            r[ii] -= alpha * s[ii];
+            u[ii] -= alpha * q[ii];
+            w[ii] -= alpha * z[ii];
+        }
+    }
+    cg->iter = iter;
+    cg->acc = rnorm / bnorm;
+    return iter;
+}
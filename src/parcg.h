@@ -0,0 +1,43 @@
+// Header file for parcg.c
+#include "configuration.h"
+#include "map.h"
+
+#ifndef PARCG_H
+#define PARCG_H
+
+// local operator or preconditioner, y = A*x or y = M^(-1)*x on one rank
+typedef void (*ParOperator)(void *ctx, double *y, double *x);
+// halo exchange in the form of mpi_exchange_surf and mpi_exchange_subsurf
+typedef void (*HaloExchange)(double *y, Map *map, int data_type, Config *param, int irank, int nrank);
+
+// CG coupled over all ranks
+// Each rank applies its own block, couplings to ghost cells owned by the
+// neighbor ranks are kept as a list of (row, ghost, value) entries and
+// applied after a halo exchange. Dot products are summed over all ranks.
+// If the rows are a compacted subset of the cells, cell maps them back.
+// pipelined = 1 selects the CG with one overlapped reduction per iteration.
+typedef struct ParCG
+{
+    size_t n, nt, nhalo, maxhalo;
+    size_t *hrow, *hcol;
+    double *hval;
+    double *r, *p, *q, *z, *u, *w, *m, *s, *v;
+    int iter, irank, nrank, pipelined;
+    double acc, res0;
+    int *cell;
+    double *full;
+    Map *map;
+    Config *param;
+    HaloExchange exchange;
+}ParCG;
+
+#endif
+
+void init_parcg(ParCG **cg, size_t n, size_t nt, size_t maxhalo, HaloExchange exchange, \
+    Map *map, Config *param, int irank, int nrank);
+void parcg_compact(ParCG *cg, int *cell);
+void parcg_reset(ParCG *cg);
+void parcg_couple(ParCG *cg, size_t row, size_t col, double val);
+void parcg_allreduce(ParCG *cg, double *val, int n);
+int parcg_solve(ParCG *cg, ParOperator matvec, void *actx, ParOperator precond, void *pctx, \
+    double *x, double *b, double eps, int maxiter);
@@ -203,6 +203,7 @@ void scalar_groundwater(Data **data, Map *gmap, Config *param, int irank, int nr
     double sip, sim, sjp, sjm, skp, skm, s_lim_hi, s_lim_lo, s_rainevap;
     double jip, jim, jjp, jjm, jkp, jkm, coeff;
     double *s_min, *s_max;
+    Material *mat;
     s_lim_hi = 1000.0;
     s_lim_lo = 0.0;
     s_min = malloc(param->n3ci*sizeof(double));
@@ -214,6 +215,7 @@ void scalar_groundwater(Data **data, Map *gmap, Config *param, int irank, int nr
 
     for (ii = 0; ii < param->n3ci; ii++)
     {
+        mat = &(*data)->mat[(*data)->soil[ii]];
         // scalar mass
         (*data)->sm_subs[kk][ii] = (*data)->s_subs[kk][ii] * (*data)->Vgn[ii];
         // scalar of kM boundary
@@ -269,7 +271,7 @@ void scalar_groundwater(Data **data, Map *gmap, Config *param, int irank, int nr
         }
         else    {skm = 0.0;}
         // advective transport
-        (*data)->sm_subs[kk][ii] = (*data)->sm_subs[kk][ii] + param->dt * (*data)->wcs[ii] *\
+        (*data)->sm_subs[kk][ii] = (*data)->sm_subs[kk][ii] + param->dt * mat->wcs *\
             ((-(*data)->qx[ii] * sip + (*data)->qx[gmap->iMjckc[ii]] * sim) * param->dy * gmap->dz3d[ii] + \
             (-(*data)->qy[ii] * sjp + (*data)->qy[gmap->icjMkc[ii]] * sjm) * param->dx * gmap->dz3d[ii] + \
             ((*data)->qz[ii] * skp - (*data)->qz[gmap->icjckM[ii]] * skm) * param->dx * param->dy);
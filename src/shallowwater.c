@@ -2,6 +2,7 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<time.h>
+#include<omp.h>
 #include<math.h>
 #include<string.h>
 #include<stdbool.h>
@@ -11,6 +12,7 @@
 #include "map.h"
 #include "mpifunctions.h"
 #include "scalar.h"
+#include "shallowwater.h"
 #include "utility.h"
 
 #include "laspack/errhandl.h"
@@ -27,12 +29,18 @@
 
 void solve_shallowwater(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank);
 void shallowwater_velocity(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank);
+void post_solve_depth(Data **data, Map *smap, Config *param, int irank, int nrank);
+void post_solve_velocity(Data **data, Map *smap, Config *param);
+void post_solve_flow_rate(Data **data, Map *smap, Config *param, int irank);
 void momentum_source(Data **data, Map *smap, Config *param);
 void wind_source(Data **data, Map *smap, Config *param, int ii);
 void shallowwater_rhs(Data **data, Map *smap, Config *param);
 void shallowwater_mat_coeff(Data **data, Map *smap, Config *param, int irank, int nrank);
-void build_shallowwater_system(Data *data, Map *smap, Config *param, QMatrix A, Vector b);
-void solve_shallowwater_system(Data **data, Map *smap, QMatrix A, Vector b, Vector x, Config *param);
+void init_shallowwater_system(Data **data, Map *smap, Config *param, int irank, int nrank);
+void shallowwater_halo(Data *data, Map *smap, Config *param, ParCG *cg, int irank);
+void build_shallowwater_system(Data *data, Map *smap, Config *param, LinSys *sys);
+void solve_shallowwater_system(Data **data, Map *smap, LinSys *sys, Config *param);
+void solve_shallowwater_stencil(Data **data, Map *smap, Stencil *st, Config *param);
 void enforce_surf_bc(Data **data, Map *smap, Config *param, int irank, int nrank);
 void cfl_limiter(Data **data, Map *smap, Config *param);
 void evaprain(Data **data, Map *smap, Config *param);
@@ -45,18 +53,22 @@ void interp_velocity(Data **data, Map *smap, Config *param);
 void update_drag_coef(Data **data, Config *param);
 void update_subgrid_variable(Data **data, Map *smap, Config *param);
 void volume_by_flux(Data **data, Map *smap, Config *param);
+void waterfall_cell(Data **data, Map *smap, Config *param, int ii);
+void velocity_cell(Data **data, Map *smap, Config *param, int ii);
+void velocity_limiter_p(Data **data, Config *param, int ii);
+void velocity_limiter_m(Data **data, Map *smap, Config *param, int ii);
+void flow_rate_cell(Data **data, Map *smap, Config *param, int ii, int irank);
+void drag_coef_cell(Data **data, Config *param, int ii);
+void subgrid_cell_variable(Data **data, Config *param, int ii);
+void subgrid_face_variable(Data **data, Map *smap, int ii);
+void subgrid_boundary_variable(Data **data, Map *smap, Config *param);
+void volume_by_flux_cell(Data **data, Map *smap, Config *param, int ii);
+void inflow_volume(Data **data, Config *param);
 
 // >>>>> Top level shallowwater solver
 void solve_shallowwater(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank)
 {
     int ii;
-    // allocate linear system
-    QMatrix A;
-    Q_Constr(&A, "A", param->n2ci, False, Rowws, Normal, True);
-    Vector b;
-    V_Constr(&b, "b", param->n2ci, Normal, True);
-    Vector x;
-    V_Constr(&x, "x", param->n2ci, Normal, True);
     for (ii = 0; ii < param->n2ci; ii++)    {(*data)->etan[ii] = (*data)->eta[ii];}
     enforce_surf_bc(data, smap, param, irank, nrank);
     if (param->use_mpi == 1)
@@ -74,21 +86,27 @@ void solve_shallowwater(Data **data, Map *smap, Map *gmap, Config *param, int ir
     }
     shallowwater_rhs(data, smap, param);
     shallowwater_mat_coeff(data, smap, param, irank, nrank);
-    build_shallowwater_system(*data, smap, param, A, b);
-    solve_shallowwater_system(data, smap, A, b, x, param);
+    if ((*data)->Spcg != NULL)  {shallowwater_halo(*data, smap, param, (*data)->Spcg, irank);}
+    if (param->use_stencil == 1)
+    {solve_shallowwater_stencil(data, smap, (*data)->Sst, param);}
+    else
+    {
+        build_shallowwater_system(*data, smap, param, (*data)->Ssys);
+        solve_shallowwater_system(data, smap, (*data)->Ssys, param);
+    }
     enforce_surf_bc(data, smap, param, irank, nrank);
     // printf("Surface NEW : depth, surf = %f, %f\n",(*data)->dept[30],(*data)->eta[30]);
     // Update depth
     cfl_limiter(data, smap, param);
     evaprain(data, smap, param);
     update_depth(data, smap, param, irank);
-    // free memory
-    Q_Destr(&A);
-    V_Destr(&b);
-    V_Destr(&x);
 }
 
 // >>>>> Velocity update for shallowwater solver
+// The updates after the surface solve run as three fused sweeps over the
+// cells, see post_solve_depth, post_solve_velocity and post_solve_flow_rate.
+// The halo exchanges of the volumes, areas and velocities are batched after
+// the last sweep, none of the sweeps reads these fields at the ghost cells.
 void shallowwater_velocity(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank)
 {
     if (param->sim_groundwater == 1)
@@ -96,50 +114,26 @@ void shallowwater_velocity(Data **data, Map *smap, Map *gmap, Config *param, int
     // printf("-----\n");
     if (param->use_mpi == 1)
     {mpi_exchange_surf((*data)->eta, smap, 2, param, irank, nrank);}
-    update_depth(data, smap, param, irank);
-    if (param->use_mpi == 1)
-    {
-        mpi_exchange_surf((*data)->dept, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->deptx, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->depty, smap, 2, param, irank, nrank);
-    }
-    // Update subgrid variables
-    update_subgrid_variable(data, smap, param);
-    volume_by_flux(data, smap, param);
-    if (param->use_mpi == 1)
-    {
-        mpi_exchange_surf((*data)->Vs, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Vsx, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Vsy, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Asx, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Asy, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Asz, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Aszx, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Aszy, smap, 2, param, irank, nrank);
-    }
-    // Update bottom drag
-    update_drag_coef(data, param);
-    // Update velocity
-    waterfall_location(data, smap, param);
-    update_velocity(data, smap, param, irank);
+    // depth, volume and areas
+    post_solve_depth(data, smap, param, irank, nrank);
+    // bottom drag, waterfalls and velocity
+    post_solve_velocity(data, smap, param);
+    post_solve_flow_rate(data, smap, param, irank);
     // waterfall_velocity(data, smap, param);
     enforce_velo_bc(data, smap, param, irank, nrank);
     // printf("Velocity NEW : velo = %f, %f\n",(*data)->uu[30],(*data)->vv[30]);
     if (param->use_mpi == 1)
     {
-        mpi_exchange_surf((*data)->uu, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->vv, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Fu, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->Fv, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->CDx, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->CDy, smap, 2, param, irank, nrank);
+        double *halo[14] = {(*data)->Vs, (*data)->Vsx, (*data)->Vsy, (*data)->Asx, (*data)->Asy, \
+            (*data)->Asz, (*data)->Aszx, (*data)->Aszy, (*data)->uu, (*data)->vv, (*data)->Fu, \
+            (*data)->Fv, (*data)->CDx, (*data)->CDy};
+        mpi_exchange_surf_batch(halo, 14, smap, param, irank, nrank);
     }
-    // volume_by_flux(data, smap, param);
     interp_velocity(data, smap, param);
     if (param->use_mpi == 1)
     {
-        mpi_exchange_surf((*data)->uy, smap, 2, param, irank, nrank);
-        mpi_exchange_surf((*data)->vx, smap, 2, param, irank, nrank);
+        double *halo[2] = {(*data)->uy, (*data)->vx};
+        mpi_exchange_surf_batch(halo, 2, smap, param, irank, nrank);
     }
 
 
@@ -147,11 +141,132 @@ void shallowwater_velocity(Data **data, Map *smap, Map *gmap, Config *param, int
     // {for (ii = 0; ii < param->n2ci; ii++)    {(*data)->qseepage[ii] = 0.0;}}
 }
 
+// >>>>> Depth, volume and areas from the new surface elevation
+// update_depth and update_subgrid_variable fused over tiles of whole rows.
+// The small depths of a tile are removed first, the depths, volumes and areas
+// follow one row behind, since the face depth at yp reads the surface
+// elevation of the next row. The ghost cells are updated after the sweep.
+void post_solve_depth(Data **data, Map *smap, Config *param, int irank, int nrank)
+{
+    int ii, j0, j1, lo, hi, rows, subgrid = 0;
+    double diff;
+    if (param->use_subgrid == 1)
+    {
+        mpi_print("WARNING: subgrid functions have not been implemented!",0);
+        subgrid = 1;
+    }
+    rows = SW_TILE / param->nx;
+    if (rows < 1)   {rows = 1;}
+    #pragma omp parallel private(j0, j1, lo, hi, diff)
+    for (j0 = 0; j0 < param->ny; j0 += rows)
+    {
+        j1 = j0 + rows;
+        if (j1 > param->ny) {j1 = param->ny;}
+        // remove small depth
+        #pragma omp for
+        for (ii = j0*param->nx; ii < j1*param->nx; ii++)
+        {
+            diff = (*data)->eta[ii] - (*data)->bottom[ii];
+            if (diff > 0 & diff < param->min_dept)
+            {(*data)->eta[ii] = (*data)->bottom[ii];}
+        }
+        // depth, face depth, volume and areas one row behind
+        lo = j0 - 1;
+        if (j0 == 0)    {lo = 0;}
+        hi = j1 - 1;
+        if (j1 == param->ny)    {hi = param->ny;}
+        #pragma omp for
+        for (ii = lo*param->nx; ii < hi*param->nx; ii++)
+        {
+            (*data)->dept[ii] = (*data)->eta[ii] - (*data)->bottom[ii];
+            if ((*data)->dept[ii] <= param->min_dept)   {(*data)->dept[ii] = 0.0;}
+            update_face_depth(data, smap, param, ii);
+            if ((*data)->deptx[ii] < 0)    {(*data)->deptx[ii] = 0.0;}
+            if ((*data)->depty[ii] < 0)    {(*data)->depty[ii] = 0.0;}
+            if (subgrid == 0)   {subgrid_cell_variable(data, param, ii);}
+        }
+    }
+    // ghost cells
+    for (ii = param->n2ci; ii < param->n2ct; ii++)
+    {
+        (*data)->dept[ii] = (*data)->eta[ii] - (*data)->bottom[ii];
+        if ((*data)->dept[ii] <= param->min_dept)   {(*data)->dept[ii] = 0.0;}
+        (*data)->deptx[ii] = 0.0;
+        (*data)->depty[ii] = 0.0;
+    }
+    update_boundary_depth(data, smap, param);
+    for (ii = param->n2ci; ii < param->n2ct; ii++)
+    {
+        if ((*data)->deptx[ii] < 0)    {(*data)->deptx[ii] = 0.0;}
+        if ((*data)->depty[ii] < 0)    {(*data)->depty[ii] = 0.0;}
+    }
+    if (param->use_mpi == 1)
+    {
+        double *halo[3] = {(*data)->dept, (*data)->deptx, (*data)->depty};
+        mpi_exchange_surf_batch(halo, 3, smap, param, irank, nrank);
+    }
+    if (subgrid == 0)
+    {for (ii = param->n2ci; ii < param->n2ct; ii++)    {subgrid_cell_variable(data, param, ii);}}
+}
+
+// >>>>> Face volumes, cell volume, drag and velocity of every cell
+// volume_by_flux, update_drag_coef, waterfall_location and update_velocity up
+// to the limiters at xp/yp in one pass. Every cell reads the depths, volumes
+// and the old flow rates of its neighbors, which are not written here.
+void post_solve_velocity(Data **data, Map *smap, Config *param)
+{
+    int ii;
+    #pragma omp parallel for
+    for (ii = 0; ii < param->n2ci; ii++)
+    {
+        if (param->use_subgrid == 0)    {subgrid_face_variable(data, smap, ii);}
+        volume_by_flux_cell(data, smap, param, ii);
+        drag_coef_cell(data, param, ii);
+        waterfall_cell(data, smap, param, ii);
+        (*data)->un[ii] = (*data)->uu[ii];
+        (*data)->vn[ii] = (*data)->vv[ii];
+        velocity_cell(data, smap, param, ii);
+        velocity_limiter_p(data, param, ii);
+    }
+    for (ii = param->n2ci; ii < param->n2ct; ii++)
+    {
+        (*data)->un[ii] = (*data)->uu[ii];
+        (*data)->vn[ii] = (*data)->vv[ii];
+    }
+    if (param->use_subgrid == 0)    {subgrid_boundary_variable(data, smap, param);}
+    inflow_volume(data, param);
+}
+
+// >>>>> Limiters at xm/ym and flow rates over tiles of whole rows
+// The limiter of a cell writes the faces of its xm and ym neighbors, the flow
+// rates of a row are computed once the next row has been limited.
+void post_solve_flow_rate(Data **data, Map *smap, Config *param, int irank)
+{
+    int ii, j0, j1, lo, hi, rows;
+    rows = SW_TILE / param->nx;
+    if (rows < 1)   {rows = 1;}
+    #pragma omp parallel private(j0, j1, lo, hi)
+    for (j0 = 0; j0 < param->ny; j0 += rows)
+    {
+        j1 = j0 + rows;
+        if (j1 > param->ny) {j1 = param->ny;}
+        #pragma omp for
+        for (ii = j0*param->nx; ii < j1*param->nx; ii++)    {velocity_limiter_m(data, smap, param, ii);}
+        lo = j0 - 1;
+        if (j0 == 0)    {lo = 0;}
+        hi = j1 - 1;
+        if (j1 == param->ny)    {hi = param->ny;}
+        #pragma omp for
+        for (ii = lo*param->nx; ii < hi*param->nx; ii++)    {flow_rate_cell(data, smap, param, ii, irank);}
+    }
+}
+
 // >>>>> Momentum source term
 void momentum_source(Data **data, Map *smap, Config *param)
 {
     int ii;
     double advX, advY, difX, difY, facdx, facdy, velx, vely, gradp;
+    #pragma omp parallel for private(advX, advY, difX, difY, facdx, facdy, velx, vely, gradp)
     for (ii = 0; ii < param->n2ci; ii++)
     {
         // advection terms
@@ -290,13 +405,15 @@ void wind_source(Data **data, Map *smap, Config *param, int ii)
 void shallowwater_rhs(Data **data, Map *smap, Config *param)
 {
     int ii, jj, kk;
+    #pragma omp parallel for
     for (ii = 0; ii < param->n2ci; ii++)
     {
         (*data)->Srhs[ii] = (*data)->eta[ii] * (*data)->Asz[ii] - param->dt * \
             ((*data)->Asx[ii]*(*data)->Ex[ii] - (*data)->Asx[smap->iMjc[ii]]*(*data)->Ex[smap->iMjc[ii]] + \
             (*data)->Asy[ii]*(*data)->Ey[ii] - (*data)->Asy[smap->icjM[ii]]*(*data)->Ey[smap->icjM[ii]]);
     }
-    // inflow as a source term
+    // inflow as a source term, serial so that cells shared by several inflow
+    // locations always sum in the same order
     if (param->n_inflow > 0)
     {
         for (kk = 0; kk < param->n_inflow; kk++)
@@ -321,6 +438,7 @@ void shallowwater_mat_coeff(Data **data, Map *smap, Config *param, int irank, in
     else
     {coef = param->grav * param->dt;}
 
+    #pragma omp parallel for private(im, jm)
     for (ii = 0; ii < param->n2ci; ii++)
     {
         im = smap->iMjc[ii];
@@ -363,27 +481,27 @@ void shallowwater_mat_coeff(Data **data, Map *smap, Config *param, int irank, in
         {
             // outer boundary
             if (irank % param->mpi_nx == 0) {(*data)->Sct[ii] -= (*data)->Sxm[ii];}
-            // inner boundary (Dirichlet type)
-            else    {(*data)->Srhs[ii] += (*data)->Sxm[ii] * (*data)->eta[smap->iMjc[ii]];}
+            // inner boundary (Dirichlet type), coupled by shallowwater_halo for global solves
+            else if ((*data)->Spcg == NULL)  {(*data)->Srhs[ii] += (*data)->Sxm[ii] * (*data)->eta[smap->iMjc[ii]];}
         }
         else if (smap->ii[ii] == param->nx-1)
         {
             if (irank % param->mpi_nx == param->mpi_nx - 1) {(*data)->Sct[ii] -= (*data)->Sxp[ii];}
-            else {(*data)->Srhs[ii] += (*data)->Sxp[ii] * (*data)->eta[smap->iPjc[ii]];}
+            else if ((*data)->Spcg == NULL)  {(*data)->Srhs[ii] += (*data)->Sxp[ii] * (*data)->eta[smap->iPjc[ii]];}
         }
         // y-boundary
         if (smap->jj[ii] == 0)
         {
             if (irank < param->mpi_nx)  {(*data)->Sct[ii] -= (*data)->Sym[ii];}
-            else    {(*data)->Srhs[ii] += (*data)->Sym[ii] * (*data)->eta[smap->icjM[ii]];}
+            else if ((*data)->Spcg == NULL)  {(*data)->Srhs[ii] += (*data)->Sym[ii] * (*data)->eta[smap->icjM[ii]];}
         }
         else if (smap->jj[ii] == param->ny-1)
         {
             if (irank >= param->mpi_nx*(param->mpi_ny-1))   {(*data)->Sct[ii] -= (*data)->Syp[ii];}
-            else    {(*data)->Srhs[ii] += (*data)->Syp[ii] * (*data)->eta[smap->icjP[ii]];}
+            else if ((*data)->Spcg == NULL)  {(*data)->Srhs[ii] += (*data)->Syp[ii] * (*data)->eta[smap->icjP[ii]];}
         }
     }
-    // enforce tidal boundary condition
+    // enforce tidal boundary condition, serial so that the last tide wins
     for (kk = 0; kk < param->n_tide; kk++)
     {
         if ((*data)->tideloc[kk][0] != -1)
@@ -402,55 +520,151 @@ void shallowwater_mat_coeff(Data **data, Map *smap, Config *param, int irank, in
     }
 }
 
+// >>>>> Allocate the linear system and set its sparsity pattern
+void init_shallowwater_system(Data **data, Map *smap, Config *param, int irank, int nrank)
+{
+    size_t ii, jj, kk, pos[5];
+    int im, dist;
+    LinSys *sys;
+    init_solvelog(&(*data)->Slog);
+    // under MPI the ranks may solve one global system
+    (*data)->Spcg = NULL;
+    if (param->use_mpi == 1 & param->global_solve == 1)
+    {
+        init_parcg(&(*data)->Spcg, param->n2ci, param->n2ct, 2*(param->nx+param->ny), \
+            mpi_exchange_surf, smap, param, irank, nrank);
+        if (param->krylov_SW == 4)  {(*data)->Spcg->pipelined = 1;}
+    }
+    // the stencil solver works on Sct, Sxp, Sxm, Syp and Sym directly
+    if (param->use_stencil == 1)
+    {
+        init_stencil(&(*data)->Sst, param->nx, param->ny, -1.0, (*data)->Sct, \
+            (*data)->Sxp, (*data)->Sxm, (*data)->Syp, (*data)->Sym);
+        if (param->precond_SW == 1) {init_multigrid(&(*data)->Smg, (*data)->Sst);}
+        return;
+    }
+    init_linsys(&(*data)->Ssys, "As", param->n2ci);
+    sys = (*data)->Ssys;
+    sys->krylov = param->krylov_SW;
+    sys->maxiter = param->maxiter_SW;
+    sys->omega = param->omega_SW;
+    for (ii = 1; ii <= param->n2ci; ii++)
+    {
+        im = ii - 1;
+        kk = 0;
+        // ym
+        dist = im - smap->icjM[im];
+        if (ii-dist > 0 & ii-dist <= param->n2ci)  {pos[kk] = ii-dist;    kk++;}
+        // xm
+        dist = im - smap->iMjc[im];
+        if (ii-dist > 0 & ii-dist <= param->n2ci)  {pos[kk] = ii-dist;    kk++;}
+        // ct
+        pos[kk] = ii;
+        kk++;
+        // xp
+        dist = smap->iPjc[im] - im;
+        if (ii+dist > 0 & ii+dist <= param->n2ci)  {pos[kk] = ii+dist;    kk++;}
+        // yp
+        dist = smap->icjP[im] - im;
+        if (ii+dist > 0 & ii+dist <= param->n2ci)  {pos[kk] = ii+dist;    kk++;}
+        Q_SetLen(&sys->A, ii, kk);
+        for (jj = 0; jj < kk; jj++)
+        {
+            if (pos[jj] == ii)  {Q_SetEntry(&sys->A, ii, jj, pos[jj], 1.0);}
+            else    {Q_SetEntry(&sys->A, ii, jj, pos[jj], 0.0);}
+        }
+    }
+    linsys_pattern_done(sys);
+    linsys_mixed(sys, param->mixed_SW);
+    if (param->krylov_SW == 5)  {init_deflate(&sys->defl, sys->dim, param->deflate_SW);}
+    if (param->precond_SW == 2) {init_ilu(&sys->ilu, &sys->A, param->ilu_drift);}
+    else if (param->precond_SW == 3)    {init_mcssor(&sys->color, &sys->A);}
+}
+
+// >>>>> Couplings to the ghost cells of the neighbor ranks
+// Faces on the outer boundary are handled by shallowwater_mat_coeff
+void shallowwater_halo(Data *data, Map *smap, Config *param, ParCG *cg, int irank)
+{
+    int ii;
+    parcg_reset(cg);
+    for (ii = 0; ii < param->n2ci; ii++)
+    {
+        if (smap->ii[ii] == 0 & irank % param->mpi_nx != 0)
+        {parcg_couple(cg, ii, smap->iMjc[ii], -data->Sxm[ii]);}
+        if (smap->ii[ii] == param->nx-1 & irank % param->mpi_nx != param->mpi_nx - 1)
+        {parcg_couple(cg, ii, smap->iPjc[ii], -data->Sxp[ii]);}
+        if (smap->jj[ii] == 0 & irank >= param->mpi_nx)
+        {parcg_couple(cg, ii, smap->icjM[ii], -data->Sym[ii]);}
+        if (smap->jj[ii] == param->ny-1 & irank < param->mpi_nx*(param->mpi_ny-1))
+        {parcg_couple(cg, ii, smap->icjP[ii], -data->Syp[ii]);}
+    }
+}
+
 // >>>>> Setup the linear system of equations
-void build_shallowwater_system(Data *data, Map *smap, Config *param, QMatrix A, Vector b)
+// The pattern is fixed by init_shallowwater_system, only values are updated here
+void build_shallowwater_system(Data *data, Map *smap, Config *param, LinSys *sys)
 {
-    size_t ii, jj, kk, n;
+    size_t ii, kk;
     int im, dist;
+    ElType *row;
     for (ii = 1; ii <= param->n2ci; ii++)
     {
         im = ii - 1;
         kk = 0;
-        n = 5;
-        if (smap->ii[im] == 0)  {n -= 1;}
-        if (smap->ii[im] == param->nx-1)    {n -= 1;}
-        if (smap->jj[im] == 0)  {n -= 1;}
-        if (smap->jj[im] == param->ny-1)    {n -= 1;}
-        Q_SetLen(&A, ii, n);
+        row = sys->A.El[ii];
         // ym
         dist = im - smap->icjM[im];
         if (ii-dist > 0 & ii-dist <= param->n2ci)
-        {Q_SetEntry(&A, ii, kk, ii-dist, -data->Sym[im]);    kk++;}
+        {row[kk].Val = -data->Sym[im];    kk++;}
         // xm
         dist = im - smap->iMjc[im];
         if (ii-dist > 0 & ii-dist <= param->n2ci)
-        {Q_SetEntry(&A, ii, kk, ii-dist, -data->Sxm[im]);    kk++;}
+        {row[kk].Val = -data->Sxm[im];    kk++;}
         // ct
-        Q_SetEntry(&A, ii, kk, ii, data->Sct[im]);
+        row[kk].Val = data->Sct[im];
         kk++;
         // xp
         dist = smap->iPjc[im] - im;
         if (ii+dist > 0 & ii+dist <= param->n2ci)
-        {Q_SetEntry(&A, ii, kk, ii+dist, -data->Sxp[im]);    kk++;}
+        {row[kk].Val = -data->Sxp[im];    kk++;}
         // yp
         dist = smap->icjP[im] - im;
         if (ii+dist > 0 & ii+dist <= param->n2ci)
-        {Q_SetEntry(&A, ii, kk, ii+dist, -data->Syp[im]);    kk++;}
+        {row[kk].Val = -data->Syp[im];    kk++;}
         // rhs
-        V_SetCmp(&b, ii, data->Srhs[im]);
+        V__SetCmp(&sys->b, ii, data->Srhs[im]);
     }
-
+    linsys_update_diag(sys);
 }
 
 // >>>>> Solve the shallow water system
-void solve_shallowwater_system(Data **data, Map *smap, QMatrix A, Vector b, Vector x, Config *param)
+void solve_shallowwater_system(Data **data, Map *smap, LinSys *sys, Config *param)
 {
     size_t ii;
+    double eps = param->tol_SW * param->tol_fac;
+    ParCG *cg = (*data)->Spcg;
+    double t0 = omp_get_wtime(), t1;
 
-    V_SetAllCmp(&x, 0.0);
-    SetRTCAccuracy(0.00000001);
-    CGIter(&A, &x, &b, 10000000, SSORPrecond, 1);
-    for (ii = 0; ii < param->n2ci; ii++)    {(*data)->eta[ii] = V_GetCmp(&x, ii+1);}
+    (*data)->Slog->setup = 0.0;
+    if (cg == NULL)
+    {
+        linsys_solve(sys, (*data)->Slog, param->warm_start, param->dt, eps);
+        for (ii = 0; ii < param->n2ci; ii++)    {(*data)->eta[ii] = V__GetCmp(&sys->x, ii+1);}
+    }
+    else
+    {
+        // global solve over all ranks, eta carries the ghost cells
+        warm_start(sys->x.Cmp+1, sys->xprev, sys->dim, param->warm_start, (*data)->Slog, param->dt);
+        for (ii = 0; ii < param->n2ci; ii++)    {(*data)->eta[ii] = V__GetCmp(&sys->x, ii+1);}
+        t1 = omp_get_wtime();
+        linsys_setup_precond(sys);
+        (*data)->Slog->setup = omp_get_wtime() - t1;
+        parcg_solve(cg, linsys_apply, sys, linsys_precond, sys, (*data)->eta, sys->b.Cmp+1, eps, param->maxiter_SW);
+        for (ii = 0; ii < param->n2ci; ii++)    {V__SetCmp(&sys->x, ii+1, (*data)->eta[ii]);}
+        (*data)->Slog->res0 = cg->res0;
+        log_solve((*data)->Slog, cg->iter, cg->acc, eps);
+    }
+    log_time((*data)->Slog, t0);
     // for (ii = 0; ii < param->n2ci; ii++)
     // {
     //     // if (smap->ii[ii] == 100 & smap->jj[ii] > 176 & smap->jj[ii] < 179)
@@ -462,6 +676,44 @@ void solve_shallowwater_system(Data **data, Map *smap, QMatrix A, Vector b, Vect
     // }
 }
 
+// >>>>> Solve the shallow water system with the matrix-free stencil operator
+void solve_shallowwater_stencil(Data **data, Map *smap, Stencil *st, Config *param)
+{
+    double eps = param->tol_SW * param->tol_fac;
+    ParCG *cg = (*data)->Spcg;
+    double t0 = omp_get_wtime(), t1;
+    (*data)->Slog->setup = 0.0;
+    // eta still holds the previous solution here
+    warm_start((*data)->eta, st->xprev, param->n2ci, param->warm_start, (*data)->Slog, param->dt);
+    if (cg != NULL)
+    {
+        // global solve over all ranks, preconditioned on the block of this rank
+        if (param->precond_SW == 1)
+        {
+            t1 = omp_get_wtime();
+            multigrid_setup((*data)->Smg);
+            (*data)->Slog->setup = omp_get_wtime() - t1;
+            parcg_solve(cg, stencil_apply, st, multigrid_precond, (*data)->Smg, (*data)->eta, (*data)->Srhs, eps, param->maxiter_SW);
+        }
+        else
+        {
+            st->omega = param->omega_SW;
+            stencil_update_diag(st);
+            parcg_solve(cg, stencil_apply, st, stencil_precond, st, (*data)->eta, (*data)->Srhs, eps, param->maxiter_SW);
+        }
+        st->res0 = cg->res0;
+        st->acc = cg->acc;
+        st->iter = cg->iter;
+    }
+    else if (param->precond_SW == 1)
+    {multigrid_pcg((*data)->Smg, (*data)->eta, (*data)->Srhs, eps, param->maxiter_SW);}
+    else
+    {stencil_cg(st, (*data)->eta, (*data)->Srhs, eps, param->maxiter_SW, param->omega_SW);}
+    (*data)->Slog->res0 = st->res0;
+    log_solve((*data)->Slog, st->iter, st->acc, eps);
+    log_time((*data)->Slog, t0);
+}
+
 // >>>>> Enforce boundary condition for free surface
 void enforce_surf_bc(Data **data, Map *smap, Config *param, int irank, int nrank)
 {
@@ -508,7 +760,8 @@ void cfl_limiter(Data **data, Map *smap, Config *param)
 {
     int ii, wet;
     double diff;
-    // restrict wetting within 1 cell
+    // restrict wetting within 1 cell, only the depth of the neighbors is read
+    #pragma omp parallel for private(diff, wet)
     for (ii = 0; ii < param->n2ci; ii++)
     {
         diff = (*data)->eta[ii] - (*data)->bottom[ii];
@@ -530,6 +783,7 @@ void cfl_limiter(Data **data, Map *smap, Config *param)
         }
     }
     // remove small depth
+    #pragma omp parallel for private(diff)
     for (ii = 0; ii < param->n2ci; ii++)
     {
         diff = (*data)->eta[ii] - (*data)->bottom[ii];
@@ -577,22 +831,22 @@ void subsurface_source(Data **data, Map *smap, Config *param)
     int ii;
     double diff, qz;
     // NOTE: seepage is calculated in the subsurface framework
-    //       to convert it into the surface framework, multiple by param->wcs
+    //       to convert it into the surface framework, multiple by wcs of the top cell
     for (ii = 0; ii < param->n2ci; ii++)
     {
         diff = (*data)->eta[ii] - (*data)->bottom[ii];
         // infiltration
         if ((*data)->qseepage[ii] < 0)
         {
-            (*data)->eta[ii] += (*data)->qseepage[ii] * param->dt * param->wcs;
+            (*data)->eta[ii] += (*data)->qseepage[ii] * param->dt * (*data)->wcs_top[ii];
             (*data)->reset_seepage[ii] = 1;
         }
         // seepage
         else
         {
-            if ((*data)->qseepage[ii]*param->dt*param->wcs > param->min_dept)
+            if ((*data)->qseepage[ii]*param->dt*(*data)->wcs_top[ii] > param->min_dept)
             {
-                (*data)->eta[ii] += (*data)->qseepage[ii] * param->dt * param->wcs;
+                (*data)->eta[ii] += (*data)->qseepage[ii] * param->dt * (*data)->wcs_top[ii];
                 (*data)->reset_seepage[ii] = 1;
             }
             else
@@ -605,153 +859,181 @@ void subsurface_source(Data **data, Map *smap, Config *param)
 void waterfall_location(Data **data, Map *smap, Config *param)
 {
     int ii;
+    #pragma omp parallel for
+    for (ii = 0; ii < param->n2ci; ii++)    {waterfall_cell(data, smap, param, ii);}
+}
+
+// >>>>> waterfall location of one cell, a waterfall at xm/ym overrides xp/yp
+void waterfall_cell(Data **data, Map *smap, Config *param, int ii)
+{
     double facd;
-    for (ii = 0; ii < param->n2ci; ii++)
-    {
-        (*data)->wtfx[ii] = 0;
-        (*data)->wtfy[ii] = 0;
-    }
+    (*data)->wtfx[ii] = 0;
+    (*data)->wtfy[ii] = 0;
     // wtf on xp and yp
-    for (ii = 0; ii < param->n2ci; ii++)
-    {
-        facd = (*data)->eta[smap->iPjc[ii]] - (*data)->bottomXP[ii];
-        if ((*data)->eta[ii] < (*data)->bottomXP[ii] & facd > param->wtfh)
-        {(*data)->wtfx[ii] = -1;}
-        facd = (*data)->eta[smap->icjP[ii]] - (*data)->bottomYP[ii];
-        if ((*data)->eta[ii] < (*data)->bottomYP[ii] & facd > param->wtfh)
-        {(*data)->wtfy[ii] = -1;}
-    }
+    facd = (*data)->eta[smap->iPjc[ii]] - (*data)->bottomXP[ii];
+    if ((*data)->eta[ii] < (*data)->bottomXP[ii] & facd > param->wtfh)
+    {(*data)->wtfx[ii] = -1;}
+    facd = (*data)->eta[smap->icjP[ii]] - (*data)->bottomYP[ii];
+    if ((*data)->eta[ii] < (*data)->bottomYP[ii] & facd > param->wtfh)
+    {(*data)->wtfy[ii] = -1;}
     // wtf on xm and ym
-    for (ii = 0; ii < param->n2ci; ii++)
-    {
-        facd = (*data)->eta[smap->iMjc[ii]] - (*data)->bottomXP[smap->iMjc[ii]];
-        if ((*data)->eta[ii] < (*data)->bottomXP[smap->iMjc[ii]] & facd > param->wtfh)
-        {(*data)->wtfx[ii] = 1;}
-        facd = (*data)->eta[smap->icjM[ii]] - (*data)->bottomYP[smap->icjM[ii]];
-        if ((*data)->eta[ii] < (*data)->bottomYP[smap->icjM[ii]] & facd > param->wtfh)
-        {(*data)->wtfy[ii] = 1;}
-    }
+    facd = (*data)->eta[smap->iMjc[ii]] - (*data)->bottomXP[smap->iMjc[ii]];
+    if ((*data)->eta[ii] < (*data)->bottomXP[smap->iMjc[ii]] & facd > param->wtfh)
+    {(*data)->wtfx[ii] = 1;}
+    facd = (*data)->eta[smap->icjM[ii]] - (*data)->bottomYP[smap->icjM[ii]];
+    if ((*data)->eta[ii] < (*data)->bottomYP[smap->icjM[ii]] & facd > param->wtfh)
+    {(*data)->wtfy[ii] = 1;}
 }
 
 // >>>>> update face velocity
 void update_velocity(Data **data, Map *smap, Config *param, int irank)
 {
-    int ii, count;
-    double effhx, effhy, coef, gradp, velx, vely, velo, epsu, epsv, facdx, facdy;
-    coef = param->grav * param->dt;
+    int ii;
     // save velocity at previous time step
+    #pragma omp parallel for
     for (ii = 0; ii < param->n2ct; ii++)
     {
         (*data)->un[ii] = (*data)->uu[ii];
         (*data)->vn[ii] = (*data)->vv[ii];
     }
-    // update new velocity
+    // update new velocity and apply various velocity limiters
+    // The limiters only set velocities to zero, so the result does not depend
+    // on the order of the cells. The faces at xp/yp of a cell are limited with
+    // its new velocity, the faces at xm/ym in a second pass, every face is
+    // written by one cell per pass.
+    #pragma omp parallel for
     for (ii = 0; ii < param->n2ci; ii++)
     {
-        (*data)->uu[ii] = 0.0;
-        (*data)->vv[ii] = 0.0;
-        if ((*data)->Vsx[ii] > 0)   {effhx = (*data)->Asx[ii] / (*data)->Vsx[ii];}
-        else {effhx = 0.0;}
-        if ((*data)->Vsy[ii] > 0)   {effhy = (*data)->Asy[ii] / (*data)->Vsy[ii];}
-        else {effhy = 0.0;}
-        if (param->difuwave == 0)
-        {
-            // ignore drag inversion for velocity update -- consistent with Frehd
-            // (*data)->uu[ii] = ((*data)->Ex[ii] - coef * effhx * ((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]));
-            // (*data)->vv[ii] = ((*data)->Ey[ii] - coef * effhy * ((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]));
+        velocity_cell(data, smap, param, ii);
+        velocity_limiter_p(data, param, ii);
+    }
+    #pragma omp parallel for
+    for (ii = 0; ii < param->n2ci; ii++)    {velocity_limiter_m(data, smap, param, ii);}
+    // update flow rates
+    #pragma omp parallel for
+    for (ii = 0; ii < param->n2ci; ii++)    {flow_rate_cell(data, smap, param, ii, irank);}
 
-            (*data)->uu[ii] = ((*data)->Ex[ii] - coef * effhx * ((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii])) * (*data)->Dx[ii];
-            (*data)->vv[ii] = ((*data)->Ey[ii] - coef * effhy * ((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii])) * (*data)->Dy[ii];
+}
 
-            // (*data)->uu[ii] = ((*data)->Ex[ii] - coef * effhx * ((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]));
-            // (*data)->vv[ii] = ((*data)->Ey[ii] - coef * effhy * ((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]));
-        }
-        else
-        {
-            facdx = 0.0;
-            facdy = 0.0;
-            // if ((*data)->Vsx[ii] > 0.0) {facdx = (*data)->Aszx[ii]/(*data)->Vsx[ii];}
-            // if ((*data)->Vsy[ii] > 0.0) {facdy = (*data)->Aszy[ii]/(*data)->Vsy[ii];}
-            if ((*data)->Aszx[ii] > 0.0) {facdx = (*data)->Vsx[ii]/(*data)->Aszx[ii];}
-            if ((*data)->Aszy[ii] > 0.0) {facdy = (*data)->Vsy[ii]/(*data)->Aszy[ii];}
-            gradp = 0.0;
-            if ((*data)->eta[smap->iPjc[ii]] > (*data)->eta[ii] & (*data)->dept[smap->iPjc[ii]] > 0.0)
-            {gradp += pow(((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]) / param->dx, 2.0);}
-            else if ((*data)->eta[smap->iPjc[ii]] < (*data)->eta[ii] & (*data)->dept[ii] > 0.0)
-            {gradp += pow(((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]) / param->dx, 2.0);}
-            if ((*data)->eta[smap->icjP[ii]] > (*data)->eta[ii] & (*data)->dept[smap->icjP[ii]] > 0.0)
-            {gradp += pow(((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]) / param->dy, 2.0);}
-            else if ((*data)->eta[smap->icjP[ii]] < (*data)->eta[ii] & (*data)->dept[ii] > 0.0)
-            {gradp += pow(((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]) / param->dy, 2.0);}
-            gradp = pow(gradp, 0.5);
+// >>>>> new velocity at the xp and yp faces of one cell
+void velocity_cell(Data **data, Map *smap, Config *param, int ii)
+{
+    double effhx, effhy, coef, gradp, velx, vely, facdx, facdy;
+    coef = param->grav * param->dt;
+    (*data)->uu[ii] = 0.0;
+    (*data)->vv[ii] = 0.0;
+    if ((*data)->Vsx[ii] > 0)   {effhx = (*data)->Asx[ii] / (*data)->Vsx[ii];}
+    else {effhx = 0.0;}
+    if ((*data)->Vsy[ii] > 0)   {effhy = (*data)->Asy[ii] / (*data)->Vsy[ii];}
+    else {effhy = 0.0;}
+    if (param->difuwave == 0)
+    {
+        // ignore drag inversion for velocity update -- consistent with Frehd
+        // (*data)->uu[ii] = ((*data)->Ex[ii] - coef * effhx * ((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]));
+        // (*data)->vv[ii] = ((*data)->Ey[ii] - coef * effhy * ((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]));
 
-            // avoid gradp being too small
-            if (gradp < param->min_dept / param->dx)
-            {gradp = param->min_dept / param->dx;}
+        (*data)->uu[ii] = ((*data)->Ex[ii] - coef * effhx * ((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii])) * (*data)->Dx[ii];
+        (*data)->vv[ii] = ((*data)->Ey[ii] - coef * effhy * ((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii])) * (*data)->Dy[ii];
 
-            // velx = sqrt((*data)->uu[ii]*(*data)->uu[ii] + (*data)->vx[ii]*(*data)->vx[ii]);
-            // vely = sqrt((*data)->uy[ii]*(*data)->uy[ii] + (*data)->vv[ii]*(*data)->vv[ii]);
+        // (*data)->uu[ii] = ((*data)->Ex[ii] - coef * effhx * ((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]));
+        // (*data)->vv[ii] = ((*data)->Ey[ii] - coef * effhy * ((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]));
+    }
+    else
+    {
+        facdx = 0.0;
+        facdy = 0.0;
+        // if ((*data)->Vsx[ii] > 0.0) {facdx = (*data)->Aszx[ii]/(*data)->Vsx[ii];}
+        // if ((*data)->Vsy[ii] > 0.0) {facdy = (*data)->Aszy[ii]/(*data)->Vsy[ii];}
+        if ((*data)->Aszx[ii] > 0.0) {facdx = (*data)->Vsx[ii]/(*data)->Aszx[ii];}
+        if ((*data)->Aszy[ii] > 0.0) {facdy = (*data)->Vsy[ii]/(*data)->Aszy[ii];}
+        gradp = 0.0;
+        if ((*data)->eta[smap->iPjc[ii]] > (*data)->eta[ii] & (*data)->dept[smap->iPjc[ii]] > 0.0)
+        {gradp += pow(((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]) / param->dx, 2.0);}
+        else if ((*data)->eta[smap->iPjc[ii]] < (*data)->eta[ii] & (*data)->dept[ii] > 0.0)
+        {gradp += pow(((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]) / param->dx, 2.0);}
+        if ((*data)->eta[smap->icjP[ii]] > (*data)->eta[ii] & (*data)->dept[smap->icjP[ii]] > 0.0)
+        {gradp += pow(((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]) / param->dy, 2.0);}
+        else if ((*data)->eta[smap->icjP[ii]] < (*data)->eta[ii] & (*data)->dept[ii] > 0.0)
+        {gradp += pow(((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]) / param->dy, 2.0);}
+        gradp = pow(gradp, 0.5);
 
-            velx = pow(2.0 * param->grav * gradp * facdx / (*data)->CDx[ii], 0.5);
-            vely = pow(2.0 * param->grav * gradp * facdy / (*data)->CDy[ii], 0.5);
+        // avoid gradp being too small
+        if (gradp < param->min_dept / param->dx)
+        {gradp = param->min_dept / param->dx;}
 
-            if (velx != 0.0 & facdx != 0.0 & (*data)->CDx[ii] != 0.0)
-            {(*data)->Dx[ii] = facdx / (0.5 * (*data)->CDx[ii] * velx);}
-            else
-            {(*data)->Dx[ii] = 1.0;}
-            if (vely != 0.0 & facdy != 0.0 & (*data)->CDy[ii] != 0.0)
-            {(*data)->Dy[ii] = facdy / (0.5 * (*data)->CDy[ii] * vely);}
-            else
-            {(*data)->Dy[ii] = 1.0;}
-            // limiter on D
-            // if ((*data)->Dx[ii] > param->dt)    {(*data)->Dx[ii] = param->dt;}
-            // if ((*data)->Dy[ii] > param->dt)    {(*data)->Dy[ii] = param->dt;}
+        // velx = sqrt((*data)->uu[ii]*(*data)->uu[ii] + (*data)->vx[ii]*(*data)->vx[ii]);
+        // vely = sqrt((*data)->uy[ii]*(*data)->uy[ii] + (*data)->vv[ii]*(*data)->vv[ii]);
 
-            (*data)->uu[ii] = - param->grav * effhx * ((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]) * (*data)->Dx[ii];
-            (*data)->vv[ii] = - param->grav * effhy * ((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]) * (*data)->Dy[ii];
-        }
+        velx = pow(2.0 * param->grav * gradp * facdx / (*data)->CDx[ii], 0.5);
+        vely = pow(2.0 * param->grav * gradp * facdy / (*data)->CDy[ii], 0.5);
+
+        if (velx != 0.0 & facdx != 0.0 & (*data)->CDx[ii] != 0.0)
+        {(*data)->Dx[ii] = facdx / (0.5 * (*data)->CDx[ii] * velx);}
+        else
+        {(*data)->Dx[ii] = 1.0;}
+        if (vely != 0.0 & facdy != 0.0 & (*data)->CDy[ii] != 0.0)
+        {(*data)->Dy[ii] = facdy / (0.5 * (*data)->CDy[ii] * vely);}
+        else
+        {(*data)->Dy[ii] = 1.0;}
+        // limiter on D
+        // if ((*data)->Dx[ii] > param->dt)    {(*data)->Dx[ii] = param->dt;}
+        // if ((*data)->Dy[ii] > param->dt)    {(*data)->Dy[ii] = param->dt;}
 
+        (*data)->uu[ii] = - param->grav * effhx * ((*data)->eta[smap->iPjc[ii]] - (*data)->eta[ii]) * (*data)->Dx[ii];
+        (*data)->vv[ii] = - param->grav * effhy * ((*data)->eta[smap->icjP[ii]] - (*data)->eta[ii]) * (*data)->Dy[ii];
     }
-    // apply various velocity limiters
-    for (ii = 0; ii < param->n2ci; ii++)
+}
+
+// >>>>> limit the velocity at the xp and yp faces of one cell
+void velocity_limiter_p(Data **data, Config *param, int ii)
+{
+    // zero velocity when face area is zero
+    if ((*data)->Asx[ii] < param->wtfh*param->dy) {(*data)->uu[ii] = 0.0;}
+    if ((*data)->Asy[ii] < param->wtfh*param->dx) {(*data)->vv[ii] = 0.0;}
+    // zero velocity out of a dry cell
+    if ((*data)->dept[ii] < param->wtfh)
     {
-        // zero velocity when face area is zero
-        if ((*data)->Asx[ii] < param->wtfh*param->dy) {(*data)->uu[ii] = 0.0;}
-        if ((*data)->Asy[ii] < param->wtfh*param->dx) {(*data)->vv[ii] = 0.0;}
-        // zero velocity out of a dry cell
-        if ((*data)->dept[ii] < param->wtfh)
-        {
-            if ((*data)->uu[ii] > 0)    {(*data)->uu[ii] = 0.0;}
-            if ((*data)->uu[smap->iMjc[ii]] < 0)    {(*data)->uu[smap->iMjc[ii]] = 0.0;}
-            if ((*data)->vv[ii] > 0)    {(*data)->vv[ii] = 0.0;}
-            if ((*data)->vv[smap->icjM[ii]] < 0)    {(*data)->vv[smap->icjM[ii]] = 0.0;}
-        }
-        // apply the cfl limiter
-        if ((*data)->cfl_active[ii] == 1)
-        {
-            (*data)->uu[ii] = 0.0;
-            (*data)->uu[smap->iMjc[ii]] = 0.0;
-            (*data)->vv[ii] = 0.0;
-            (*data)->vv[smap->icjM[ii]] = 0.0;
-            (*data)->cfl_active[ii] = 0;
-        }
+        if ((*data)->uu[ii] > 0)    {(*data)->uu[ii] = 0.0;}
+        if ((*data)->vv[ii] > 0)    {(*data)->vv[ii] = 0.0;}
     }
-    // update flow rates
-    for (ii = 0; ii < param->n2ci; ii++)
+    // apply the cfl limiter
+    if ((*data)->cfl_active[ii] == 1)
     {
-        (*data)->Fu[ii] = (*data)->uu[ii] * (*data)->Asx[ii];
-        (*data)->Fv[ii] = (*data)->vv[ii] * (*data)->Asy[ii];
-        (*data)->cflx[ii] = fabs((*data)->uu[ii] * param->dt / param->dx);
-        (*data)->cfly[ii] = fabs((*data)->vv[ii] * param->dt / param->dy);
-        if ((*data)->cflx[ii] > 1 | (*data)->cfly[ii] > 1)
-        {printf("WARNING: CFL = %f, %f for cell (%d,%d) of rank %d!\n",(*data)->cflx[ii],(*data)->cfly[ii],smap->ii[ii],smap->jj[ii],irank);}
-        // if (smap->ii[ii] == 1 & smap->jj[ii] == 1)
-        // {
-        //     printf("  SURFACE AF: jj=%d, vv=%f, dept=%f, seepage=%f\n\n",smap->jj[ii],(*data)->vv[ii],(*data)->dept[ii],
-        //         (*data)->qseepage[ii]*param->dt*param->wcs);
-        // }
+        (*data)->uu[ii] = 0.0;
+        (*data)->vv[ii] = 0.0;
     }
+}
 
+// >>>>> limit the velocity at the xm and ym faces of one cell
+void velocity_limiter_m(Data **data, Map *smap, Config *param, int ii)
+{
+    if ((*data)->dept[ii] < param->wtfh)
+    {
+        if ((*data)->uu[smap->iMjc[ii]] < 0)    {(*data)->uu[smap->iMjc[ii]] = 0.0;}
+        if ((*data)->vv[smap->icjM[ii]] < 0)    {(*data)->vv[smap->icjM[ii]] = 0.0;}
+    }
+    if ((*data)->cfl_active[ii] == 1)
+    {
+        (*data)->uu[smap->iMjc[ii]] = 0.0;
+        (*data)->vv[smap->icjM[ii]] = 0.0;
+        (*data)->cfl_active[ii] = 0;
+    }
+}
+
+// >>>>> flow rates and cfl number at the xp and yp faces of one cell
+void flow_rate_cell(Data **data, Map *smap, Config *param, int ii, int irank)
+{
+    (*data)->Fu[ii] = (*data)->uu[ii] * (*data)->Asx[ii];
+    (*data)->Fv[ii] = (*data)->vv[ii] * (*data)->Asy[ii];
+    (*data)->cflx[ii] = fabs((*data)->uu[ii] * param->dt / param->dx);
+    (*data)->cfly[ii] = fabs((*data)->vv[ii] * param->dt / param->dy);
+    if ((*data)->cflx[ii] > 1 | (*data)->cfly[ii] > 1)
+    {printf("WARNING: CFL = %f, %f for cell (%d,%d) of rank %d!\n",(*data)->cflx[ii],(*data)->cfly[ii],smap->ii[ii],smap->jj[ii],irank);}
+    // if (smap->ii[ii] == 1 & smap->jj[ii] == 1)
+    // {
+    //     printf("  SURFACE AF: jj=%d, vv=%f, dept=%f, seepage=%f\n\n",smap->jj[ii],(*data)->vv[ii],(*data)->dept[ii],
+    //         (*data)->qseepage[ii]*param->dt*param->wcs);
+    // }
 }
 
 // >>>>> correct velocity for waterfall
@@ -882,6 +1164,7 @@ void enforce_velo_bc(Data **data, Map *smap, Config *param, int irank, int nrank
 void interp_velocity(Data **data, Map *smap, Config *param)
 {
     int ii;
+    #pragma omp parallel for
     for (ii = 0; ii < param->n2ci; ii++)
     {
         (*data)->uy[ii] = 0.25 * ((*data)->uu[ii] + (*data)->uu[smap->iMjc[ii]] + \
@@ -894,20 +1177,23 @@ void interp_velocity(Data **data, Map *smap, Config *param)
 // >>>>> update drag coefficient
 void update_drag_coef(Data **data, Config *param)
 {
-    double coef, effh, expo, kk = 0.41;
     int ii;
+    for (ii = 0; ii < param->n2ci; ii++)    {drag_coef_cell(data, param, ii);}
+}
+
+// >>>>> drag coefficient of one cell
+void drag_coef_cell(Data **data, Config *param, int ii)
+{
+    double coef, effh, expo;
     coef = param->grav * param->manning * param->manning;
-    for (ii = 0; ii < param->n2ci; ii++)
+    if ((*data)->Vs[ii] > 0.0)
     {
-        if ((*data)->Vs[ii] > 0.0)
-        {
-            effh = (*data)->Vs[ii] / (param->dx * param->dy);
-            // apply the thin-layer drag model
-            if (effh < param->hD)   {expo = 2.0 / 3.0;}
-            else    {expo = 1.0 / 3.0;}
-            (*data)->CDx[ii] = coef / pow(effh, expo);
-            (*data)->CDy[ii] = coef / pow(effh, expo);
-        }
+        effh = (*data)->Vs[ii] / (param->dx * param->dy);
+        // apply the thin-layer drag model
+        if (effh < param->hD)   {expo = 2.0 / 3.0;}
+        else    {expo = 1.0 / 3.0;}
+        (*data)->CDx[ii] = coef / pow(effh, expo);
+        (*data)->CDy[ii] = coef / pow(effh, expo);
     }
 }
 
@@ -921,82 +1207,95 @@ void update_subgrid_variable(Data **data, Map *smap, Config *param)
     }
     else
     {
-        for (ii = 0; ii < param->n2ct; ii++)
-        {
-            (*data)->Vsn[ii] = (*data)->Vs[ii];
-            (*data)->Vs[ii] = (*data)->dept[ii] * param->dx * param->dy;
-            if ((*data)->dept[ii] > 0) {(*data)->Asz[ii] = param->dx * param->dy;}
-            else    {(*data)->Asz[ii] = 0.0;}
-            (*data)->Asx[ii] = (*data)->deptx[ii] * param->dy;
-            (*data)->Asy[ii] = (*data)->depty[ii] * param->dx;
-            if (param->nx == 1) {(*data)->Asx[ii] = 0.0;}
-            if (param->ny == 1) {(*data)->Asy[ii] = 0.0;}
-        }
-        for (ii = 0; ii < param->n2ci; ii++)
-        {
-            (*data)->Vsx[ii] = 0.5 * ((*data)->Vs[ii] + (*data)->Vs[smap->iPjc[ii]]);
-            (*data)->Vsy[ii] = 0.5 * ((*data)->Vs[ii] + (*data)->Vs[smap->icjP[ii]]);
-            (*data)->Aszx[ii] = 0.5 * ((*data)->Asz[ii] + (*data)->Asz[smap->iPjc[ii]]);
-            (*data)->Aszy[ii] = 0.5 * ((*data)->Asz[ii] + (*data)->Asz[smap->icjP[ii]]);
-        }
-        for (ii = 0; ii < param->nx; ii++)
-        {
-            (*data)->Vsy[smap->jMou[ii]] = (*data)->Vs[smap->jMin[ii]];
-            (*data)->Aszy[smap->jMou[ii]] = (*data)->Asz[smap->jMin[ii]];
-        }
-        for (ii = 0; ii < param->ny; ii++)
-        {
-            (*data)->Vsx[smap->iMou[ii]] = (*data)->Vs[smap->iMin[ii]];
-            (*data)->Aszx[smap->iMou[ii]] = (*data)->Asz[smap->iMin[ii]];
-        }
+        for (ii = 0; ii < param->n2ct; ii++)    {subgrid_cell_variable(data, param, ii);}
+        for (ii = 0; ii < param->n2ci; ii++)    {subgrid_face_variable(data, smap, ii);}
+        subgrid_boundary_variable(data, smap, param);
+    }
+}
+
+// >>>>> volume and areas of one cell from its depths
+void subgrid_cell_variable(Data **data, Config *param, int ii)
+{
+    (*data)->Vsn[ii] = (*data)->Vs[ii];
+    (*data)->Vs[ii] = (*data)->dept[ii] * param->dx * param->dy;
+    if ((*data)->dept[ii] > 0) {(*data)->Asz[ii] = param->dx * param->dy;}
+    else    {(*data)->Asz[ii] = 0.0;}
+    (*data)->Asx[ii] = (*data)->deptx[ii] * param->dy;
+    (*data)->Asy[ii] = (*data)->depty[ii] * param->dx;
+    if (param->nx == 1) {(*data)->Asx[ii] = 0.0;}
+    if (param->ny == 1) {(*data)->Asy[ii] = 0.0;}
+}
+
+// >>>>> face volume and area at xp and yp of one internal cell
+void subgrid_face_variable(Data **data, Map *smap, int ii)
+{
+    (*data)->Vsx[ii] = 0.5 * ((*data)->Vs[ii] + (*data)->Vs[smap->iPjc[ii]]);
+    (*data)->Vsy[ii] = 0.5 * ((*data)->Vs[ii] + (*data)->Vs[smap->icjP[ii]]);
+    (*data)->Aszx[ii] = 0.5 * ((*data)->Asz[ii] + (*data)->Asz[smap->iPjc[ii]]);
+    (*data)->Aszy[ii] = 0.5 * ((*data)->Asz[ii] + (*data)->Asz[smap->icjP[ii]]);
+}
+
+// >>>>> face volume and area at the xm and ym ghost cells
+void subgrid_boundary_variable(Data **data, Map *smap, Config *param)
+{
+    int ii;
+    for (ii = 0; ii < param->nx; ii++)
+    {
+        (*data)->Vsy[smap->jMou[ii]] = (*data)->Vs[smap->jMin[ii]];
+        (*data)->Aszy[smap->jMou[ii]] = (*data)->Asz[smap->jMin[ii]];
+    }
+    for (ii = 0; ii < param->ny; ii++)
+    {
+        (*data)->Vsx[smap->iMou[ii]] = (*data)->Vs[smap->iMin[ii]];
+        (*data)->Aszx[smap->iMou[ii]] = (*data)->Asz[smap->iMin[ii]];
     }
 }
 
 // >>>>> update cell volume using flux
 void volume_by_flux(Data **data, Map *smap, Config *param)
 {
-    int ii, jj, kk;
-    for (ii = 0; ii < param->n2ci; ii++)
+    int ii;
+    for (ii = 0; ii < param->n2ci; ii++)    {volume_by_flux_cell(data, smap, param, ii);}
+    inflow_volume(data, param);
+}
+
+// >>>>> volume of one cell from the fluxes and the subsurface source
+void volume_by_flux_cell(Data **data, Map *smap, Config *param, int ii)
+{
+    // volume change by flux
+    (*data)->Vflux[ii] = (*data)->Vsn[ii] + param->dt * \
+      ((*data)->Fu[smap->iMjc[ii]] - (*data)->Fu[ii] + (*data)->Fv[smap->icjM[ii]] - (*data)->Fv[ii]);
+    // subsurface source
+    if (param->sim_groundwater == 1)
     {
-        // volume change by flux
-        (*data)->Vflux[ii] = (*data)->Vsn[ii] + param->dt * \
-          ((*data)->Fu[smap->iMjc[ii]] - (*data)->Fu[ii] + (*data)->Fv[smap->icjM[ii]] - (*data)->Fv[ii]);
-          // if (smap->ii[ii]==30 & smap->jj[ii]==37)
-          // {
-          //     printf("---\n");
-          //     printf("depth, vflux, Vsn, dFu, dFv = %f, %f, %f, %f, %f\n",(*data)->dept[ii]*1e4,(*data)->Vflux[ii],(*data)->Vsn[ii], \
-          //           (*data)->Fu[smap->iMjc[ii]] - (*data)->Fu[ii], (*data)->Fv[smap->icjM[ii]] - (*data)->Fv[ii]);
-          // }
-        // subsurface source
-        if (param->sim_groundwater == 1)
-        {
-            if ((*data)->qseepage[ii] < 0 & (*data)->Vflux[ii] > -(*data)->qseepage[ii]*param->dt*param->wcs*(*data)->Asz[ii])
-            {(*data)->Vflux[ii] += (*data)->qseepage[ii] * param->dt * param->wcs * (*data)->Asz[ii];}
-            else if ((*data)->qseepage[ii] > 0)
-            {
-                if ((*data)->dept[ii] > 0)
-                {(*data)->Vflux[ii] += (*data)->qseepage[ii] * param->dt * param->wcs * (*data)->Asz[ii];}
-                else if ((*data)->qseepage[ii]*param->dt*param->wcs > param->min_dept)
-                {(*data)->Vflux[ii] += (*data)->qseepage[ii] * param->dt * param->wcs * (*data)->Asz[ii];}
-            }
+        if ((*data)->qseepage[ii] < 0 & (*data)->Vflux[ii] > -(*data)->qseepage[ii]*param->dt*(*data)->wcs_top[ii]*(*data)->Asz[ii])
+        {(*data)->Vflux[ii] += (*data)->qseepage[ii] * param->dt * (*data)->wcs_top[ii] * (*data)->Asz[ii];}
+        else if ((*data)->qseepage[ii] > 0)
+        {
+            if ((*data)->dept[ii] > 0)
+            {(*data)->Vflux[ii] += (*data)->qseepage[ii] * param->dt * (*data)->wcs_top[ii] * (*data)->Asz[ii];}
+            else if ((*data)->qseepage[ii]*param->dt*(*data)->wcs_top[ii] > param->min_dept)
+            {(*data)->Vflux[ii] += (*data)->qseepage[ii] * param->dt * (*data)->wcs_top[ii] * (*data)->Asz[ii];}
         }
+    }
+}
 
-        // inflow
-        if (param->n_inflow > 0)
+// >>>>> add the inflow to the volume of the inflow cells
+// The inflow lists are visited once, every cell still receives its inflows
+// in the order of the lists.
+void inflow_volume(Data **data, Config *param)
+{
+    int jj, kk, ii;
+    for (kk = 0; kk < param->n_inflow; kk++)
+    {
+        if ((*data)->current_inflow[kk] > 0)
         {
-            for (kk = 0; kk < param->n_inflow; kk++)
+            for (jj = 0; jj < (*data)->inflowloc_len[kk]; jj++)
             {
-                for (jj = 0; jj < (*data)->inflowloc_len[kk]; jj++)
-                {
-                    if (ii == (*data)->inflowloc[kk][jj] & (*data)->current_inflow[kk] > 0)
-                    {(*data)->Vflux[ii] += (*data)->current_inflow[kk] * param->dt / (*data)->inflowloc_len[kk];}
-                }
+                ii = (*data)->inflowloc[kk][jj];
+                if (ii >= 0 & ii < param->n2ci)
+                {(*data)->Vflux[ii] += (*data)->current_inflow[kk] * param->dt / (*data)->inflowloc_len[kk];}
             }
         }
-        // if (smap->ii[ii]==30 & smap->jj[ii]==37)
-        // {
-        //     printf("depth, vflux, Vsn = %f, %f, %f\n",(*data)->dept[ii]*1e4,(*data)->Vflux[ii],(*data)->Vsn[ii]);
-        // }
     }
-
 }
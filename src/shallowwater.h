@@ -16,14 +16,23 @@
 #include "laspack/itersolv.h"
 #include "laspack/mlsolv.h"
 
+// cells per tile of the fused sweeps after the surface solve, rounded to rows
+#define SW_TILE 4096
+
 void solve_shallowwater(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank);
 void shallowwater_velocity(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank);
+void post_solve_depth(Data **data, Map *smap, Config *param, int irank, int nrank);
+void post_solve_velocity(Data **data, Map *smap, Config *param);
+void post_solve_flow_rate(Data **data, Map *smap, Config *param, int irank);
 void momentum_source(Data **data, Map *smap, Config *param);
 void wind_source(Data **data, Map *smap, Config *param, int ii);
 void shallowwater_rhs(Data **data, Map *smap, Config *param);
 void shallowwater_mat_coeff(Data **data, Map *smap, Config *param, int irank, int nrank);
-void build_shallowwater_system(Data *data, Map *smap, Config *param, QMatrix A, Vector b);
-void solve_shallowwater_system(Data **data, Map *smap, QMatrix A, Vector b, Vector x, Config *param);
+void init_shallowwater_system(Data **data, Map *smap, Config *param, int irank, int nrank);
+void shallowwater_halo(Data *data, Map *smap, Config *param, ParCG *cg, int irank);
+void build_shallowwater_system(Data *data, Map *smap, Config *param, LinSys *sys);
+void solve_shallowwater_system(Data **data, Map *smap, LinSys *sys, Config *param);
+void solve_shallowwater_stencil(Data **data, Map *smap, Stencil *st, Config *param);
 void enforce_surf_bc(Data **data, Map *smap, Config *param, int irank, int nrank);
 void cfl_limiter(Data **data, Map *smap, Config *param);
 void evaprain(Data **data, Map *smap, Config *param);
@@ -36,3 +45,14 @@ void interp_velocity(Data **data, Map *smap, Config *param);
 void update_drag_coef(Data **data, Config *param);
 void update_subgrid_variable(Data **data, Map *smap, Config *param);
 void volume_by_flux(Data **data, Map *smap, Config *param);
+void waterfall_cell(Data **data, Map *smap, Config *param, int ii);
+void velocity_cell(Data **data, Map *smap, Config *param, int ii);
+void velocity_limiter_p(Data **data, Config *param, int ii);
+void velocity_limiter_m(Data **data, Map *smap, Config *param, int ii);
+void flow_rate_cell(Data **data, Map *smap, Config *param, int ii, int irank);
+void drag_coef_cell(Data **data, Config *param, int ii);
+void subgrid_cell_variable(Data **data, Config *param, int ii);
+void subgrid_face_variable(Data **data, Map *smap, int ii);
+void subgrid_boundary_variable(Data **data, Map *smap, Config *param);
+void volume_by_flux_cell(Data **data, Map *smap, Config *param, int ii);
+void inflow_volume(Data **data, Config *param);
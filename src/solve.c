@@ -2,6 +2,7 @@
 #include<stdio.h>
 #include<stdlib.h>
 #include<time.h>
+#include<omp.h>
 #include<math.h>
 #include<string.h>
 
@@ -18,12 +19,19 @@
 void solve(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank);
 void get_current_bc(Data **data, Config *param, double t_current);
 void get_evaprain(Data **data, Map *gmap, Config *param);
+void adapt_tolerance(Data **data, Config *param, double t_current, int irank);
+void write_solverlog(SolveLog *slog, Config *param, int tt, double t_current, char *sys, char *phase);
+void close_solverlog();
 void print_end_info(Data **data, Map *smap, Map *gmap, Config *param, int irank);
 
+// solver log, opened on the first row
+static FILE *solverlog_fp = NULL;
+
 void solve(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nrank)
 {
     int t_save, tday, ii, kk, tt = 1;
-    float t0, t1, tstep, dt_max, last_save = 0.0, t_current = 0.0;
+    double t0, t1;
+    float tstep, dt_max, last_save = 0.0, t_current = 0.0;
     double max_CFLx, max_CFLy, max_CFL, *max_CFL_root;
     // save initial condition
     dt_max = param->dt;
@@ -41,7 +49,7 @@ void solve(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nran
         //     {param->dt = dt_max;}
         // }
 
-        if (irank == 0) {t0 = clock();}
+        if (irank == 0) {t0 = omp_get_wtime();}
         (*data)->repeat[0] = 0;
         t_current += param->dt;
         // get boundary condition
@@ -49,11 +57,17 @@ void solve(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nran
         get_evaprain(data, gmap, param);
         // execute solvers
         if (param->sim_shallowwater == 1)
-        {solve_shallowwater(data, smap, gmap, param, irank, nrank);}
+        {
+            solve_shallowwater(data, smap, gmap, param, irank, nrank);
+            if (param->solver_log == 1 & irank == 0)
+            {write_solverlog((*data)->Slog, param, tt, t_current, "SW", "predictor");}
+        }
 
         if (param->sim_groundwater == 1)
         {
             solve_groundwater(data, smap, gmap, param, irank, nrank);
+            if (param->solver_log == 1 & irank == 0)
+            {write_solverlog((*data)->Glog, param, tt, t_current, "GW", "predictor");}
             if ((*data)->repeat[0] == 1)
             {
                 if (param->dt_adjust == 1 & param->dt > param->dt_min)
@@ -62,6 +76,8 @@ void solve(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nran
                     param->dt = 0.5 * param->dt;
                     t_current -= 0.5 * param->dt;
                     solve_groundwater(data, smap, gmap, param, irank, nrank);
+                    if (param->solver_log == 1 & irank == 0)
+                    {write_solverlog((*data)->Glog, param, tt, t_current, "GW", "repeat");}
                 }
                 else
                 {mpi_print("  >>> CFL limiter violated for groundwater solver! Should reduce dt!\n",irank);}
@@ -71,6 +87,9 @@ void solve(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nran
         if (param->sim_shallowwater == 1)
         {shallowwater_velocity(data, smap, gmap, param, irank, nrank);}
 
+        // solver tolerances for the next step
+        if (param->tol_adapt == 1)  {adapt_tolerance(data, param, t_current, irank);}
+
         // check CFL number
 
         max_CFLx = getMax((*data)->cflx, param->n2ci);
@@ -113,16 +132,53 @@ void solve(Data **data, Map *smap, Map *gmap, Config *param, int irank, int nran
         if (irank == 0)
         {
           append_to_file("timestep", t_current, param);
-          t1 = clock();
-          tstep = (t1 - t0)/(float)CLOCKS_PER_SEC;
+          t1 = omp_get_wtime();
+          tstep = t1 - t0;
           printf(" >>>>> Step %d (%f of %.1f sec) completed, new dt = %f, cost = %.4f sec... \n",tt,t_current,param->Tend,param->dt,tstep);
         }
+        // rows of this step reach the disk even if the run aborts later
+        if (solverlog_fp != NULL)   {fflush(solverlog_fp);}
         tt += 1;
     }
+    close_solverlog();
     // printf("  >> Qin = %f, Qout = %f\n",(*data)->qbc[0],(*data)->qbc[1]);
     print_end_info(data, smap, gmap, param, irank);
 }
 
+// >>>>> Append the most recent solve of one system to the solver log
+// One CSV row per linear solve. Under MPI rank 0 writes its own counts,
+// which are the global counts for the global solve. The file stays open
+// for the whole run.
+void write_solverlog(SolveLog *slog, Config *param, int tt, double t_current, char *sys, char *phase)
+{
+    char fullname[200];
+    if (solverlog_fp == NULL)
+    {
+        strcpy(fullname, param->foutput);
+        strcat(fullname, "solverlog.csv");
+        solverlog_fp = fopen(fullname, "w");
+        if (solverlog_fp == NULL)
+        {
+            printf("WARNING: Cannot open %s, solver_log is set to 0!\n", fullname);
+            param->solver_log = 0;
+            return;
+        }
+        fprintf(solverlog_fp, "step,time,dt,system,phase,iter,res0,res,setup,solve\n");
+    }
+    fprintf(solverlog_fp, "%d,%.6f,%.6f,%s,%s,%d,%.4e,%.4e,%.4e,%.4e\n", tt, t_current, param->dt, sys, phase, \
+        slog->last, slog->res0, slog->acc, slog->setup, slog->solve);
+}
+
+// >>>>> Close the solver log at the end of the run
+void close_solverlog()
+{
+    if (solverlog_fp != NULL)
+    {
+        fclose(solverlog_fp);
+        solverlog_fp = NULL;
+    }
+}
+
 // >>>>> Get BC at the current time step
 void get_current_bc(Data **data, Config *param, double t_current)
 {
@@ -247,7 +303,7 @@ void get_evaprain(Data **data, Map *gmap, Config *param)
                         {(*data)->evap[jj] = param->q_evap;}
                         else
                         {
-                            alpha = 1.8 * ((*data)->wc[ii] - param->wcr) / ((*data)->wc[ii] - param->wcr + 0.3);
+                            alpha = 1.8 * ((*data)->wc[ii] - (*data)->mat[(*data)->soil[ii]].wcr) / ((*data)->wc[ii] - (*data)->mat[(*data)->soil[ii]].wcr + 0.3);
                             if (alpha > 1.0)    {alpha = 1.0;}
                             qsuf = alpha * qsat;
                             (*data)->evap[jj] = rhoa * (qsuf - humi) / (rhow * resi);
@@ -266,6 +322,41 @@ void get_evaprain(Data **data, Map *gmap, Config *param)
     }
 }
 
+// >>>>> Adapt the solver tolerances to the volume loss <<<<<
+// The volume loss may grow linearly in time up to vloss_budget at Tend.
+// While it stays below half of the budget so far, the tolerances are
+// loosened by a factor 2 up to tol_max. Beyond the budget they return to
+// the input tolerances at once, because a loose subsurface solve near a
+// wetting front can lose water that no later step recovers.
+void adapt_tolerance(Data **data, Config *param, double t_current, int irank)
+{
+    int ii;
+    double vloss_tot = 0.0, budget, fac_max, *vloss_root;
+    for (ii = 0; ii < param->n3ci; ii++)    {vloss_tot += (*data)->vloss[ii];}
+    if (param->use_mpi == 1)
+    {
+        vloss_root = malloc(param->mpi_ny*param->mpi_nx*sizeof(double));
+        mpi_gather_double(vloss_root, &vloss_tot, 1, 0);
+        if (irank == 0)
+        {
+            vloss_tot = 0.0;
+            for (ii = 0; ii < param->mpi_ny*param->mpi_nx; ii++)    {vloss_tot += vloss_root[ii];}
+        }
+        mpi_bcast_double(&vloss_tot, 1, 0);
+        free(vloss_root);
+    }
+    budget = param->vloss_budget * t_current / param->Tend;
+    if (param->tol_SW > param->tol_GW)  {fac_max = param->tol_max / param->tol_SW;}
+    else    {fac_max = param->tol_max / param->tol_GW;}
+    if (fabs(vloss_tot) > budget)   {param->tol_fac = 1.0;}
+    else if (fabs(vloss_tot) < 0.5 * budget)
+    {
+        param->tol_fac = param->tol_fac * 2.0;
+        if (param->tol_fac > fac_max)   {param->tol_fac = fac_max;}
+        if (param->tol_fac < 1.0)   {param->tol_fac = 1.0;}
+    }
+}
+
 // >>>>> Print information upon completion <<<<<
 void print_end_info(Data **data, Map *smap, Map *gmap, Config *param, int irank)
 {
@@ -289,5 +380,29 @@ void print_end_info(Data **data, Map *smap, Map *gmap, Config *param, int irank)
         }
 
     }
+    // linear solver iterations
+    if (irank == root)
+    {
+        if (param->sim_shallowwater == 1)
+        {
+            printf(" >> Surface solver: %d solves, %.0f CG iterations",(*data)->Slog->nsolve,(*data)->Slog->iter);
+            if (param->warm_start > 0)  {printf(", about %.0f saved by warm start",(*data)->Slog->saved);}
+            printf(", %.2f s\n",(*data)->Slog->time);
+            if (param->precond_SW == 2 && (*data)->Ssys->ilu != NULL)
+            {printf(" >> Surface ILU: %d factorizations, %d reused\n",(*data)->Ssys->ilu->nsetup,(*data)->Ssys->ilu->nreuse);}
+        }
+        if (param->sim_groundwater == 1)
+        {
+            printf(" >> Subsurface solver: %d solves, %.0f CG iterations",(*data)->Glog->nsolve,(*data)->Glog->iter);
+            if (param->warm_start > 0)  {printf(", about %.0f saved by warm start",(*data)->Glog->saved);}
+            printf(", %.2f s\n",(*data)->Glog->time);
+            if (param->tol_adapt == 1)
+            {printf(" >> Adaptive tolerance: factor %.0f at the end, volume loss budget %f m^3\n",param->tol_fac,param->vloss_budget);}
+            if ((*data)->Gsys->ilu != NULL)
+            {printf(" >> Subsurface ILU: %d factorizations, %d reused\n",(*data)->Gsys->ilu->nsetup,(*data)->Gsys->ilu->nreuse);}
+            if ((*data)->Gsys->amg != NULL)
+            {printf(" >> Subsurface AMG: %d setups, %d reused\n",(*data)->Gsys->amg->nsetup,(*data)->Gsys->amg->nreuse);}
+        }
+    }
 
 }
@@ -0,0 +1,186 @@
+// Matrix-free kernels for structured stencil operators
+// The coefficient arrays are read in place with unit-stride loops, so no
+// sparse matrix storage is assembled for these systems.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include"stencil.h"
+
+void init_stencil(Stencil **st, int nx, int ny, double sign, double *ct, double *xp, double *xm, double *yp, double *ym);
+void stencil_update_diag(Stencil *st);
+void stencil_matvec(Stencil *st, double *y, double *x);
+void stencil_ssor(Stencil *st, double *y, double *c, double omega);
+double stencil_dot(double *a, double *b, size_t n);
+int stencil_cg(Stencil *st, double *x, double *b, double eps, int maxiter, double omega);
+void stencil_apply(void *ctx, double *y, double *x);
+void stencil_precond(void *ctx, double *y, double *c);
+int stencil_pcg(Stencil *st, double *x, double *b, double eps, int maxiter, StencilPrecond precond, void *ctx);
+
+// >>>>> Set up a stencil operator on existing coefficient arrays <<<<<
+void init_stencil(Stencil **st, int nx, int ny, double sign, double *ct, double *xp, double *xm, double *yp, double *ym)
+{
+    *st = malloc(sizeof(Stencil));
+    (*st)->nx = nx;
+    (*st)->ny = ny;
+    (*st)->n = (size_t) nx * ny;
+    (*st)->sign = sign;
+    (*st)->ct = ct;     (*st)->xp = xp;     (*st)->xm = xm;
+    (*st)->yp = yp;     (*st)->ym = ym;
+    (*st)->iter = 0;
+    (*st)->omega = 1.0;
+    (*st)->acc = 0.0;
+    (*st)->res0 = 1.0;
+    // workspace of the Krylov solver
+    (*st)->invd = malloc((*st)->n*sizeof(double));
+    (*st)->r = malloc((*st)->n*sizeof(double));
+    (*st)->p = malloc((*st)->n*sizeof(double));
+    (*st)->q = malloc((*st)->n*sizeof(double));
+    (*st)->z = malloc((*st)->n*sizeof(double));
+    (*st)->xprev = calloc((*st)->n, sizeof(double));
+}
+
+// >>>>> Inverse of the diagonal, called once the coefficients are updated <<<<<
+void stencil_update_diag(Stencil *st)
+{
+    size_t ii;
+    for (ii = 0; ii < st->n; ii++)  {st->invd[ii] = 1.0 / st->ct[ii];}
+}
+
+// >>>>> y = A * x <<<<<
+void stencil_matvec(Stencil *st, double *y, double *x)
+{
+    int ii, jj, nx = st->nx;
+    double sg = st->sign;
+    double *yr, *xr, *ct, *xp, *xm, *yp, *ym;
+    // one grid row at a time, each pass is a unit-stride loop
+    for (jj = 0; jj < st->ny; jj++)
+    {
+        yr = y + jj*nx;     xr = x + jj*nx;
+        ct = st->ct + jj*nx;    xp = st->xp + jj*nx;    xm = st->xm + jj*nx;
+        yp = st->yp + jj*nx;    ym = st->ym + jj*nx;
+        for (ii = 0; ii < nx; ii++)     {yr[ii] = ct[ii] * xr[ii];}
+        for (ii = 1; ii < nx; ii++)     {yr[ii] += sg * xm[ii] * xr[ii-1];}
+        for (ii = 0; ii < nx-1; ii++)   {yr[ii] += sg * xp[ii] * xr[ii+1];}
+        if (jj > 0)
+        {for (ii = 0; ii < nx; ii++)    {yr[ii] += sg * ym[ii] * xr[ii-nx];}}
+        if (jj < st->ny-1)
+        {for (ii = 0; ii < nx; ii++)    {yr[ii] += sg * yp[ii] * xr[ii+nx];}}
+    }
+}
+
+// >>>>> SSOR preconditioner, y = M^(-1) * c <<<<<
+// M = 1/(2-w) * (D/w + L) * (D/w)^(-1) * (D/w + U), same as LASPack SSORPrecond
+void stencil_ssor(Stencil *st, double *y, double *c, double omega)
+{
+    int ii, jj, nx = st->nx, ny = st->ny;
+    size_t im;
+    double sg = st->sign, sum;
+    // forward sweep, (D/w + L) t = c
+    for (jj = 0; jj < ny; jj++)
+    {
+        for (ii = 0; ii < nx; ii++)
+        {
+            im = jj*nx + ii;
+            sum = c[im];
+            if (ii > 0)     {sum -= sg * st->xm[im] * y[im-1];}
+            if (jj > 0)     {sum -= sg * st->ym[im] * y[im-nx];}
+            y[im] = omega * sum * st->invd[im];
+        }
+    }
+    // backward sweep, (D/w + U) y = D t
+    for (jj = ny-1; jj >= 0; jj--)
+    {
+        for (ii = nx-1; ii >= 0; ii--)
+        {
+            im = jj*nx + ii;
+            sum = st->ct[im] * y[im];
+            if (ii < nx-1)  {sum -= sg * st->xp[im] * y[im+1];}
+            if (jj < ny-1)  {sum -= sg * st->yp[im] * y[im+nx];}
+            y[im] = omega * sum * st->invd[im];
+        }
+    }
+    if (omega != 1.0)
+    {for (im = 0; im < st->n; im++)    {y[im] *= (2.0 - omega) / omega;}}
+}
+
+// >>>>> Dot product of two vectors <<<<<
+double stencil_dot(double *a, double *b, size_t n)
+{
+    size_t ii;
+    double sum = 0.0;
+    for (ii = 0; ii < n; ii++)  {sum += a[ii] * b[ii];}
+    return sum;
+}
+
+// >>>>> SSOR preconditioned CG, x is the initial guess on entry <<<<<
+int stencil_cg(Stencil *st, double *x, double *b, double eps, int maxiter, double omega)
+{
+    st->omega = omega;
+    stencil_update_diag(st);
+    return stencil_pcg(st, x, b, eps, maxiter, stencil_precond, st);
+}
+
+// >>>>> Operator in the form used by the Krylov solvers <<<<<
+void stencil_apply(void *ctx, double *y, double *x)
+{
+    stencil_matvec((Stencil *) ctx, y, x);
+}
+
+// >>>>> SSOR preconditioner in the form used by the Krylov solvers <<<<<
+void stencil_precond(void *ctx, double *y, double *c)
+{
+    Stencil *st = ctx;
+    stencil_ssor(st, y, c, st->omega);
+}
+
+// >>>>> Preconditioned CG, x is the initial guess on entry <<<<<
+// Stops when |r| < eps*|b| as LASPack CGIter does, returns the iteration count
+int stencil_pcg(Stencil *st, double *x, double *b, double eps, int maxiter, StencilPrecond precond, void *ctx)
+{
+    int iter = 0;
+    size_t ii, n = st->n;
+    double alpha, beta, rho, rho_old = 1.0, bnorm, rnorm;
+    double *r = st->r, *p = st->p, *q = st->q, *z = st->z;
+
+    stencil_matvec(st, r, x);
+    for (ii = 0; ii < n; ii++)  {r[ii] = b[ii] - r[ii];}
+    bnorm = sqrt(stencil_dot(b, b, n));
+    rnorm = sqrt(stencil_dot(r, r, n));
+    if (bnorm > 0.0)    {st->res0 = rnorm / bnorm;}
+    else
+    {
+        // zero right hand side has the trivial solution
+        for (ii = 0; ii < n; ii++)  {x[ii] = 0.0;}
+        st->res0 = 0.0;
+        rnorm = 0.0;
+    }
+    while (rnorm >= eps * bnorm && bnorm > 0.0 && iter < maxiter)
+    {
+        iter++;
+        (*precond)(ctx, z, r);
+        rho = stencil_dot(r, z, n);
+        if (iter == 1)
+        {for (ii = 0; ii < n; ii++)    {p[ii] = z[ii];}}
+        else
+        {
+            beta = rho / rho_old;
+            for (ii = 0; ii < n; ii++)  {p[ii] = z[ii] + beta * p[ii];}
+        }
+        stencil_matvec(st, q, p);
+        alpha = rho / stencil_dot(p, q, n);
+        rnorm = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            x[ii] += alpha * p[ii];
+            r[ii] -= alpha * q[ii];
+            rnorm += r[ii] * r[ii];
+        }
+        rnorm = sqrt(rnorm);
+        rho_old = rho;
+    }
+    st->iter = iter;
+    if (bnorm > 0.0)    {st->acc = rnorm / bnorm;}
+    else    {st->acc = 0.0;}
+    return iter;
+}
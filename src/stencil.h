@@ -0,0 +1,32 @@
+// Header file for stencil.c
+#include<stdlib.h>
+
+#ifndef STENCIL_H
+#define STENCIL_H
+
+// 5-point operator on a structured nx*ny grid, cell index = j*nx + i
+// Coefficient arrays are not owned, they point to the fields in Data.
+// Off-diagonal entries enter the operator as sign*coefficient.
+typedef struct Stencil
+{
+    int nx, ny, iter;
+    size_t n;
+    double sign, omega, acc, res0;
+    double *ct, *xp, *xm, *yp, *ym;
+    double *invd, *r, *p, *q, *z, *xprev;
+}Stencil;
+
+// preconditioner y = M^(-1) * c of the stencil Krylov solver
+typedef void (*StencilPrecond)(void *ctx, double *y, double *c);
+
+#endif
+
+void init_stencil(Stencil **st, int nx, int ny, double sign, double *ct, double *xp, double *xm, double *yp, double *ym);
+void stencil_update_diag(Stencil *st);
+void stencil_matvec(Stencil *st, double *y, double *x);
+void stencil_ssor(Stencil *st, double *y, double *c, double omega);
+double stencil_dot(double *a, double *b, size_t n);
+void stencil_apply(void *ctx, double *y, double *x);
+void stencil_precond(void *ctx, double *y, double *c);
+int stencil_cg(Stencil *st, double *x, double *b, double eps, int maxiter, double omega);
+int stencil_pcg(Stencil *st, double *x, double *b, double eps, int maxiter, StencilPrecond precond, void *ctx);
@@ -0,0 +1,192 @@
+// Test of the reuse of an AMG hierarchy after the matrix has changed
+// A layered 3D diffusion operator stands in for the groundwater matrix.
+// Between two solves the conductivities of the upper half change by
+// orders of magnitude, as when cells saturate.
+//  1. drift = 0.1 and only off-diagonal entries change: the hierarchy must
+//     be rebuilt.
+//  2. drift so large that the stale hierarchy is kept: CG preconditioned by
+//     the reused cycle must still converge.
+// Build and run with "make test".
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include"amg.h"
+
+#include "laspack/errhandl.h"
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+#define NX 16
+#define NY 16
+#define NZ 24
+
+static void build_pattern(QMatrix *A);
+static void set_values(QMatrix *A, double Ktop, int keepdiag);
+static void matvec(QMatrix *A, double *y, double *x);
+static int pcg(QMatrix *A, Amg *amg, double *x, double *b, double eps, int maxiter);
+
+int main(void)
+{
+    int fail = 0, iter;
+    size_t ii, n = NX*NY*NZ;
+    double *x, *b;
+    QMatrix A;
+    Amg *amg;
+    x = malloc(n*sizeof(double));
+    b = malloc(n*sizeof(double));
+    for (ii = 0; ii < n; ii++)  {b[ii] = sin(0.37*ii) + 1.0;}
+    build_pattern(&A);
+
+    // 1. off-diagonal change at a constant diagonal triggers a new setup
+    init_amg(&amg, &A, 0.1);
+    set_values(&A, 1.0, 1);
+    amg_update(amg, &A);
+    set_values(&A, 1e-3, 1);
+    amg_update(amg, &A);
+    printf(" off-diagonal change : %d setups, %d reuses\n",amg->nsetup,amg->nreuse);
+    if (amg->nsetup != 2)   {printf(" FAILED: the hierarchy was not rebuilt\n");  fail = 1;}
+
+    // 2. a stale hierarchy still gives a converging CG
+    init_amg(&amg, &A, 1e30);
+    set_values(&A, 1.0, 0);
+    amg_update(amg, &A);
+    for (ii = 0; ii < n; ii++)  {x[ii] = 0.0;}
+    iter = pcg(&A, amg, x, b, 1e-8, 500);
+    printf(" fresh hierarchy : %d CG iterations\n",iter);
+    set_values(&A, 1e4, 0);
+    amg_update(amg, &A);
+    for (ii = 0; ii < n; ii++)  {x[ii] = 0.0;}
+    iter = pcg(&A, amg, x, b, 1e-8, 500);
+    printf(" reused hierarchy : %d setups, %d reuses, %d CG iterations\n",amg->nsetup,amg->nreuse,iter);
+    if (amg->nreuse != 1)   {printf(" FAILED: the hierarchy was not reused\n");  fail = 1;}
+    if (iter < 0)   {printf(" FAILED: CG did not converge with the reused hierarchy\n");  fail = 1;}
+
+    if (fail == 0)  {printf(" PASSED\n");}
+    return fail;
+}
+
+// >>>>> 7-point pattern, unknown (i,j,k) is row 1 + (j*NX+i)*NZ+k <<<<<
+static void build_pattern(QMatrix *A)
+{
+    int ii, jj, kk, ll, len, row, nb[7];
+    Q_Constr(A, "A", NX*NY*NZ, False, Rowws, Normal, True);
+    for (jj = 0; jj < NY; jj++)
+    {
+        for (ii = 0; ii < NX; ii++)
+        {
+            for (kk = 0; kk < NZ; kk++)
+            {
+                row = (jj*NX+ii)*NZ + kk;
+                len = 0;
+                nb[len++] = row;
+                if (ii > 0) {nb[len++] = row - NZ;}
+                if (ii < NX-1)  {nb[len++] = row + NZ;}
+                if (jj > 0) {nb[len++] = row - NX*NZ;}
+                if (jj < NY-1)  {nb[len++] = row + NX*NZ;}
+                if (kk > 0) {nb[len++] = row - 1;}
+                if (kk < NZ-1)  {nb[len++] = row + 1;}
+                Q_SetLen(A, row+1, len);
+                for (ll = 0; ll < len; ll++)    {Q_SetEntry(A, row+1, ll, nb[ll]+1, 0.0);}
+            }
+        }
+    }
+    Q_SortEl(A);
+    Q_AllocInvDiagEl(A);
+}
+
+// >>>>> Conductivity 1 below, Ktop in the upper half, thin vertical cells <<<<<
+// keepdiag = 1 adjusts the storage term so that the diagonal is 7 in every
+// row, keepdiag = 0 uses a storage term of 1.
+static void set_values(QMatrix *A, double Ktop, int keepdiag)
+{
+    size_t ii, kk, row, col;
+    double K, Kr, Kc, sum;
+    for (ii = 1; ii <= Q_GetDim(A); ii++)
+    {
+        row = ii - 1;
+        Kr = (row % NZ < NZ/2) ? Ktop : 1.0;
+        sum = 0.0;
+        for (kk = 0; kk < A->Len[ii]; kk++)
+        {
+            col = A->El[ii][kk].Pos - 1;
+            if (col == row) {continue;}
+            Kc = (col % NZ < NZ/2) ? Ktop : 1.0;
+            K = 0.5 * (Kr + Kc);
+            // vertical faces are 100 times stronger
+            if (col == row + 1 | col + 1 == row)    {K = 100.0 * K;}
+            A->El[ii][kk].Val = -K;
+            sum += K;
+        }
+        if (keepdiag == 1)  {A->DiagEl[ii]->Val = 7.0 * 100.0;}
+        else    {A->DiagEl[ii]->Val = 1.0 + sum;}
+        // the off-diagonal sum is bounded by 4 + 2*100 below 700
+        if (keepdiag == 1 & sum > 700.0)    {printf(" bad test setup\n");  exit(1);}
+        A->InvDiagEl[ii] = 1.0 / A->DiagEl[ii]->Val;
+    }
+}
+
+// >>>>> y = A x on plain arrays <<<<<
+static void matvec(QMatrix *A, double *y, double *x)
+{
+    size_t ii, kk;
+    for (ii = 1; ii <= Q_GetDim(A); ii++)
+    {
+        y[ii-1] = 0.0;
+        for (kk = 0; kk < A->Len[ii]; kk++) {y[ii-1] += A->El[ii][kk].Val * x[A->El[ii][kk].Pos-1];}
+    }
+}
+
+// >>>>> CG preconditioned by the AMG cycle, iterations or -1 <<<<<
+static int pcg(QMatrix *A, Amg *amg, double *x, double *b, double eps, int maxiter)
+{
+    int iter;
+    size_t ii, n = Q_GetDim(A);
+    double *r, *z, *p, *q, rz, rzold, alpha, pq, rnorm, bnorm = 0.0;
+    r = malloc(n*sizeof(double));
+    z = malloc(n*sizeof(double));
+    p = malloc(n*sizeof(double));
+    q = malloc(n*sizeof(double));
+    matvec(A, q, x);
+    for (ii = 0; ii < n; ii++)
+    {
+        r[ii] = b[ii] - q[ii];
+        bnorm += b[ii] * b[ii];
+    }
+    bnorm = sqrt(bnorm);
+    amg_cycle(amg, z, r);
+    rz = 0.0;
+    for (ii = 0; ii < n; ii++)
+    {
+        p[ii] = z[ii];
+        rz += r[ii] * z[ii];
+    }
+    for (iter = 1; iter <= maxiter; iter++)
+    {
+        matvec(A, q, p);
+        pq = 0.0;
+        for (ii = 0; ii < n; ii++)  {pq += p[ii] * q[ii];}
+        // a preconditioner that is not positive definite breaks down here
+        if (!(pq > 0.0 & rz > 0.0)) {break;}
+        alpha = rz / pq;
+        rnorm = 0.0;
+        for (ii = 0; ii < n; ii++)
+        {
+            x[ii] += alpha * p[ii];
+            r[ii] -= alpha * q[ii];
+            rnorm += r[ii] * r[ii];
+        }
+        if (sqrt(rnorm) < eps * bnorm)
+        {
+            free(r);    free(z);    free(p);    free(q);
+            return iter;
+        }
+        amg_cycle(amg, z, r);
+        rzold = rz;
+        rz = 0.0;
+        for (ii = 0; ii < n; ii++)  {rz += r[ii] * z[ii];}
+        for (ii = 0; ii < n; ii++)  {p[ii] = z[ii] + rz / rzold * p[ii];}
+    }
+    free(r);    free(z);    free(p);    free(q);
+    return -1;
+}
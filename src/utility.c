@@ -8,12 +8,18 @@
 #include"initialize.h"
 #include"map.h"
 #include"mpifunctions.h"
+#include"vgtable.h"
 
 double compute_wch(Data *data, int ii, Config *param);
 double compute_hwc(Data *data, int ii, Config *param);
 double compute_ch(Data *data, int ii, Config *param);
-double compute_K(Data *data, double *Ksat, int ii, Config *param);
-double compute_dKdwc(Data *data, double *Ksat, int ii, Config *param);
+double compute_K(Data *data, int dir, int ii, Config *param);
+double compute_dKdwc(Data *data, int dir, int ii, Config *param);
+double vg_wch(double h, double vga, double vgn, double wcr, double wcs, Config *param);
+double vg_hwc(double wc, double vga, double vgn, double wcr, double wcs, Config *param);
+double vg_ch(double h, double vga, double vgn, double wcr, double wcs, Config *param);
+double vg_K(double h, double Ks, double vga, double vgn, double wcr, double wcs, Config *param);
+double vg_dKdwc(double wc, double Ks, double vga, double vgn, double wcr, double wcs, Config *param);
 char* read_one_input(char field[], char fname[]);
 double read_one_input_double(char field[], char fname[]);
 int * read_one_input_array(char field[], char fname[], int n);
@@ -35,40 +41,83 @@ int exist(char *fname);
 // >>>>> Compute water content from h using water retention curve <<<<<
 double compute_wch(Data *data, int ii, Config *param)
 {
-    double wc, m, s, h, wcs, wcm;
-    h = data->h[ii];
-    m = 1.0 - 1.0/data->vgn[ii];
+    Material *s = &data->mat[data->soil[ii]];
+    if (param->use_vg_table == 1)
+    {return vgtable_wch(&data->vgt[data->soil[ii]], data->h[ii], param);}
+    return vg_wch(data->h[ii], s->vga, s->vgn, s->wcr, s->wcs, param);
+}
+
+// >>>>> Compute h from water content using water retention curve <<<<<
+double compute_hwc(Data *data, int ii, Config *param)
+{
+    Material *s = &data->mat[data->soil[ii]];
+    if (param->use_vg_table == 1)
+    {return vgtable_hwc(&data->vgt[data->soil[ii]], data->wc[ii], param);}
+    return vg_hwc(data->wc[ii], s->vga, s->vgn, s->wcr, s->wcs, param);
+}
+
+// >>>>> Compute specific capacity <<<<<
+double compute_ch(Data *data, int ii, Config *param)
+{
+    Material *s = &data->mat[data->soil[ii]];
+    if (param->use_vg_table == 1)
+    {return vgtable_ch(&data->vgt[data->soil[ii]], data->h[ii], param);}
+    return vg_ch(data->h[ii], s->vga, s->vgn, s->wcr, s->wcs, param);
+}
+
+// >>>>> Compute hydraulic conductivity along x, y or z (dir = 0, 1, 2) <<<<<
+double compute_K(Data *data, int dir, int ii, Config *param)
+{
+    Material *s = &data->mat[data->soil[ii]];
+    if (param->use_vg_table == 1)
+    {return vgtable_K(&data->vgt[data->soil[ii]], data->h[ii], s->Ks[dir], param);}
+    return vg_K(data->h[ii], s->Ks[dir], s->vga, s->vgn, s->wcr, s->wcs, param);
+}
+
+// >>>>> Compute dKdwc for adaptive time stepping <<<<<
+double compute_dKdwc(Data *data, int dir, int ii, Config *param)
+{
+    Material *s = &data->mat[data->soil[ii]];
+    if (param->use_vg_table == 1)
+    {return vgtable_dKdwc(&data->vgt[data->soil[ii]], data->wc[ii], s->Ks[dir], param);}
+    return vg_dKdwc(data->wc[ii], s->Ks[dir], s->vga, s->vgn, s->wcr, s->wcs, param);
+}
+
+// >>>>> Water content at h, van Genuchten <<<<<
+double vg_wch(double h, double vga, double vgn, double wcr, double wcs, Config *param)
+{
+    double wc, m, s, wcm;
+    m = 1.0 - 1.0/vgn;
     if (param->use_mvg == 1)
-    {wcm = data->wcr[ii] + (data->wcs[ii]-data->wcr[ii])*pow((1.0 + pow(fabs(param->aev)*data->vga[ii],data->vgn[ii])), m);}
+    {wcm = wcr + (wcs-wcr)*pow((1.0 + pow(fabs(param->aev)*vga,vgn)), m);}
     else
-    {wcm = data->wcs[ii];}
-    s = pow(1.0 + pow(fabs(data->vga[ii]*h), data->vgn[ii]), -m);
+    {wcm = wcs;}
+    s = pow(1.0 + pow(fabs(vga*h), vgn), -m);
 
-    if (h > param->aev)  {wc = data->wcs[ii];}
-    else    {wc = data->wcr[ii] + (wcm-data->wcr[ii]) * s;}
-    if (wc > data->wcs[ii])    {wc = data->wcs[ii];}
-    else if (wc < data->wcr[ii])   {wc = data->wcr[ii];}
+    if (h > param->aev)  {wc = wcs;}
+    else    {wc = wcr + (wcm-wcr) * s;}
+    if (wc > wcs)    {wc = wcs;}
+    else if (wc < wcr)   {wc = wcr;}
 
     return wc;
 }
 
-// >>>>> Compute h from water content using water retention curve <<<<<
-double compute_hwc(Data *data, int ii, Config *param)
+// >>>>> Pressure head at wc, van Genuchten <<<<<
+double vg_hwc(double wc, double vga, double vgn, double wcr, double wcs, Config *param)
 {
-    double wc, wcs, h, m, wcm, eps = 1e-7;
-    wc = data->wc[ii];
-    m = 1.0 - 1.0/data->vgn[ii];
+    double h, m, wcm, eps = 1e-7;
+    m = 1.0 - 1.0/vgn;
 
     if (param->use_mvg == 1)
-    {wcm = data->wcr[ii] + (data->wcs[ii]-data->wcr[ii])*pow((1.0 + pow(fabs(param->aev)*data->vga[ii],data->vgn[ii])), m);}
+    {wcm = wcr + (wcs-wcr)*pow((1.0 + pow(fabs(param->aev)*vga,vgn)), m);}
     else
-    {wcm = data->wcs[ii];}
+    {wcm = wcs;}
 
-    if (wc - data->wcr[ii] < eps)  {wc = data->wcr[ii] + eps;}
-    if (wc < data->wcs[ii])
+    if (wc - wcr < eps)  {wc = wcr + eps;}
+    if (wc < wcs)
     {
-        h = -(1.0/data->vga[ii]) *
-            pow(pow((wcm - data->wcr[ii])/(wc - data->wcr[ii]),(1.0/m)) - 1.0,(1.0/data->vgn[ii]));
+        h = -(1.0/vga) *
+            pow(pow((wcm - wcr)/(wc - wcr),(1.0/m)) - 1.0,(1.0/vgn));
     }
     else    {h = 0.0;}
 
@@ -79,20 +128,19 @@ double compute_hwc(Data *data, int ii, Config *param)
     return h;
 }
 
-// >>>>> Compute specific capacity <<<<<
-double compute_ch(Data *data, int ii, Config *param)
+// >>>>> Specific capacity at h, van Genuchten <<<<<
+double vg_ch(double h, double vga, double vgn, double wcr, double wcs, Config *param)
 {
-    double h, wcs, c, m, wcm, deno, nume;
-    h = data->h[ii];
-    m = 1.0 - 1.0/data->vgn[ii];
+    double c, m, wcm, deno, nume;
+    m = 1.0 - 1.0/vgn;
     if (param->use_mvg == 1)
-    {wcm = data->wcr[ii] + (data->wcs[ii]-data->wcr[ii])*pow((1.0 + pow(fabs(param->aev)*data->vga[ii],data->vgn[ii])), m);}
+    {wcm = wcr + (wcs-wcr)*pow((1.0 + pow(fabs(param->aev)*vga,vgn)), m);}
     else
-    {wcm = data->wcs[ii];}
+    {wcm = wcs;}
 
-    nume = data->vga[ii]*data->vgn[ii]*m * (wcm-data->wcr[ii]) *
-        pow(fabs(data->vga[ii]*h),data->vgn[ii]-1);
-    deno = pow((1.0 + pow(fabs(data->vga[ii]*h),data->vgn[ii])), m+1);
+    nume = vga*vgn*m * (wcm-wcr) *
+        pow(fabs(vga*h),vgn-1);
+    deno = pow((1.0 + pow(fabs(vga*h),vgn)), m+1);
     c = nume / deno;
     if (param->use_mvg == 1)
     {if (h > param->aev)  {c = 0.0;}}
@@ -101,20 +149,18 @@ double compute_ch(Data *data, int ii, Config *param)
     return c;
 }
 
-// >>>>> Compute hydraulic conductivity <<<<<
-double compute_K(Data *data, double *Ksat, int ii, Config *param)
+// >>>>> Hydraulic conductivity at h, van Genuchten-Mualem <<<<<
+double vg_K(double h, double Ks, double vga, double vgn, double wcr, double wcs, Config *param)
 {
-    double m, wcs, Keff, s, h, Ks, wcm, nume, deno, ratio;
-    Ks = Ksat[ii];
-    h = data->h[ii];
-    m = 1.0 - 1.0/data->vgn[ii];
-    s = pow(1.0 + pow(fabs(data->vga[ii]*h), data->vgn[ii]), -m);
+    double m, Keff, s, wcm, nume, deno;
+    m = 1.0 - 1.0/vgn;
+    s = pow(1.0 + pow(fabs(vga*h), vgn), -m);
     if (param->use_mvg == 1)
-    {wcm = data->wcr[ii] + (data->wcs[ii]-data->wcr[ii])*pow((1.0 + pow(fabs(param->aev)*data->vga[ii],data->vgn[ii])), m);}
+    {wcm = wcr + (wcs-wcr)*pow((1.0 + pow(fabs(param->aev)*vga,vgn)), m);}
     else
-    {wcm = data->wcs[ii];}
-    nume = 1.0-pow(1.0-pow(s*(data->wcs[ii]-data->wcr[ii])/(wcm-data->wcr[ii]),1.0/m),m);
-    deno = 1.0-pow(1.0-pow((data->wcs[ii]-data->wcr[ii])/(wcm-data->wcr[ii]),1.0/m),m);
+    {wcm = wcs;}
+    nume = 1.0-pow(1.0-pow(s*(wcs-wcr)/(wcm-wcr),1.0/m),m);
+    deno = 1.0-pow(1.0-pow((wcs-wcr)/(wcm-wcr),1.0/m),m);
 
     if (param->use_mvg == 1)
     {
@@ -131,29 +177,27 @@ double compute_K(Data *data, double *Ksat, int ii, Config *param)
 
     if (isnan(Keff))
     {
-        printf("ii=%d, nume=%f, deno=%f, h=%f, s=%f, (wcs,wcr,wcm)=(%f,%f,%f)\n",
-            ii,nume,deno,h,s,data->wcs[ii],data->wcr[ii],wcm);
+        printf("nume=%f, deno=%f, h=%f, s=%f, (wcs,wcr,wcm)=(%f,%f,%f)\n",
+            nume,deno,h,s,wcs,wcr,wcm);
     }
 
     return Keff;
 }
 
-// >>>>> Compute dKdwc for adaptive time stepping <<<<<
-double compute_dKdwc(Data *data, double *Ksat, int ii, Config *param)
+// >>>>> dKdwc at wc, van Genuchten-Mualem <<<<<
+double vg_dKdwc(double wc, double Ks, double vga, double vgn, double wcr, double wcs, Config *param)
 {
-    double term1, term2, term0, m, s, dKdwc, wc, Ks, wcm, c1, c2;
-    Ks = Ksat[ii];
-    wc = data->wc[ii];
+    double term1, term2, term0, m, s, dKdwc, wcm, c1, c2;
+    m = 1.0 - 1.0/vgn;
     if (param->use_mvg == 1)
-    {wcm = data->wcr[ii] + (data->wcs[ii]-data->wcr[ii])*pow((1.0 + pow(fabs(param->aev)*data->vga[ii],data->vgn[ii])), m);}
+    {wcm = wcr + (wcs-wcr)*pow((1.0 + pow(fabs(param->aev)*vga,vgn)), m);}
     else
-    {wcm = data->wcs[ii];}
+    {wcm = wcs;}
 
     // use the lambda limiter
-    if (wc > 0.9999 * data->wcs[ii] & wc < data->wcs[ii])
-    {wc = 0.9999 * data->wcs[ii];}
-    m = 1.0 - 1.0/data->vgn[ii];
-    s = (wc - data->wcr[ii]) / (data->wcs[ii] - data->wcr[ii]);
+    if (wc > 0.9999 * wcs & wc < wcs)
+    {wc = 0.9999 * wcs;}
+    s = (wc - wcr) / (wcs - wcr);
     if (param->use_mvg == 0)
     {
         // calculate dKdwc
@@ -163,13 +207,13 @@ double compute_dKdwc(Data *data, double *Ksat, int ii, Config *param)
     }
     else
     {
-        c2 = (data->wcs[ii] - data->wcr[ii])/(wcm - data->wcr[ii]);
+        c2 = (wcs - wcr)/(wcm - wcr);
         c1 = 1.0 / pow(1.0 - pow((1.0 - pow(c2,1.0/m)),m), 2.0);
         term0 = pow(1.0 - pow(c2*s,1.0/m), m);
         term1 = 0.5 * c1 * Ks * pow(s,-0.5) * (1.0 - term0) * (1.0 - term0);
         term2 = 2.0 * c1 * Ks * c2 * pow(s,0.5) * pow(c2*s,1.0/m-1.0) * (1.0 - term0) * pow(1.0 - pow(c2*s,1.0/m), m-1);
     }
-    dKdwc = (term1 + term2) / (data->wcs[ii] - data->wcr[ii]);
+    dKdwc = (term1 + term2) / (wcs - wcr);
     return dKdwc;
 }
 
@@ -10,8 +10,13 @@
 double compute_wch(Data *data, int ii, Config *param);
 double compute_hwc(Data *data, int ii, Config *param);
 double compute_ch(Data *data, int ii, Config *param);
-double compute_K(Data *data, double *Ksat, int ii, Config *param);
-double compute_dKdwc(Data *data, double *Ksat, int ii, Config *param);
+double compute_K(Data *data, int dir, int ii, Config *param);
+double compute_dKdwc(Data *data, int dir, int ii, Config *param);
+double vg_wch(double h, double vga, double vgn, double wcr, double wcs, Config *param);
+double vg_hwc(double wc, double vga, double vgn, double wcr, double wcs, Config *param);
+double vg_ch(double h, double vga, double vgn, double wcr, double wcs, Config *param);
+double vg_K(double h, double Ks, double vga, double vgn, double wcr, double wcs, Config *param);
+double vg_dKdwc(double wc, double Ks, double vga, double vgn, double wcr, double wcs, Config *param);
 char* read_one_input(char field[], char fname[]);
 double read_one_input_double(char field[], char fname[]);
 int * read_one_input_array(char field[], char fname[], int n);
@@ -0,0 +1,299 @@
+// Tabulated van Genuchten-Mualem relations
+// Every soil class gets its own tables, built once at
+// initialization from the analytic functions in utility.c. A curve is
+// piecewise linear on a uniform grid, which keeps it monotone wherever the
+// analytic curve is monotone, and is refined until the relative error at the
+// interval midpoints is within vg_table_tol. Values outside the tabulated
+// range fall back to the analytic functions.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+#include<time.h>
+
+#include"configuration.h"
+#include"utility.h"
+#include"vgtable.h"
+
+#define VG_WCH 0
+#define VG_K 1
+#define VG_CH 2
+#define VG_HWC 3
+#define VG_DK 4
+
+void build_vg_table(VGTable **vgt, Material *mat, int nsoil, Config *param, int irank);
+double vgtable_wch(VGTable *t, double h, Config *param);
+double vgtable_hwc(VGTable *t, double wc, Config *param);
+double vgtable_ch(VGTable *t, double h, Config *param);
+double vgtable_K(VGTable *t, double h, double Ks, Config *param);
+double vgtable_dKdwc(VGTable *t, double wc, double Ks, Config *param);
+static void build_soil(VGTable *t, Config *param);
+static void build_curve(VGCurve *c, VGTable *t, int kind, double x0, double x1, int uselog, Config *param);
+static double curve_node(VGTable *t, int kind, double x, Config *param);
+static double curve_value(VGCurve *c, double x);
+static double wc_coord(VGTable *t, double wc);
+static void check_soil(VGTable *t, int kk, Config *param);
+
+// >>>>> Tabulate every soil class <<<<<
+void build_vg_table(VGTable **vgt, Material *mat, int nsoil, Config *param, int irank)
+{
+    int kk, nmax = 0;
+    VGTable *t;
+    *vgt = malloc(nsoil*sizeof(VGTable));
+    for (kk = 0; kk < nsoil; kk++)
+    {
+        t = &(*vgt)[kk];
+        t->vga = mat[kk].vga;
+        t->vgn = mat[kk].vgn;
+        t->wcr = mat[kk].wcr;
+        t->wcs = mat[kk].wcs;
+        build_soil(t, param);
+        if (t->wch.n > nmax)   {nmax = t->wch.n;}
+        if (t->K.n > nmax)   {nmax = t->K.n;}
+        if (t->ch.n > nmax)   {nmax = t->ch.n;}
+        if (t->hwc.n > nmax)   {nmax = t->hwc.n;}
+        if (t->dK.n > nmax)   {nmax = t->dK.n;}
+    }
+    if (irank == 0)
+    {
+        printf(" >>> %d soil classes tabulated, at most %d nodes per curve\n",nsoil,nmax);
+        if (param->vg_table_check == 1)
+        {
+            for (kk = 0; kk < nsoil; kk++)  {check_soil(&(*vgt)[kk], kk, param);}
+        }
+    }
+}
+
+// >>>>> Tabulate one soil class <<<<<
+static void build_soil(VGTable *t, Config *param)
+{
+    double m, hwet, hdry, wc0, wc1, wclim;
+    m = 1.0 - 1.0/t->vgn;
+    if (param->use_mvg == 1)
+    {
+        t->wcm = t->wcr + (t->wcs-t->wcr)*pow((1.0 + pow(fabs(param->aev)*t->vga,t->vgn)), m);
+        t->hsat = param->aev;
+    }
+    else
+    {
+        t->wcm = t->wcs;
+        t->hsat = 0.0;
+    }
+    // the wet end stays clear of the kink at the air entry value
+    hwet = 1.0 / (VG_TABLE_RANGE * t->vga);
+    if (param->aev < 0.0 & 2.0*fabs(param->aev) > hwet)    {hwet = 2.0*fabs(param->aev);}
+    hdry = VG_TABLE_RANGE / t->vga;
+    if (hdry < VG_TABLE_RANGE * hwet)  {hdry = VG_TABLE_RANGE * hwet;}
+    build_curve(&t->wch, t, VG_WCH, log(hwet), log(hdry), 0, param);
+    build_curve(&t->K, t, VG_K, log(hwet), log(hdry), 1, param);
+    build_curve(&t->ch, t, VG_CH, log(hwet), log(hdry), 1, param);
+    // the water content range of the same heads, clear of the clipping
+    // of vg_hwc near wcr and wcs and of the limiter of vg_dKdwc
+    wc0 = vg_wch(-hdry, t->vga, t->vgn, t->wcr, t->wcs, param);
+    wc1 = vg_wch(-hwet, t->vga, t->vgn, t->wcr, t->wcs, param);
+    if (wc0 < t->wcr + 2e-7)   {wc0 = t->wcr + 2e-7;}
+    wclim = t->wcs - 1e-6*(t->wcs - t->wcr);
+    if (wc1 > wclim)   {wc1 = wclim;}
+    build_curve(&t->hwc, t, VG_HWC, wc_coord(t, wc0), wc_coord(t, wc1), 1, param);
+    if (wc1 > 0.9999*t->wcs)   {wc1 = 0.9999*t->wcs;}
+    build_curve(&t->dK, t, VG_DK, wc_coord(t, wc0), wc_coord(t, wc1), 1, param);
+}
+
+// >>>>> Tabulate one curve on [x0, x1] <<<<<
+// The node count doubles until the relative error at the interval
+// midpoints is below vg_table_tol or VG_TABLE_MAXN is reached.
+static void build_curve(VGCurve *c, VGTable *t, int kind, double x0, double x1, int uselog, Config *param)
+{
+    int ii, n = VG_TABLE_MINN;
+    double tol, err, x, exact, approx;
+    tol = param->vg_table_tol;
+    if (tol <= 0.0) {tol = 1e-6;}
+    c->uselog = uselog;
+    c->x0 = x0;
+    c->x1 = x1;
+    c->f = NULL;
+    while (1)
+    {
+        c->n = n;
+        c->dx = (x1 - x0) / (n - 1);
+        c->rdx = 1.0 / c->dx;
+        c->f = realloc(c->f, n*sizeof(double));
+        for (ii = 0; ii < n; ii++)  {c->f[ii] = curve_node(t, kind, x0 + ii*c->dx, param);}
+        err = 0.0;
+        for (ii = 0; ii < n-1; ii++)
+        {
+            x = x0 + (ii + 0.5)*c->dx;
+            exact = curve_node(t, kind, x, param);
+            approx = 0.5 * (c->f[ii] + c->f[ii+1]);
+            if (uselog == 1)    {approx = fabs(exp(approx - exact) - 1.0);}
+            else    {approx = fabs(approx - exact) / fabs(exact);}
+            if (approx > err)   {err = approx;}
+        }
+        if (err <= tol | n >= VG_TABLE_MAXN)  {break;}
+        n = 2*(n-1) + 1;
+    }
+    if (err > tol)
+    {printf("WARNING: van Genuchten table error %e exceeds vg_table_tol!\n",err);}
+}
+
+// >>>>> Value of a curve at one node, in table variables <<<<<
+static double curve_node(VGTable *t, int kind, double x, Config *param)
+{
+    double h, wc, e;
+    h = -exp(x);
+    e = exp(x);
+    wc = (t->wcr + t->wcm*e) / (1.0 + e);
+    switch (kind)
+    {
+        case VG_WCH:
+            return vg_wch(h, t->vga, t->vgn, t->wcr, t->wcs, param);
+        case VG_K:
+            return log(vg_K(h, 1.0, t->vga, t->vgn, t->wcr, t->wcs, param));
+        case VG_CH:
+            return log(vg_ch(h, t->vga, t->vgn, t->wcr, t->wcs, param));
+        case VG_HWC:
+            return log(-vg_hwc(wc, t->vga, t->vgn, t->wcr, t->wcs, param));
+        default:
+            return log(vg_dKdwc(wc, 1.0, t->vga, t->vgn, t->wcr, t->wcs, param));
+    }
+}
+
+// >>>>> Linear interpolation on a curve, x within [x0, x1] <<<<<
+static double curve_value(VGCurve *c, double x)
+{
+    int kk;
+    double r;
+    r = (x - c->x0) * c->rdx;
+    kk = (int) r;
+    if (kk > c->n - 2)  {kk = c->n - 2;}
+    r = r - kk;
+    return c->f[kk] + r * (c->f[kk+1] - c->f[kk]);
+}
+
+// >>>>> Table variable of the water content <<<<<
+static double wc_coord(VGTable *t, double wc)
+{
+    return log((wc - t->wcr) / (t->wcm - wc));
+}
+
+// >>>>> Water content at h <<<<<
+double vgtable_wch(VGTable *t, double h, Config *param)
+{
+    double x;
+    if (h > param->aev)  {return t->wcs;}
+    x = log(-h);
+    if (x >= t->wch.x0 & x <= t->wch.x1)  {return curve_value(&t->wch, x);}
+    return vg_wch(h, t->vga, t->vgn, t->wcr, t->wcs, param);
+}
+
+// >>>>> Pressure head at wc <<<<<
+double vgtable_hwc(VGTable *t, double wc, Config *param)
+{
+    double x, eps = 1e-7;
+    if (wc - t->wcr < eps)  {wc = t->wcr + eps;}
+    if (wc >= t->wcs)   {return 0.0;}
+    x = wc_coord(t, wc);
+    if (x >= t->hwc.x0 & x <= t->hwc.x1)  {return -exp(curve_value(&t->hwc, x));}
+    return vg_hwc(wc, t->vga, t->vgn, t->wcr, t->wcs, param);
+}
+
+// >>>>> Specific capacity at h <<<<<
+double vgtable_ch(VGTable *t, double h, Config *param)
+{
+    double x;
+    if (h > t->hsat)    {return 0.0;}
+    x = log(-h);
+    if (x >= t->ch.x0 & x <= t->ch.x1)  {return exp(curve_value(&t->ch, x));}
+    return vg_ch(h, t->vga, t->vgn, t->wcr, t->wcs, param);
+}
+
+// >>>>> Hydraulic conductivity at h <<<<<
+double vgtable_K(VGTable *t, double h, double Ks, Config *param)
+{
+    double x;
+    if (h > t->hsat)    {return Ks;}
+    x = log(-h);
+    if (x >= t->K.x0 & x <= t->K.x1)  {return Ks * exp(curve_value(&t->K, x));}
+    return vg_K(h, Ks, t->vga, t->vgn, t->wcr, t->wcs, param);
+}
+
+// >>>>> dKdwc at wc <<<<<
+double vgtable_dKdwc(VGTable *t, double wc, double Ks, Config *param)
+{
+    double x;
+    // use the lambda limiter
+    if (wc > 0.9999 * t->wcs & wc < t->wcs)
+    {wc = 0.9999 * t->wcs;}
+    x = wc_coord(t, wc);
+    if (x >= t->dK.x0 & x <= t->dK.x1)  {return Ks * exp(curve_value(&t->dK, x));}
+    return vg_dKdwc(wc, Ks, t->vga, t->vgn, t->wcr, t->wcs, param);
+}
+
+// >>>>> Compare the tables of one soil class with the analytic functions <<<<<
+// h sweeps the tabulated heads one e-fold beyond either end, wc sweeps
+// (wcr, wcs). Points fall between the nodes.
+static void check_soil(VGTable *t, int kk, Config *param)
+{
+    int ii, jj, n = 200000;
+    double x, h, wc, xa, xb, ya, yb, err[5] = {0.0, 0.0, 0.0, 0.0, 0.0}, sum = 0.0;
+    clock_t t0;
+    double ttab, tana;
+    xa = t->wch.x0 - 1.0;
+    xb = t->wch.x1 + 1.0;
+    for (ii = 0; ii < n; ii++)
+    {
+        h = -exp(xa + (ii + 0.37)*(xb - xa)/n);
+        wc = t->wcr + (ii + 0.37)*(t->wcs - t->wcr)/n;
+        ya = vgtable_wch(t, h, param);
+        yb = vg_wch(h, t->vga, t->vgn, t->wcr, t->wcs, param);
+        x = fabs(ya - yb) / fabs(yb);
+        if (x > err[0]) {err[0] = x;}
+        ya = vgtable_hwc(t, wc, param);
+        yb = vg_hwc(wc, t->vga, t->vgn, t->wcr, t->wcs, param);
+        x = fabs(ya - yb) / fabs(yb);
+        if (x > err[1]) {err[1] = x;}
+        ya = vgtable_K(t, h, 1.0, param);
+        yb = vg_K(h, 1.0, t->vga, t->vgn, t->wcr, t->wcs, param);
+        x = fabs(ya - yb) / fabs(yb);
+        if (x > err[2]) {err[2] = x;}
+        ya = vgtable_ch(t, h, param);
+        yb = vg_ch(h, t->vga, t->vgn, t->wcr, t->wcs, param);
+        x = fabs(ya - yb) / fabs(yb);
+        if (x > err[3]) {err[3] = x;}
+        ya = vgtable_dKdwc(t, wc, 1.0, param);
+        yb = vg_dKdwc(wc, 1.0, t->vga, t->vgn, t->wcr, t->wcs, param);
+        x = fabs(ya - yb) / fabs(yb);
+        if (x > err[4]) {err[4] = x;}
+    }
+    printf(" >>> soil %d max rel. error : wc(h) %.2e, h(wc) %.2e, K(h) %.2e, c(h) %.2e, dK/dwc %.2e\n", \
+        kk,err[0],err[1],err[2],err[3],err[4]);
+    // cost of the five relations, tabulated and analytic
+    t0 = clock();
+    for (jj = 0; jj < 10; jj++)
+    {
+        for (ii = 0; ii < n; ii++)
+        {
+            h = -exp(xa + (ii + 0.37)*(xb - xa)/n);
+            wc = t->wcr + (ii + 0.37)*(t->wcs - t->wcr)/n;
+            sum += vgtable_wch(t, h, param) + vgtable_hwc(t, wc, param) + vgtable_K(t, h, 1.0, param) \
+                + vgtable_ch(t, h, param) + vgtable_dKdwc(t, wc, 1.0, param);
+        }
+    }
+    ttab = (double) (clock() - t0) / CLOCKS_PER_SEC;
+    t0 = clock();
+    for (jj = 0; jj < 10; jj++)
+    {
+        for (ii = 0; ii < n; ii++)
+        {
+            h = -exp(xa + (ii + 0.37)*(xb - xa)/n);
+            wc = t->wcr + (ii + 0.37)*(t->wcs - t->wcr)/n;
+            sum -= vg_wch(h, t->vga, t->vgn, t->wcr, t->wcs, param) \
+                + vg_hwc(wc, t->vga, t->vgn, t->wcr, t->wcs, param) \
+                + vg_K(h, 1.0, t->vga, t->vgn, t->wcr, t->wcs, param) \
+                + vg_ch(h, t->vga, t->vgn, t->wcr, t->wcs, param) \
+                + vg_dKdwc(wc, 1.0, t->vga, t->vgn, t->wcr, t->wcs, param);
+        }
+    }
+    tana = (double) (clock() - t0) / CLOCKS_PER_SEC;
+    printf(" >>> soil %d cost of %d evaluations : table %.3f s, analytic %.3f s (drift %.1e)\n", \
+        kk,10*n,ttab,tana,sum);
+}
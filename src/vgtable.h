@@ -0,0 +1,47 @@
+// Header file for vgtable.c
+#include"configuration.h"
+
+#ifndef VGTABLE_H
+#define VGTABLE_H
+
+// tables span |vga*h| in [1/VG_TABLE_RANGE, VG_TABLE_RANGE]
+#define VG_TABLE_RANGE 1000.0
+// node count of a curve before and after refinement
+#define VG_TABLE_MINN 64
+#define VG_TABLE_MAXN 65536
+// soil classes are indexed by one byte per cell
+#define MAX_SOIL 256
+
+// soil material of one class, Ks[0..2] along x, y and z
+typedef struct Material
+{
+    double vga, vgn, wcr, wcs, Ks[3];
+}Material;
+
+// one tabulated curve on a uniform grid in x
+typedef struct VGCurve
+{
+    int n, uselog;
+    double x0, x1, dx, rdx;
+    double *f;
+}VGCurve;
+
+// constitutive tables of one soil class
+// wch, K and ch are tabulated in x = ln|h|, hwc and dKdwc in
+// x = ln((wc-wcr)/(wcm-wc)). Both variables keep the van Genuchten power
+// laws linear at the wet and the dry end, K, ch, |h| and dKdwc are stored
+// as logarithms for the same reason.
+typedef struct VGTable
+{
+    double vga, vgn, wcr, wcs, wcm, hsat;
+    VGCurve wch, K, ch, hwc, dK;
+}VGTable;
+
+#endif
+
+void build_vg_table(VGTable **vgt, Material *mat, int nsoil, Config *param, int irank);
+double vgtable_wch(VGTable *t, double h, Config *param);
+double vgtable_hwc(VGTable *t, double wc, Config *param);
+double vgtable_ch(VGTable *t, double h, Config *param);
+double vgtable_K(VGTable *t, double h, double Ks, Config *param);
+double vgtable_dKdwc(VGTable *t, double wc, double Ks, Config *param);
@@ -0,0 +1,108 @@
+// Vertical line preconditioner for the subsurface system
+// The subsurface cells are numbered column by column, and the vertical
+// couplings dominate because dz is much smaller than dx and dy. Solving the
+// tridiagonal block of every column exactly is then a strong preconditioner,
+// and exact for a system without lateral couplings. Columns are independent,
+// so factorization and solve are parallel over the columns.
+#include<stdio.h>
+#include<stdlib.h>
+#include<math.h>
+
+#include "zline.h"
+
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+void init_zline(ZLine **zl, size_t ncol, size_t *start);
+void zline_factor(ZLine *zl, QMatrix *A);
+void zline_solve(ZLine *zl, double *y, double *c);
+void zline_activate(ZLine *zl);
+Vector *ZLinePrecond(QMatrix *A, Vector *y, Vector *c, double omega);
+
+// factorization used by ZLinePrecond, LASPack passes no context to preconditioners
+static ZLine *active_zline = NULL;
+
+// >>>>> Allocate the factors of ncol columns <<<<<
+// start has ncol+1 entries, the first row of every column and the dimension
+void init_zline(ZLine **zl, size_t ncol, size_t *start)
+{
+    size_t ii, n = start[ncol];
+    *zl = malloc(sizeof(ZLine));
+    (*zl)->ncol = ncol;
+    (*zl)->start = malloc((ncol+1)*sizeof(size_t));
+    for (ii = 0; ii <= ncol; ii++)  {(*zl)->start[ii] = start[ii];}
+    (*zl)->lo = calloc(n, sizeof(double));
+    (*zl)->up = calloc(n, sizeof(double));
+    (*zl)->winv = calloc(n, sizeof(double));
+}
+
+// >>>>> Thomas factorization of the column blocks of A <<<<<
+// lo holds the coupling to the cell above, up the modified coupling to the
+// cell below and winv the inverse of the eliminated diagonal. Inactive cells
+// are identity rows without couplings and simply split a column.
+void zline_factor(ZLine *zl, QMatrix *A)
+{
+    long col;
+    size_t ii, jj, first, last;
+    double lo, up, w;
+    ElType *row;
+    #pragma omp parallel for private(ii, jj, first, last, lo, up, w, row)
+    for (col = 0; col < (long)zl->ncol; col++)
+    {
+        first = zl->start[col];
+        last = zl->start[col+1];
+        for (ii = first; ii < last; ii++)
+        {
+            row = A->El[ii+1];
+            lo = 0.0;
+            up = 0.0;
+            for (jj = 0; jj < A->Len[ii+1]; jj++)
+            {
+                if (ii > first && row[jj].Pos == ii)    {lo = row[jj].Val;}
+                else if (ii+1 < last && row[jj].Pos == ii+2)    {up = row[jj].Val;}
+            }
+            w = A->DiagEl[ii+1]->Val;
+            if (ii > first) {w -= lo * zl->up[ii-1];}
+            zl->lo[ii] = lo;
+            zl->winv[ii] = 1.0 / w;
+            zl->up[ii] = up / w;
+        }
+    }
+}
+
+// >>>>> y = M^(-1) * c, works in place <<<<<
+void zline_solve(ZLine *zl, double *y, double *c)
+{
+    long col;
+    size_t ii, first, last;
+    #pragma omp parallel for private(ii, first, last)
+    for (col = 0; col < (long)zl->ncol; col++)
+    {
+        first = zl->start[col];
+        last = zl->start[col+1];
+        if (first == last)  {continue;}
+        y[first] = c[first] * zl->winv[first];
+        for (ii = first+1; ii < last; ii++)
+        {y[ii] = (c[ii] - zl->lo[ii] * y[ii-1]) * zl->winv[ii];}
+        for (ii = last-1; ii-- > first; )
+        {y[ii] -= zl->up[ii] * y[ii+1];}
+    }
+}
+
+// >>>>> Select the factorization applied by ZLinePrecond <<<<<
+void zline_activate(ZLine *zl)
+{
+    active_zline = zl;
+}
+
+// >>>>> Line preconditioner in the form of LASPack SSORPrecond <<<<<
+// The factors are taken from zline_activate, A and omega are not used.
+Vector *ZLinePrecond(QMatrix *A, Vector *y, Vector *c, double omega)
+{
+    size_t ii;
+    zline_solve(active_zline, y->Cmp+1, c->Cmp+1);
+    // the solve is linear, a pending multiplier of c carries over to y
+    for (ii = 1; ii <= y->Dim; ii++)    {y->Cmp[ii] *= c->Multipl;}
+    y->Multipl = 1.0;
+    return y;
+}
@@ -0,0 +1,24 @@
+// Header file for zline.c
+#include "laspack/vector.h"
+#include "laspack/qmatrix.h"
+
+#ifndef ZLINE_H
+#define ZLINE_H
+
+// vertical line preconditioner of a column-contiguous matrix
+// The rows start[col] to start[col+1]-1 of one column form a tridiagonal
+// block, which is factorized by the Thomas algorithm. Couplings between
+// columns are dropped.
+typedef struct ZLine
+{
+    size_t ncol, *start;
+    double *lo, *up, *winv;
+}ZLine;
+
+#endif
+
+void init_zline(ZLine **zl, size_t ncol, size_t *start);
+void zline_factor(ZLine *zl, QMatrix *A);
+void zline_solve(ZLine *zl, double *y, double *c);
+void zline_activate(ZLine *zl);
+Vector *ZLinePrecond(QMatrix *A, Vector *y, Vector *c, double omega);